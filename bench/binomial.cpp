@@ -0,0 +1,105 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/Binomial.hpp"
+#include "../src/RandomEngine.hpp"
+
+// Compares the binomial sampler to a std::binomial_distribution constructed
+// for every draw (the former RandomDist::binomial), on the (n, p) of the
+// default input file's workloads, and to its diffusion approximation.
+
+namespace {
+	struct Workload {
+		std::string name;
+		std::vector< std::pair<int, double> > draws;
+	};
+
+
+	// draws of one multinomial step of a population of size n with the given frequencies
+	std::vector< std::pair<int, double> > multinomialDraws(int n, const std::vector<double>& fqs) {
+		std::vector< std::pair<int, double> > draws;
+		double total = 1.0;
+
+		for (auto fq : fqs) {
+			draws.push_back(std::make_pair(n, fq / total));
+			n -= (int) (n * fq / total);
+			total -= fq;
+		}
+
+		return draws;
+	}
+
+
+	template <typename Draw>
+	double nanosecondsPerDraw(const Workload& workload, int nRepeats, Draw draw) {
+		volatile long long sink = 0;
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < nRepeats; ++i) {
+			for (auto& np : workload.draws) {
+				sink = sink + draw(np.first, np.second);
+			}
+		}
+
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		return elapsed.count() / (nRepeats * (double) workload.draws.size());
+	}
+}
+
+
+int main(int argc, char** argv) {
+	int nRepeats = argc > 1 ? std::stoi(argv[1]) : 200000;
+
+	std::vector<Workload> workloads = {
+		// data/input.txt: POPSIZE = 5000, FREQ = 0.8|0.2
+		{ "neutral, N = 5000, 0.8|0.2", multinomialDraws(5000, { 0.8, 0.2 }) },
+		{ "neutral, N = 100, 4 alleles", multinomialDraws(100, { 0.1, 0.2, 0.3, 0.4 }) },
+		// mutations: count of an allele and marker mutation rate
+		{ "mutations, N = 5000, MUT = 1E-6", { { 4000, 1E-6 }, { 1000, 1E-6 } } },
+		{ "mutations, N = 5000, MUT = 1E-3", { { 4000, 1E-3 }, { 1000, 1E-3 } } },
+		// migration: a few migrants drawn from a subpopulation
+		{ "migration, 3 migrants of 1000", multinomialDraws(3, { 0.5, 0.3, 0.2 }) },
+		{ "large N = 1E6, 0.5|0.5", multinomialDraws(1000000, { 0.5, 0.5 }) },
+		{ "census N = 1E9, 4 alleles", multinomialDraws(1000000000, { 0.1, 0.2, 0.3, 0.4 }) }
+	};
+
+	std::cout << std::left << std::setw(36) << "workload (ns per draw)"
+			  << std::right << std::setw(12) << "std" << std::setw(12) << "Binomial"
+			  << std::setw(12) << "reused" << std::setw(10) << "speed-up"
+			  << std::setw(12) << "diffusion" << std::endl;
+
+	for (auto& workload : workloads) {
+		RandomEngine engine(42, 0);
+
+		double stdTime = nanosecondsPerDraw(workload, nRepeats, [&](int n, double p) {
+			std::binomial_distribution<int> dbinom(n, p);
+			return dbinom(engine);
+		});
+
+		double binomialTime = nanosecondsPerDraw(workload, nRepeats, [&](int n, double p) {
+			return Binomial(n, p)(engine);
+		});
+
+		// same parameters drawn again, e.g. replicates in the same state
+		Binomial sampler;
+		double reusedTime = nanosecondsPerDraw(workload, nRepeats, [&](int n, double p) {
+			sampler.param(n, p);
+			return sampler(engine) + sampler(engine);
+		}) / 2;
+
+		// Gaussian draws from a variance of 1000 (DIFFUSION = 1000)
+		double diffusionTime = nanosecondsPerDraw(workload, nRepeats, [&](int n, double p) {
+			return Binomial(n, p, 1000.0)(engine);
+		});
+
+		std::cout << std::left << std::setw(36) << workload.name << std::right << std::fixed << std::setprecision(1)
+				  << std::setw(12) << stdTime << std::setw(12) << binomialTime
+				  << std::setw(12) << reusedTime << std::setw(9) << stdTime / binomialTime << "x"
+				  << std::setw(12) << diffusionTime << std::endl;
+	}
+
+	return 0;
+}
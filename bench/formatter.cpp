@@ -0,0 +1,112 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/FrequencyFormatter.hpp"
+#include "../src/RandomEngine.hpp"
+
+// Compares the fixed-point frequency formatter to the std::stringstream
+// formatting it replaces (the former Simulation::getAlleleFqsForOutput),
+// on the allele counts of one output line, and checks that both write
+// the same bytes.
+
+namespace {
+	struct Workload {
+		std::string name;
+		unsigned long long populationSize;
+		std::size_t precision;
+		std::vector<unsigned long long> counts;
+	};
+
+
+	// counts of a population of size n spread over the given number of alleles
+	std::vector<unsigned long long> randomCounts(unsigned long long n, std::size_t nAlleles, RandomEngine& engine) {
+		std::vector<unsigned long long> counts(nAlleles, 0);
+
+		for (std::size_t a = 0; a + 1 < nAlleles && n > 0; ++a) {
+			counts[a] = engine() % (n + 1);
+			n -= counts[a];
+		}
+		counts.back() += n;
+
+		return counts;
+	}
+
+
+	std::string withStringstream(const Workload& workload) {
+		std::stringstream ss;
+
+		for (std::size_t a = 0; a < workload.counts.size(); ++a) {
+			if (a != 0) ss << '|';
+			ss << std::setprecision((int) workload.precision) << std::fixed << workload.counts[a] * 1.0 / workload.populationSize;
+		}
+
+		return ss.str();
+	}
+
+
+	std::string withFormatter(const Workload& workload) {
+		FrequencyFormatter formatter(workload.precision, workload.populationSize);
+		std::string out;
+		out.reserve(workload.counts.size() * (workload.precision + 3));
+
+		for (std::size_t a = 0; a < workload.counts.size(); ++a) {
+			if (a != 0) out += '|';
+			formatter.append(out, workload.counts[a]);
+		}
+
+		return out;
+	}
+
+
+	template <typename Format>
+	double nanosecondsPerFrequency(const Workload& workload, int nRepeats, Format format) {
+		volatile std::size_t sink = 0;
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < nRepeats; ++i) {
+			sink = sink + format(workload).size();
+		}
+
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		return elapsed.count() / (nRepeats * (double) workload.counts.size());
+	}
+}
+
+
+int main(int argc, char** argv) {
+	int nRepeats = argc > 1 ? std::stoi(argv[1]) : 20000;
+	RandomEngine engine(42, 0);
+
+	std::vector<Workload> workloads = {
+		// data/input.txt: POPSIZE = 5000, FREQ = 0.8|0.2
+		{ "neutral, N = 5000, 2 alleles", 5000, 2, { 4000, 1000 } },
+		{ "neutral, N = 100, 4 alleles", 100, 2, randomCounts(100, 4, engine) },
+		// mutations: the precision follows the length of the markers
+		{ "mutations, N = 5000, 12 sites, 50 alleles", 5000, 10, randomCounts(5000, 50, engine) },
+		{ "large N = 1E6, 20 alleles", 1000000, 2, randomCounts(1000000, 20, engine) },
+		{ "census N = 1E9, 4 alleles, 30 decimals", 1000000000, 30, randomCounts(1000000000, 4, engine) }
+	};
+
+	std::cout << std::left << std::setw(44) << "workload (ns per frequency)"
+			  << std::right << std::setw(14) << "stringstream" << std::setw(12) << "formatter"
+			  << std::setw(10) << "speed-up" << std::setw(12) << "identical" << std::endl;
+
+	bool isIdentical = true;
+	for (auto& workload : workloads) {
+		bool same = withStringstream(workload) == withFormatter(workload);
+		isIdentical = isIdentical && same;
+
+		double streamTime = nanosecondsPerFrequency(workload, nRepeats, withStringstream);
+		double formatterTime = nanosecondsPerFrequency(workload, nRepeats, withFormatter);
+
+		std::cout << std::left << std::setw(44) << workload.name << std::right << std::fixed << std::setprecision(1)
+				  << std::setw(14) << streamTime << std::setw(12) << formatterTime
+				  << std::setw(9) << streamTime / formatterTime << "x"
+				  << std::setw(12) << (same ? "yes" : "NO") << std::endl;
+	}
+
+	return isIdentical ? 0 : 1;
+}
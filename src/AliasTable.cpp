@@ -0,0 +1,61 @@
+#include <cassert>
+#include "AliasTable.hpp"
+
+
+AliasTable::AliasTable(const std::vector<double>& weights) {
+	double total = 0.0;
+	for (auto w : weights) {
+		assert(w >= 0.0);
+		total += w;
+	}
+
+	if (!(total > 0.0)) {
+		return;
+	}
+
+	std::size_t n = weights.size();
+	probabilities.resize(n);
+	aliases.resize(n);
+
+	// columns below and above the average weight
+	std::vector<std::size_t> small, large;
+	for (std::size_t i = 0; i < n; ++i) {
+		probabilities[i] = weights[i] * n / total;
+		aliases[i] = i;
+		(probabilities[i] < 1.0 ? small : large).push_back(i);
+	}
+
+	// every small column is topped up by a large one, which becomes its alias
+	while (!small.empty() && !large.empty()) {
+		std::size_t s = small.back(), l = large.back();
+		small.pop_back();
+
+		aliases[s] = l;
+		probabilities[l] -= 1.0 - probabilities[s];
+
+		if (probabilities[l] < 1.0) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// what is left is full, up to rounding errors
+	for (auto i : small) probabilities[i] = 1.0;
+	for (auto i : large) probabilities[i] = 1.0;
+}
+
+
+bool AliasTable::isEmpty() const {
+	return probabilities.empty();
+}
+
+
+std::size_t AliasTable::draw(double u) const {
+	assert(!isEmpty());
+
+	double x = u * probabilities.size();
+	std::size_t column = (std::size_t) x;
+	if (column >= probabilities.size()) column = probabilities.size() - 1;
+
+	return x - column < probabilities[column] ? column : aliases[column];
+}
@@ -0,0 +1,49 @@
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <vector>
+
+
+/** \brief Alias table of a discrete distribution (Walker, 1977; Vose, 1991)
+ *
+ * Built once in O(K) from the weights of K outcomes, it draws an outcome
+ * in constant time from a single uniform: the uniform selects a column,
+ * and its fractional part chooses between the column's own outcome and
+ * its alias.
+ *
+ * */
+class AliasTable {
+
+public:
+
+	/** \brief AliasTable constructor
+	 *
+	 * \param weights		non-negative weights of the outcomes (need not sum to 1)
+	 * */
+	AliasTable(const std::vector<double>& weights = std::vector<double>());
+
+
+	/** \brief Check whether no outcome can be drawn (no weight, or only zero weights)
+	 * */
+	bool isEmpty() const;
+
+
+	/** \brief Draw an outcome
+	 *
+	 * \param u			uniform number in [0, 1)
+	 *
+	 * \return The index of the outcome
+	 * */
+	std::size_t draw(double u) const;
+
+private:
+
+	//!< Probability of keeping the column's own outcome, per column
+	std::vector<double> probabilities;
+
+
+	//!< Outcome drawn instead, per column
+	std::vector<std::size_t> aliases;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include <cassert>
+#include <algorithm>
+#include <functional>
+#include "AlleleDictionary.hpp"
+
+
+AlleleDictionary::AlleleDictionary(std::size_t nBuckets)
+  : nextProvisional(0)
+{
+	std::size_t size = 1;
+	while (size < nBuckets) size *= 2;
+
+	buckets.reset(new std::atomic<Entry*>[size]);
+	for (std::size_t b = 0; b < size; ++b) {
+		buckets[b].store(nullptr, std::memory_order_relaxed);
+	}
+
+	mask = size - 1;
+}
+
+
+AlleleDictionary::~AlleleDictionary() {
+	for (std::size_t b = 0; b <= mask; ++b) {
+		Entry* entry = buckets[b].load(std::memory_order_relaxed);
+
+		while (entry) {
+			Entry* next = entry->next;
+			delete entry;
+			entry = next;
+		}
+	}
+}
+
+
+std::size_t AlleleDictionary::add(const std::string& allele, std::size_t replicate, std::size_t index) {
+	assert(replicate < ((std::uint64_t) 1 << 32) && index < ((std::uint64_t) 1 << 32));
+
+	std::uint64_t seen = ((std::uint64_t) replicate << 32) | (std::uint64_t) index;
+	std::atomic<Entry*>& bucket = buckets[std::hash<std::string>()(allele) & mask];
+
+	// look for the allele in the chain, as published so far
+	Entry* head = bucket.load(std::memory_order_acquire);
+	for (Entry* entry = head; entry; entry = entry->next) {
+		if (entry->allele == allele) {
+			markSeen(*entry, seen);
+			return entry->provisional;
+		}
+	}
+
+	Entry* created = new Entry();
+	created->allele = allele;
+	created->provisional = nextProvisional.fetch_add(1, std::memory_order_relaxed);
+	created->firstSeen.store(seen, std::memory_order_relaxed);
+	created->next = head;
+
+	// prepend the entry, unless another thread added the allele in the meantime
+	while (!bucket.compare_exchange_weak(created->next, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+		for (Entry* entry = created->next; entry != head; entry = entry->next) {
+			if (entry->allele == allele) {
+				// its provisional index stays unused
+				delete created;
+				markSeen(*entry, seen);
+				return entry->provisional;
+			}
+		}
+
+		head = created->next;
+	}
+
+	return created->provisional;
+}
+
+
+void AlleleDictionary::finalize() {
+	std::vector<const Entry*> entries;
+	for (std::size_t b = 0; b <= mask; ++b) {
+		for (Entry* entry = buckets[b].load(std::memory_order_acquire); entry; entry = entry->next) {
+			entries.push_back(entry);
+		}
+	}
+
+	// no two alleles are first seen at the same index of the same replicate
+	std::sort(entries.begin(), entries.end(), [](const Entry* a, const Entry* b) {
+		return a->firstSeen.load(std::memory_order_relaxed) < b->firstSeen.load(std::memory_order_relaxed);
+	});
+
+	columns.assign(nextProvisional.load(), 0);
+	alleles.clear();
+
+	for (auto entry : entries) {
+		columns[entry->provisional] = alleles.size();
+		alleles.push_back(entry->allele);
+	}
+}
+
+
+std::size_t AlleleDictionary::getColumn(std::size_t provisional) const {
+	return columns[provisional];
+}
+
+
+const std::vector<std::string>& AlleleDictionary::getAlleles() const {
+	return alleles;
+}
+
+
+void AlleleDictionary::markSeen(Entry& entry, std::uint64_t seen) {
+	std::uint64_t current = entry.firstSeen.load(std::memory_order_relaxed);
+
+	while (seen < current && !entry.firstSeen.compare_exchange_weak(current, seen, std::memory_order_relaxed)) {
+	}
+}
@@ -0,0 +1,118 @@
+#ifndef ALLELE_DICTIONARY_H
+#define ALLELE_DICTIONARY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/** \brief Dictionary of the alleles found by all the replicates of a run
+ *
+ * The worker threads add the alleles of their replicates concurrently and
+ * without locks: the dictionary is a hash table of singly-linked chains,
+ * whose entries are prepended with a compare-and-swap and never removed.
+ * An allele gets a provisional index when first added, whichever thread
+ * does it.
+ *
+ * Once every replicate is added, \ref finalize orders the alleles by the
+ * first replicate that has them, then by their index in that replicate:
+ * the columns do not depend on the order the threads added them in.
+ *
+ * */
+class AlleleDictionary {
+
+public:
+
+	/** \brief AlleleDictionary constructor
+	 *
+	 * \param nBuckets		number of chains of the hash table (rounded up to a power of two)
+	 * */
+	explicit AlleleDictionary(std::size_t nBuckets);
+
+
+	//!< Frees the entries
+	~AlleleDictionary();
+
+
+	//!< The entries are owned by the dictionary, we do not allow any copies
+	AlleleDictionary(const AlleleDictionary& other) = delete;
+
+
+	//!< The entries are owned by the dictionary, we do not allow any copies
+	AlleleDictionary& operator=(const AlleleDictionary& other) = delete;
+
+
+	/** \brief Add the allele of a replicate (thread-safe, lock-free)
+	 *
+	 * \param allele		identifier of the allele
+	 * \param replicate		index of the replicate
+	 * \param index			index of the allele in the replicate
+	 *
+	 * \return The provisional index of the allele
+	 * */
+	std::size_t add(const std::string& allele, std::size_t replicate, std::size_t index);
+
+
+	/** \brief Order the alleles into columns (once every allele is added, single thread)
+	 * */
+	void finalize();
+
+
+	/** \brief Get the column of an allele (after \ref finalize)
+	 *
+	 * \param provisional	provisional index of the allele, given by \ref add
+	 * */
+	std::size_t getColumn(std::size_t provisional) const;
+
+
+	/** \brief Get the alleles by column (after \ref finalize)
+	 * */
+	const std::vector<std::string>& getAlleles() const;
+
+private:
+
+	struct Entry {
+		//!< Identifier of the allele
+		std::string allele;
+
+
+		//!< Provisional index of the allele
+		std::size_t provisional;
+
+
+		//!< First replicate having the allele and its index there, as (replicate << 32 | index)
+		std::atomic<std::uint64_t> firstSeen;
+
+
+		//!< Next entry of the chain
+		Entry* next;
+	};
+
+
+	//!< Lower the first replicate and index having an entry's allele
+	static void markSeen(Entry& entry, std::uint64_t seen);
+
+
+	//!< Heads of the chains
+	std::unique_ptr< std::atomic<Entry*>[] > buckets;
+
+
+	//!< Number of chains minus 1 (a power of two minus 1)
+	std::size_t mask;
+
+
+	//!< Next provisional index
+	std::atomic<std::size_t> nextProvisional;
+
+
+	//!< Column of every provisional index
+	std::vector<std::size_t> columns;
+
+
+	//!< Alleles by column
+	std::vector<std::string> alleles;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include <cassert>
+#include <cmath>
+#include "Binomial.hpp"
+
+namespace {
+	// below this mean (of the least likely outcome), the inversion is faster than BTRD
+	const double INVERSION_MAX_MEAN = 10.0;
+
+
+	const double TWO_PI = 6.283185307179586;
+
+
+	// uniform double in [0, 1), with 53 random bits
+	double uniform(RandomEngine& engine) {
+		double high = (double) (engine() >> 5);
+		double low = (double) (engine() >> 6);
+		return (high * 67108864.0 + low) * (1.0 / 9007199254740992.0);
+	}
+
+
+	// tail of Stirling's approximation: log(k!) - log(sqrt(2 pi) (k + 1)^(k + 1/2) e^-(k + 1))
+	double stirlingTail(double k) {
+		static const double tail[] = {
+			0.08106146679532726, 0.04134069595540929, 0.02767792568499834,
+			0.02079067210376509, 0.01664469118982119, 0.01387612882307075,
+			0.01189670994589177, 0.01041126526197209, 0.009255462182712733,
+			0.008330563433362871
+		};
+
+		if (k < 10) {
+			return tail[(int) k];
+		}
+
+		double kp1sq = (k + 1) * (k + 1);
+		return (1.0 / 12 - (1.0 / 360 - 1.0 / 1260 / kp1sq) / kp1sq) / (k + 1);
+	}
+}
+
+
+Binomial::Binomial(long long n, double p, double threshold)
+  : gaussianThreshold(threshold), n(-1), p(-1.0)
+{
+	param(n, p);
+}
+
+
+void Binomial::param(long long nTrials, double pSuccess) {
+	if (nTrials == n && pSuccess == p) {
+		return;
+	}
+
+	assert(nTrials >= 0);
+
+	n = nTrials;
+	p = pSuccess;
+	isFlipped = p > 0.5;
+	pDraw = isFlipped ? 1.0 - p : p;
+
+	if (n == 0 || p <= 0.0) {
+		method = CONSTANT;
+		constant = 0;
+		return;
+	}
+
+	if (p >= 1.0) {
+		method = CONSTANT;
+		constant = n;
+		return;
+	}
+
+	double q = 1.0 - pDraw;
+
+	if (gaussianThreshold > 0.0 && n * pDraw * q >= gaussianThreshold) {
+		method = GAUSSIAN;
+		mean = n * pDraw;
+		sd = std::sqrt(n * pDraw * q);
+		return;
+	}
+
+	if (n * pDraw < INVERSION_MAX_MEAN) {
+		method = INVERSION;
+		q0 = std::exp(n * std::log1p(-pDraw));
+		s = pDraw / q;
+		a = (n + 1) * s;
+		return;
+	}
+
+	method = BTRD;
+
+	double spq = std::sqrt(n * pDraw * q);
+	btrdB = 1.15 + 2.53 * spq;
+	btrdA = -0.0873 + 0.0248 * btrdB + 0.01 * pDraw;
+	btrdC = n * pDraw + 0.5;
+	btrdAlpha = (2.83 + 5.1 / btrdB) * spq;
+	btrdVr = 0.92 - 4.2 / btrdB;
+	btrdM = std::floor((n + 1) * pDraw);
+	btrdR = pDraw / q;
+	btrdNr = (n + 1) * btrdR;
+	btrdNpq = n * pDraw * q;
+	btrdH = (btrdM + 0.5) * std::log((btrdM + 1) / (btrdR * (n - btrdM + 1)))
+		+ stirlingTail(btrdM) + stirlingTail(n - btrdM);
+}
+
+
+long long Binomial::operator()(RandomEngine& engine) const {
+	long long x = 0;
+
+	switch (method) {
+		case CONSTANT:
+			return constant;
+
+		case INVERSION:
+			x = inversion(engine);
+			break;
+
+		case GAUSSIAN:
+			x = gaussian(engine);
+			break;
+
+		case BTRD:
+		default:
+			x = btrd(engine);
+			break;
+	}
+
+	return isFlipped ? n - x : x;
+}
+
+
+void Binomial::generate(std::vector<long long>& toFill, RandomEngine& engine) const {
+	for (auto& x : toFill) {
+		x = (*this)(engine);
+	}
+}
+
+
+long long Binomial::inversion(RandomEngine& engine) const {
+	while (true) {
+		double u = uniform(engine);
+		double f = q0;
+
+		for (long long x = 0; x <= n; ++x) {
+			if (u < f) {
+				return x;
+			}
+
+			u -= f;
+			f *= a / (x + 1) - s;
+		}
+
+		// u fell in the rounding error of the cumulated probabilities: draw again
+	}
+}
+
+
+long long Binomial::btrd(RandomEngine& engine) const {
+	double r = btrdR;
+	double nr = btrdNr;
+	double npq = btrdNpq;
+	double urvr = 0.86 * btrdVr;
+
+	while (true) {
+		double u = 0.0;
+		double v = uniform(engine);
+
+		// step 1: inside the box, where the hat and the density coincide
+		if (v <= urvr) {
+			u = v / btrdVr - 0.43;
+			return (long long) std::floor((2 * btrdA / (0.5 - std::fabs(u)) + btrdB) * u + btrdC);
+		}
+
+		// step 2: generate a point under the hat
+		if (v >= btrdVr) {
+			u = uniform(engine) - 0.5;
+		} else {
+			u = v / btrdVr - 0.93;
+			u = (u < 0 ? -0.5 : 0.5) - u;
+			v = uniform(engine) * btrdVr;
+		}
+
+		// step 3.0: transformed rejection
+		double us = 0.5 - std::fabs(u);
+		double k = std::floor((2 * btrdA / us + btrdB) * u + btrdC);
+		if (k < 0 || k > n) {
+			continue;
+		}
+
+		v = v * btrdAlpha / (btrdA / (us * us) + btrdB);
+		double km = std::fabs(k - btrdM);
+
+		// step 3.1: recursive evaluation of f(k) / f(m) close to the mode
+		if (km <= 15) {
+			double f = 1.0;
+			if (btrdM < k) {
+				for (double i = btrdM + 1; i <= k; ++i) f *= nr / i - r;
+			} else if (btrdM > k) {
+				for (double i = k + 1; i <= btrdM; ++i) v *= nr / i - r;
+			}
+
+			if (v <= f) {
+				return (long long) k;
+			}
+
+			continue;
+		}
+
+		// step 3.2: squeeze acceptance or rejection
+		v = std::log(v);
+		double rho = (km / npq) * (((km / 3.0 + 0.625) * km + 1.0 / 6.0) / npq + 0.5);
+		double t = -km * km / (2 * npq);
+		if (v < t - rho) {
+			return (long long) k;
+		}
+		if (v > t + rho) {
+			continue;
+		}
+
+		// step 3.3: final acceptance or rejection, log(f(k) / f(m)) with Stirling's formula
+		double nm = n - btrdM + 1;
+		double nk = n - k + 1;
+		if (v <= btrdH + (n + 1) * std::log(nm / nk) + (k + 0.5) * std::log(nk * r / (k + 1))
+				- stirlingTail(k) - stirlingTail(n - k)) {
+			return (long long) k;
+		}
+	}
+}
+
+
+long long Binomial::gaussian(RandomEngine& engine) const {
+	// Box-Muller, one variate per draw so that a draw only depends on its own uniforms
+	double u = 1.0 - uniform(engine);
+	double z = std::sqrt(-2.0 * std::log(u)) * std::cos(TWO_PI * uniform(engine));
+
+	// the boundaries absorb the draws beyond them
+	double x = std::floor(mean + sd * z + 0.5);
+	return x < 0.0 ? 0 : x > n ? n : (long long) x;
+}
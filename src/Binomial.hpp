@@ -0,0 +1,126 @@
+#ifndef BINOMIAL_H
+#define BINOMIAL_H
+
+#include <vector>
+#include "RandomEngine.hpp"
+
+
+/** \brief Binomial distribution sampler
+ *
+ * The setup depends on (n, p) only, and is kept between draws: drawing
+ * repeatedly with the same parameters does not redo it, and setting the
+ * same parameters again is free. The algorithm is chosen from the
+ * parameters:
+ *
+ * - p = 0, p = 1 or n = 0: the result is exact, nothing is drawn
+ * - n * min(p, 1 - p) < 10: inversion (sequential search from 0, one uniform
+ *   per draw, expected n * p + 1 iterations)
+ * - otherwise: BTRD, the transformed rejection of Hormann (1993), with an
+ *   expected number of uniforms close to 2 whatever n
+ *
+ * For p > 0.5, the number of failures is drawn instead.
+ *
+ * With a Gaussian threshold, the draws of variance n * p * (1 - p) at least
+ * the threshold are approximated: the Gaussian of the same mean and
+ * variance is rounded to the nearest integer and kept within [0, n] (the
+ * diffusion limit of the Wright-Fisher model). By the Berry-Esseen theorem,
+ * its cumulative distribution is off by at most
+ * _DIFFUSION_BERRY_ESSEEN_ / sqrt(threshold).
+ *
+ * */
+class Binomial {
+
+public:
+
+	/** \brief Binomial constructor
+	 *
+	 * \param n					number of trials
+	 * \param p					success probability
+	 * \param gaussianThreshold	minimal variance of the approximated draws (0: exact)
+	 * */
+	Binomial(long long n = 0, double p = 0.0, double gaussianThreshold = 0.0);
+
+
+	/** \brief Change the parameters of the distribution
+	 *
+	 * Does nothing if they did not change.
+	 *
+	 * \param n			number of trials
+	 * \param p			success probability
+	 * */
+	void param(long long n, double p);
+
+
+	/** \brief Draw a number of successes
+	 *
+	 * \param engine	the random stream to draw from
+	 * */
+	long long operator()(RandomEngine& engine) const;
+
+
+	/** \brief Fill a vector with independent draws
+	 *
+	 * \param toFill	the vector to fill
+	 * \param engine	the random stream to draw from
+	 * */
+	void generate(std::vector<long long>& toFill, RandomEngine& engine) const;
+
+private:
+
+	//!< Draw with the inversion algorithm
+	long long inversion(RandomEngine& engine) const;
+
+
+	//!< Draw with the BTRD algorithm
+	long long btrd(RandomEngine& engine) const;
+
+
+	//!< Draw with the Gaussian approximation
+	long long gaussian(RandomEngine& engine) const;
+
+
+	//!< Algorithms
+	enum Method { CONSTANT, INVERSION, BTRD, GAUSSIAN };
+
+
+	//!< Minimal variance of the draws approximated by a Gaussian (0: never)
+	double gaussianThreshold;
+
+
+	//!< Number of trials
+	long long n;
+
+
+	//!< Success probability
+	double p;
+
+
+	//!< Algorithm used for the current parameters
+	Method method;
+
+
+	//!< Result for the \ref CONSTANT method
+	long long constant;
+
+
+	//!< Whether the failures are drawn (p > 0.5)
+	bool isFlipped;
+
+
+	//!< Success probability of the draws, min(p, 1 - p)
+	double pDraw;
+
+
+	//!< Inversion: (1 - pDraw)^n, pDraw / (1 - pDraw) and (n + 1) * pDraw / (1 - pDraw)
+	double q0, s, a;
+
+
+	//!< Gaussian approximation: mean and standard deviation
+	double mean, sd;
+
+
+	//!< BTRD constants (notations of Hormann, 1993)
+	double btrdB, btrdA, btrdC, btrdVr, btrdAlpha, btrdM, btrdR, btrdNr, btrdNpq, btrdH;
+};
+
+#endif
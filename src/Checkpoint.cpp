@@ -0,0 +1,136 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Checkpoint.hpp"
+#include "Globals.hpp"
+
+namespace {
+	// magic bytes at the start of every checkpoint file
+	const char MAGIC[8] = { 'P', 'O', 'P', 'G', 'E', 'N', 'C', 'K' };
+
+
+	// current version of the format (5: the haplotypes of the extinct alleles are freed)
+	const std::uint32_t VERSION = 5;
+
+
+	// parameters that may change when a run is resumed
+	const char* const RESUMABLE_KEYS[] = {
+		_INPUT_KEY_GENERATIONS_, _INPUT_KEY_THREADS_, _INPUT_KEY_OUTPUT_BLOCK_SIZE_, _INPUT_KEY_CHECKPOINT_
+	};
+
+
+	// the parameter lines, without the ones that may change
+	std::vector<std::string> fixedParameters(const std::string& parameters) {
+		std::vector<std::string> lines;
+		std::stringstream ss(parameters);
+		std::string line;
+
+		while (std::getline(ss, line)) {
+			std::string key = line.substr(0, line.find(_INPUT_DECLARATION_));
+
+			bool isResumable = false;
+			for (auto resumable : RESUMABLE_KEYS) {
+				isResumable = isResumable || key == resumable;
+			}
+
+			if (!isResumable) lines.push_back(line);
+		}
+
+		return lines;
+	}
+
+
+	// write the data of a file (or the entries of a directory) to the disk
+	bool sync(const std::string& path, int flags) {
+		int fd = ::open(path.c_str(), flags);
+		if (fd < 0) return false;
+
+		bool isSynced = ::fsync(fd) == 0;
+		return ::close(fd) == 0 && isSynced;
+	}
+}
+
+
+bool Checkpoint::save(const std::string& fileName, const std::vector<std::string>& outputFiles) const {
+	std::string temporary = fileName + ".tmp";
+
+	// the outputs reach the disk before the checkpoint that refers to them
+	for (auto& output : outputFiles) {
+		if (!sync(output, O_WRONLY)) return false;
+	}
+
+	{
+		std::ofstream out(temporary, std::ofstream::binary);
+		if (!out.is_open()) return false;
+
+		out.write(MAGIC, sizeof(MAGIC));
+		put(out, VERSION);
+		put(out, generation);
+		put(out, seed);
+		put(out, parameters);
+		put(out, resultsSize);
+		put(out, lastAlleleFqs);
+		put(out, binarySize);
+		put(out, binarySteps);
+		put(out, states);
+
+		out.flush();
+		if (!out) return false;
+	}
+
+	// the previous checkpoint is only replaced by a complete one, then the rename is synced
+	std::size_t separator = fileName.rfind('/');
+	std::string directory = separator == std::string::npos ? "." : fileName.substr(0, separator + 1);
+
+	return sync(temporary, O_WRONLY)
+		&& std::rename(temporary.c_str(), fileName.c_str()) == 0
+		&& sync(directory, O_RDONLY);
+}
+
+
+bool Checkpoint::load(const std::string& fileName) {
+	std::ifstream in(fileName, std::ifstream::binary);
+	if (!in.is_open()) return false;
+
+	char magic[sizeof(MAGIC)];
+	std::uint32_t version = 0;
+	in.read(magic, sizeof(magic));
+	get(in, version);
+
+	if (!in || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) return false;
+
+	get(in, generation);
+	get(in, seed);
+	get(in, parameters);
+	get(in, resultsSize);
+	get(in, lastAlleleFqs);
+	get(in, binarySize);
+	get(in, binarySteps);
+	get(in, states);
+
+	return (bool) in;
+}
+
+
+bool Checkpoint::isCompatible(const std::string& current) const {
+	return fixedParameters(parameters) == fixedParameters(current);
+}
+
+
+void Checkpoint::put(std::ostream& out, const std::string& value) {
+	put(out, (std::uint64_t) value.size());
+	out.write(value.data(), (std::streamsize) value.size());
+}
+
+
+void Checkpoint::get(std::istream& in, std::string& value) {
+	std::uint64_t size = 0;
+	get(in, size);
+	if (!in) return;
+
+	value.resize((std::size_t) size);
+	in.read(&value[0], (std::streamsize) size);
+}
@@ -0,0 +1,166 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "TrajectoryFormat.hpp"
+
+
+/** \brief State of a run at the end of an output block, to resume it later
+ *
+ * The checkpoint holds the state of every replicate (serialized by its
+ * batch), and how far the output files were written when it was taken:
+ * resuming truncates them there and simulates the next steps, which gives
+ * the same output as a run that was never interrupted.
+ *
+ * The file is written next to a temporary one, then renamed over the
+ * previous checkpoint, so that a crash leaves a consistent checkpoint.
+ * The output files it refers to and the temporary file are synced to the
+ * disk before the rename: after a power loss, the outputs are at least as
+ * long as the checkpoint records.
+ *
+ * */
+class Checkpoint {
+
+public:
+
+	/** \brief Write the checkpoint to a file (replacing the previous one once complete)
+	 *
+	 * \param fileName			path of the checkpoint file
+	 * \param outputFiles		paths of the output files it refers to, flushed by the caller
+	 *
+	 * \return Whether the checkpoint could be written
+	 * */
+	bool save(const std::string& fileName, const std::vector<std::string>& outputFiles = std::vector<std::string>()) const;
+
+
+	/** \brief Read the checkpoint from a file
+	 *
+	 * \param fileName			path of the checkpoint file
+	 *
+	 * \return Whether a complete checkpoint could be read
+	 * */
+	bool load(const std::string& fileName);
+
+
+	/** \brief Check whether a run can be resumed with new parameters
+	 *
+	 * Only the number of generations, of threads, the output block size and
+	 * the checkpoint period may change.
+	 *
+	 * \param current			parameters of the run to resume
+	 * */
+	bool isCompatible(const std::string& current) const;
+
+
+	/** \brief Write a value that can be copied byte by byte
+	 * */
+	template<typename T>
+	static void put(std::ostream& out, const T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "only plain values are written as is");
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+
+	/** \brief Write a string, preceded by its size
+	 * */
+	static void put(std::ostream& out, const std::string& value);
+
+
+	/** \brief Write a vector, preceded by its size
+	 * */
+	template<typename T>
+	static void put(std::ostream& out, const std::vector<T>& values) {
+		put(out, (std::uint64_t) values.size());
+		putElements(out, values, std::is_trivially_copyable<T>());
+	}
+
+
+	/** \brief Read a value written by \ref put
+	 * */
+	template<typename T>
+	static void get(std::istream& in, T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "only plain values are read as is");
+		in.read(reinterpret_cast<char*>(&value), sizeof(T));
+	}
+
+
+	/** \brief Read a string written by \ref put
+	 * */
+	static void get(std::istream& in, std::string& value);
+
+
+	/** \brief Read a vector written by \ref put
+	 * */
+	template<typename T>
+	static void get(std::istream& in, std::vector<T>& values) {
+		std::uint64_t size = 0;
+		get(in, size);
+		if (!in) return;
+
+		values.resize((std::size_t) size);
+		getElements(in, values, std::is_trivially_copyable<T>());
+	}
+
+
+	//!< Last step simulated
+	std::int64_t generation = 0;
+
+
+	//!< Global seed of the run
+	std::uint64_t seed = 0;
+
+
+	//!< Parameters of the run (as given by Data::getParameters)
+	std::string parameters;
+
+
+	//!< Size of the text result file (results.txt or statistics.txt)
+	std::uint64_t resultsSize = 0;
+
+
+	//!< Last frequencies written for each replicate, repeated once it is absorbed
+	std::vector<std::string> lastAlleleFqs;
+
+
+	//!< Size of the binary result file, if any
+	std::uint64_t binarySize = 0;
+
+
+	//!< Steps written to the binary result file, if any
+	std::vector<Trajectory::Step> binarySteps;
+
+
+	//!< State of the replicates, one string per batch
+	std::vector<std::string> states;
+
+private:
+
+	template<typename T>
+	static void putElements(std::ostream& out, const std::vector<T>& values, std::true_type) {
+		out.write(reinterpret_cast<const char*>(values.data()), (std::streamsize) (values.size() * sizeof(T)));
+	}
+
+
+	template<typename T>
+	static void putElements(std::ostream& out, const std::vector<T>& values, std::false_type) {
+		for (auto& value : values) put(out, value);
+	}
+
+
+	template<typename T>
+	static void getElements(std::istream& in, std::vector<T>& values, std::true_type) {
+		in.read(reinterpret_cast<char*>(values.data()), (std::streamsize) (values.size() * sizeof(T)));
+	}
+
+
+	template<typename T>
+	static void getElements(std::istream& in, std::vector<T>& values, std::false_type) {
+		for (auto& value : values) get(in, value);
+	}
+};
+
+#endif
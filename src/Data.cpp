@@ -3,6 +3,9 @@
 #include <string>
 #include <cassert>
 #include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iomanip>
 #include "Data.hpp"
 #include "Random.hpp"
 
@@ -12,8 +15,14 @@ using namespace std;
 Data::Data(string input, string fasta)
   : inputName(input), fastaName(fasta), withFasta(fasta != ""),
 	populationSize(0), nbGenerations(0),
-	nbReplicates(0), executionMode(_EXECUTION_MODE_NONE_),
+	nbReplicates(0), seed(0), hasSeed(false),
+	nbThreads(0), batchSize(_DEFAULT_BATCH_SIZE_),
+	outputBlockSize(_DEFAULT_OUTPUT_BLOCK_SIZE_), checkpointPeriod(0), isBinaryOutput(false),
+	isStatisticsOutput(false), statisticsBins(_DEFAULT_STATISTICS_BINS_),
+	isLockstep(true), diffusionThreshold(0.0),
+	executionMode(_EXECUTION_MODE_NONE_),
 	mutationModel(_MUTATION_MODEL_NONE_), kimuraDelta(0.0),
+	compactionPeriod(_DEFAULT_MUTATION_COMPACTION_),
 	migrationModel(_MIGRATION_MODEL_NONE_), migrationMode(_MIGRATION_MODE_NONE_),
 	isMigrationDetailedOutput(false),
 	popReduction(1), bottleneckStart(0), bottleneckEnd(0)
@@ -28,6 +37,35 @@ Data::Data(string input, string fasta)
 }
 
 
+Data::Data(const Data& sweep, const vector<string>& point)
+  : Data(sweep)
+{
+	assert(point.size() == sweptLines.size());
+
+	// the lines of the point are read as an input file of their own
+	size_t nbParameters = parameters.size();
+	string lines;
+
+	for (auto& line : point) {
+		lines += line + '\n';
+	}
+
+	istringstream pointFile(lines);
+	collectUserFile(pointFile);
+	parameters.resize(nbParameters);
+
+	for (size_t i = 0; i < point.size(); ++i) {
+		// the parameters of the point have its values instead of the ranges
+		size_t pos = ('\n' + parameters).find('\n' + sweptLines[i] + '\n');
+		assert(pos != string::npos);
+		parameters.replace(pos, sweptLines[i].size(), point[i]);
+	}
+
+	sweptLines.clear();
+	checkUserFile();
+}
+
+
 void Data::collectAll() {
 	// read user file
 	ifstream dataFile;
@@ -43,6 +81,16 @@ void Data::collectAll() {
 	// check the user file
 	checkUserFile();
 
+	if (!hasSeed) {
+		// draw a seed, and tell the user how to reproduce the run
+		random_device rd;
+		seed = ((unsigned long long) rd() << 32) | rd();
+		cout << "No seed specified, using " << _INPUT_KEY_SEED_ << " = " << seed << endl;
+	}
+
+	// every draw from now on (including the fasta parsing) derives from the seed
+	RandomDist::seed(seed);
+
 
 	if (withFasta) {
 		// read fasta file
@@ -58,11 +106,16 @@ void Data::collectAll() {
 
 		// check the fasta file
 		checkFastaFile();
+
+		// only the alleles and their counts are kept (and copied by the points of a sweep)
+		sequences.clear();
+
+		checkPopulationSize();
 	}
 }
 
 
-void Data::collectUserFile(ifstream& file) {
+void Data::collectUserFile(istream& file) {
 	string line, key;
 
 	while (getline(file, line)) {
@@ -74,7 +127,21 @@ void Data::collectUserFile(ifstream& file) {
 		);
 
 		// ignore comment lines
-		if (line[0] == _INPUT_COMMENT_) continue;
+		if (line.empty() || line[0] == _INPUT_COMMENT_) continue;
+
+		parameters += line + '\n';
+
+		// a line with ranges makes the run a sweep: it is read with its first values,
+		// and again by every point of the sweep with the values of the point
+		if (line.find(_SWEEP_RANGE_) != string::npos) {
+			if (line.compare(0, line.find(_INPUT_DECLARATION_), _INPUT_KEY_MARKER_SITES_) == 0) {
+				cerr << _ERROR_SWEEP_INVALID_MSG_ << endl;
+				exit(_ERROR_SWEEP_INVALID_CODE_);
+			}
+
+			sweptLines.push_back(line);
+			line = expandRanges(line).front();
+		}
 
 		stringstream ss(line);
 		getline(ss, key, _INPUT_DECLARATION_);
@@ -90,7 +157,7 @@ void Data::collectUserFile(ifstream& file) {
 
 			case str2int(_INPUT_KEY_POPULATION_SIZE_):
 				if (!withFasta)
-					extractValue<int>(populationSize, line, strToInt);
+					extractValue<long long>(populationSize, line, strToLongLong);
 				break;
 
 			case str2int(_INPUT_KEY_INITIAL_FREQ_):
@@ -106,6 +173,70 @@ void Data::collectUserFile(ifstream& file) {
 				extractValue<int>(executionMode, line, strToInt);
 				break;
 
+			case str2int(_INPUT_KEY_SEED_):
+				extractValue<unsigned long long>(seed, line, strToUnsignedLongLong);
+				hasSeed = true;
+				break;
+
+			case str2int(_INPUT_KEY_THREADS_):
+				extractValue<int>(nbThreads, line, strToInt);
+				break;
+
+			case str2int(_INPUT_KEY_BATCH_SIZE_):
+				extractValue<int>(batchSize, line, strToInt);
+				break;
+
+			case str2int(_INPUT_KEY_OUTPUT_BLOCK_SIZE_):
+				extractValue<int>(outputBlockSize, line, strToInt);
+				break;
+
+			case str2int(_INPUT_KEY_OUTPUT_BINARY_):
+				{
+					int binaryOutput = 0;
+					extractValue<int>(binaryOutput, line, strToInt);
+
+					isBinaryOutput = binaryOutput == 1;
+				}
+				break;
+
+			case str2int(_INPUT_KEY_OUTPUT_STATISTICS_):
+				{
+					int statisticsOutput = 0;
+					extractValue<int>(statisticsOutput, line, strToInt);
+
+					isStatisticsOutput = statisticsOutput == 1;
+				}
+				break;
+
+			case str2int(_INPUT_KEY_STATISTICS_BINS_):
+				extractValue<int>(statisticsBins, line, strToInt);
+				break;
+
+			case str2int(_INPUT_KEY_LOCKSTEP_):
+				{
+					int lockstep = 1;
+					extractValue<int>(lockstep, line, strToInt);
+
+					isLockstep = lockstep == 1;
+				}
+				break;
+
+			case str2int(_INPUT_KEY_DIFFUSION_):
+				extractValue<double>(diffusionThreshold, line, strToDouble);
+				break;
+
+			case str2int(_INPUT_KEY_CHECKPOINT_):
+				extractValue<int>(checkpointPeriod, line, strToInt);
+				break;
+
+			case str2int(_INPUT_KEY_RECORD_):
+				recordSchedule = line.substr(key.size() + 1);
+				break;
+
+			case str2int(_INPUT_KEY_DEMOGRAPHY_):
+				demographySchedule = line.substr(key.size() + 1);
+				break;
+
 			// MUTATIONS
 			case str2int(_INPUT_KEY_MUTATION_RATES_):
 				extractValues<double>(mutationRates, line, strToDouble);
@@ -119,6 +250,10 @@ void Data::collectUserFile(ifstream& file) {
 				extractValues<double>(felsensteinConstants, line, strToDouble);
 				break;
 
+			case str2int(_INPUT_KEY_MUTATION_COMPACTION_):
+				extractValue<int>(compactionPeriod, line, strToInt);
+				break;
+
 			// MIGRATIONS
 			case str2int(_INPUT_KEY_MIGRATION_MODEL_):
 				extractValue<int>(migrationModel, line, strToInt);
@@ -137,6 +272,10 @@ void Data::collectUserFile(ifstream& file) {
 				}
 				break;
 
+			case str2int(_INPUT_KEY_MIGRATION_GRAPH_):
+				migrationGraphFile = line.substr(key.size() + 1);
+				break;
+
             // SELECTION
 			case str2int(_INPUT_KEY_SELECTION_RATES_):
 				extractValues<double>(selections, line, strToDouble);
@@ -176,6 +315,43 @@ void Data::checkUserFile() {
 		nbReplicates = 1;
 	}
 
+	if (nbThreads < 0) {
+		cerr << "Error: number of threads must be >= 0, letting the system decide." << endl;
+		nbThreads = 0;
+	}
+
+	if (!(batchSize > 0)) {
+		cerr << "Error: batch size must be > 0, using " << _DEFAULT_BATCH_SIZE_ << "." << endl;
+		batchSize = _DEFAULT_BATCH_SIZE_;
+	}
+
+	if (!(outputBlockSize > 0)) {
+		cerr << "Error: output block size must be > 0, using " << _DEFAULT_OUTPUT_BLOCK_SIZE_ << "." << endl;
+		outputBlockSize = _DEFAULT_OUTPUT_BLOCK_SIZE_;
+	}
+
+	if (checkpointPeriod < 0) {
+		cerr << "Error: checkpoint period must be >= 0, writing no checkpoints." << endl;
+		checkpointPeriod = 0;
+	}
+
+	if (!(statisticsBins > 0)) {
+		cerr << "Error: number of statistics bins must be > 0, using " << _DEFAULT_STATISTICS_BINS_ << "." << endl;
+		statisticsBins = _DEFAULT_STATISTICS_BINS_;
+	}
+
+	if (diffusionThreshold < 0.0) {
+		cerr << "Error: diffusion threshold must be >= 0, using exact sampling." << endl;
+		diffusionThreshold = 0.0;
+	}
+
+	collectRecordSchedule();
+
+	if (compactionPeriod < 0) {
+		cerr << "Error: compaction period must be >= 0, using " << _DEFAULT_MUTATION_COMPACTION_ << "." << endl;
+		compactionPeriod = _DEFAULT_MUTATION_COMPACTION_;
+	}
+
 	if (!withFasta) {
 		// check for sufficient population
 		if (!(populationSize > 0)) {
@@ -189,18 +365,21 @@ void Data::checkUserFile() {
 			exit(_ERROR_NO_INITIAL_FREQUENCIES_CODE_);
 		}
 
-		// generate allelesn and allele counts
+		// generate allelesn and allele counts (again at the points of a sweep)
+		alleles.clear();
+		allelesCount.clear();
+
 		for (size_t i = 0; i < allelesFqs.size(); ++i) {
 			string idx = to_string(i);
 
 			alleles.push_back(idx);
-			allelesCount.push_back((unsigned int) (allelesFqs[i] * populationSize));
+			allelesCount.push_back((unsigned long long) (allelesFqs[i] * populationSize));
 		}
 
 		// check for correct alleles count
-		int allelesCountSum = 0;
+		long long allelesCountSum = 0;
 		for (auto& alleleCount : allelesCount)
-			allelesCountSum += alleleCount;
+			allelesCountSum += (long long) alleleCount;
 
 		if (allelesCountSum != populationSize) {
 			cerr << "Error: number of individuals does not match population size. Is the sum of the allele frequencies 1?" << endl;
@@ -293,12 +472,111 @@ void Data::checkUserFile() {
 			exit( _ERROR_NO_EXECUTION_MODE_CODE_);
 			break;
 	}
+
+	// the size of the fasta population is only known once the file is read
+	if (populationSize > 0) {
+		checkPopulationSize();
+	}
+}
+
+
+void Data::checkPopulationSize() {
+	collectDemography();
+
+	// the replicates simulated one by one count their individuals with ints
+	if (getMaxPopulationSize() > INT_MAX) {
+		bool isLockstepMode = executionMode == _EXECUTION_MODE_NONE_
+			|| executionMode == _EXECUTION_MODE_SELECTION_
+			|| executionMode == _EXECUTION_MODE_BOTTLENECK_;
+
+		if (!isLockstep || !isLockstepMode) {
+			cerr << _ERROR_POPULATION_SIZE_TOO_LARGE_MSG_ << endl;
+			exit(_ERROR_POPULATION_SIZE_TOO_LARGE_CODE_);
+		}
+	}
+
+	if (isBinaryOutput && getMaxPopulationSize() > UINT_MAX) {
+		cerr << "Error: the binary output stores 32-bit counts, disabling it for populations of more than " << UINT_MAX << " individuals." << endl;
+		isBinaryOutput = false;
+	}
+}
+
+
+void Data::collectDemography() {
+	demography.reset();
+
+	if (!demographySchedule.empty()) {
+		vector<Demography::Epoch> epochs;
+		if (!Demography::parse(demographySchedule, epochs)) {
+			cerr << _ERROR_DEMOGRAPHY_INVALID_MSG_ << endl;
+			exit(_ERROR_DEMOGRAPHY_INVALID_CODE_);
+		}
+
+		demography = make_shared<const Demography>(populationSize, epochs, nbGenerations);
+
+	} else if (executionMode == _EXECUTION_MODE_BOTTLENECK_) {
+		demography = make_shared<const Demography>(Demography::bottleneck(populationSize, bottleneckStart, bottleneckEnd, popReduction));
+	}
+}
+
+
+void Data::collectRecordSchedule() {
+	const string every(_RECORD_SCHEDULE_EVERY_), logSpaced(_RECORD_SCHEDULE_LOG_);
+
+	// the initial and last generations are always recorded
+	recordedGenerations = { 0, nbGenerations };
+
+	try {
+		if (recordSchedule.empty() || recordSchedule.compare(0, every.size(), every) == 0) {
+			int period = recordSchedule.empty() ? 1 : stoi(recordSchedule.substr(every.size()));
+			if (!(period > 0)) throw invalid_argument("recording period must be > 0");
+
+			for (int t = period; t < nbGenerations; t += period) {
+				recordedGenerations.push_back(t);
+			}
+
+		} else if (recordSchedule.compare(0, logSpaced.size(), logSpaced) == 0) {
+			int nPoints = stoi(recordSchedule.substr(logSpaced.size()));
+			if (!(nPoints > 0)) throw invalid_argument("number of log-spaced generations must be > 0");
+
+			// geometric progression from 1 to the last generation, the close ones merge
+			for (int i = 0; i + 1 < nPoints; ++i) {
+				recordedGenerations.push_back((int) round(pow((double) nbGenerations, i / (nPoints - 1.0))));
+			}
+
+		} else {
+			stringstream ss(recordSchedule);
+			string strValue;
+
+			while (getline(ss, strValue, _INPUT_SEPARATOR_)) {
+				int t = stoi(strValue);
+
+				if (t < 0 || t > nbGenerations) {
+					cerr << "Error: recorded generation " << t << " is out of bounds, ignoring it." << endl;
+				} else {
+					recordedGenerations.push_back(t);
+				}
+			}
+		}
+
+	} catch (logic_error& e) {
+		cerr << "Error: invalid recording schedule '" << recordSchedule << "', recording every generation." << endl;
+
+		recordSchedule.clear();
+		collectRecordSchedule();
+		return;
+	}
+
+	sort(recordedGenerations.begin(), recordedGenerations.end());
+	recordedGenerations.erase(unique(recordedGenerations.begin(), recordedGenerations.end()), recordedGenerations.end());
 }
 
 
 void Data::collectFastaFile(ifstream& file) {
 	populationSize = 0;
 
+	const string possibleChars(Nucl::possibleChars);
+
 	string line;
 	while (getline(file, line)) {
 
@@ -310,7 +588,12 @@ void Data::collectFastaFile(ifstream& file) {
 
 		string seq = "";
 		size_t lineLength = line.size();
-		for (auto& marker : markerSites) {
+
+		// without marker sites, every site of the sequence is kept
+		size_t nbSites = markerSites.empty() ? lineLength : markerSites.size();
+		for (size_t i = 0; i < nbSites; ++i) {
+			size_t marker = markerSites.empty() ? i : markerSites[i];
+
 			// check that the marker is valid
 			if (marker >= lineLength) {
 				cerr << _ERROR_MARKER_SITE_OUT_OF_BOUNDS_MSG_ << endl;
@@ -318,7 +601,7 @@ void Data::collectFastaFile(ifstream& file) {
 			}
 
 			char c = line[marker];
-			if (string(Nucl::possibleChars).find(c) != string::npos) {
+			if (possibleChars.find(c) != string::npos) {
 				seq += c;
 			}
 			else {
@@ -329,33 +612,58 @@ void Data::collectFastaFile(ifstream& file) {
 
 		sequences.push_back(seq);
 	}
+
+	// whole sequences are cut to the shortest one, the sites present in every individual
+	if (markerSites.empty() && !sequences.empty()) {
+		size_t shortest = sequences.front().size();
+		for (auto& seq : sequences) {
+			shortest = min(shortest, seq.size());
+		}
+
+		for (auto& seq : sequences) {
+			seq.resize(shortest);
+		}
+	}
 }
 
 
 void Data::checkFastaFile() {
-	// count the alleles
-	list<string> uniqueSequences = sequences;
+	// count the alleles: once sorted, the copies of a sequence follow each other
+	vector<const string*> sorted;
+	for (auto& seq : sequences) {
+		sorted.push_back(&seq);
+	}
+
+	sort(sorted.begin(), sorted.end(), [](const string* a, const string* b) { return *a < *b; });
 
-	// sort and remove the duplicates
-	uniqueSequences.sort();
-	uniqueSequences.unique();
+	for (size_t i = 0; i < sorted.size(); ) {
+		size_t j = i + 1;
+		while (j < sorted.size() && *sorted[j] == *sorted[i]) ++j;
 
-	for (auto& seq : uniqueSequences) {
-		auto count = (unsigned int) count_if(sequences.begin(), sequences.end(), [&](string allele) {
-				return allele == seq;
-		});
+		allelesCount.push_back((unsigned long long) (j - i));
+		alleles.push_back(*sorted[i]);
+
+		i = j;
+	}
 
-		allelesCount.push_back(count);
-		alleles.push_back(seq);
+	// the mutated sites are packed with their nucleotide (see SparseHaplotypes)
+	if (executionMode == _EXECUTION_MODE_MUTATIONS_ && !alleles.empty() && alleles.front().size() >= (size_t) _MAX_HAPLOTYPE_SITES_) {
+		cerr << _ERROR_SEQUENCE_TOO_LONG_MSG_ << endl;
+		exit(_ERROR_SEQUENCE_TOO_LONG_CODE_);
 	}
 }
 
 
-int Data::getPopulationSize() const {
+long long Data::getPopulationSize() const {
 	return populationSize;
 }
 
 
+long long Data::getMaxPopulationSize() const {
+	return demography ? std::max(populationSize, demography->getMaxSize()) : populationSize;
+}
+
+
 int Data::getNbGenerations() const {
 	return nbGenerations;
 }
@@ -366,12 +674,201 @@ int Data::getNbReplicates() const {
 }
 
 
+unsigned long long Data::getSeed() const {
+	return seed;
+}
+
+
+bool Data::getIsSeeded() const {
+	return hasSeed;
+}
+
+
+const vector<string>& Data::getSweptLines() const {
+	return sweptLines;
+}
+
+
+vector< vector<string> > Data::getSweepPoints() const {
+	vector< vector<string> > points(1);
+
+	for (auto& line : sweptLines) {
+		vector< vector<string> > expanded;
+
+		for (auto& point : points) {
+			for (auto& value : expandRanges(line)) {
+				expanded.push_back(point);
+				expanded.back().push_back(value);
+			}
+		}
+
+		points.swap(expanded);
+	}
+
+	return points;
+}
+
+
+vector<string> Data::expandRanges(const string& line) {
+	// without a key, the whole line is the value
+	size_t valuesStart = line.find(_INPUT_DECLARATION_) + 1;
+	vector<string> lines = { line.substr(0, valuesStart) };
+	bool isInteger = valuesStart > 0 && isIntegerKey(line.substr(0, valuesStart - 1));
+
+	stringstream ss(line.substr(valuesStart));
+	string element;
+	for (bool isFirst = true; getline(ss, element, _INPUT_SEPARATOR_); isFirst = false) {
+		vector<string> values;
+		size_t range = element.find(_SWEEP_RANGE_);
+
+		if (range == string::npos) {
+			values.push_back(element);
+		} else {
+			size_t count = element.find(_SWEEP_RANGE_VALUES_, range);
+			double first = 0.0, last = 0.0;
+			int nValues = 0;
+
+			try {
+				size_t lastStart = range + string(_SWEEP_RANGE_).size();
+				first = stod(element.substr(0, range));
+				last = stod(element.substr(lastStart, count - lastStart));
+				nValues = count == string::npos ? 0 : stoi(element.substr(count + 1));
+			} catch (logic_error& e) {
+				nValues = 0;
+			}
+
+			if (!(nValues > 0)) {
+				cerr << _ERROR_SWEEP_INVALID_MSG_ << endl;
+				exit(_ERROR_SWEEP_INVALID_CODE_);
+			}
+
+			// evenly spaced, both ends included
+			for (int i = 0; i < nValues; ++i) {
+				double step = nValues == 1 ? first : first + (last - first) * i / (nValues - 1);
+				ostringstream value;
+
+				if (!isInteger) {
+					value << setprecision(12) << step;
+				} else if (step == floor(step)) {
+					value << (long long) step;
+				} else {
+					cerr << _ERROR_SWEEP_INVALID_MSG_ << endl;
+					exit(_ERROR_SWEEP_INVALID_CODE_);
+				}
+
+				values.push_back(value.str());
+			}
+		}
+
+		vector<string> expanded;
+		for (auto& prefix : lines) {
+			for (auto& value : values) {
+				expanded.push_back(isFirst ? prefix + value : prefix + _INPUT_SEPARATOR_ + value);
+			}
+		}
+
+		lines.swap(expanded);
+	}
+
+	return lines;
+}
+
+
+bool Data::isIntegerKey(const string& key) {
+	switch (str2int(key.c_str())) {
+		case str2int(_INPUT_KEY_GENERATIONS_):
+		case str2int(_INPUT_KEY_REPLICAS_):
+		case str2int(_INPUT_KEY_POPULATION_SIZE_):
+		case str2int(_INPUT_KEY_MODE_):
+		case str2int(_INPUT_KEY_SEED_):
+		case str2int(_INPUT_KEY_THREADS_):
+		case str2int(_INPUT_KEY_BATCH_SIZE_):
+		case str2int(_INPUT_KEY_OUTPUT_BLOCK_SIZE_):
+		case str2int(_INPUT_KEY_OUTPUT_BINARY_):
+		case str2int(_INPUT_KEY_OUTPUT_STATISTICS_):
+		case str2int(_INPUT_KEY_STATISTICS_BINS_):
+		case str2int(_INPUT_KEY_LOCKSTEP_):
+		case str2int(_INPUT_KEY_CHECKPOINT_):
+		case str2int(_INPUT_KEY_MUTATION_COMPACTION_):
+		case str2int(_INPUT_KEY_MIGRATION_MODEL_):
+		case str2int(_INPUT_KEY_MIGRATION_RATES_):
+		case str2int(_INPUT_KEY_MIGRATION_DETAILED_OUTPUT_):
+		case str2int(_INPUT_KEY_BOTTLENECK_START_TIME_):
+		case str2int(_INPUT_KEY_BOTTLENECK_END_TIME_):
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+
+int Data::getNbThreads() const {
+	return nbThreads;
+}
+
+
+int Data::getBatchSize() const {
+	return batchSize;
+}
+
+
+int Data::getOutputBlockSize() const {
+	return outputBlockSize;
+}
+
+
+const std::vector<int>& Data::getRecordedGenerations() const {
+	return recordedGenerations;
+}
+
+
+std::shared_ptr<const Demography> Data::getDemography() const {
+	return demography;
+}
+
+
+int Data::getCheckpointPeriod() const {
+	return checkpointPeriod;
+}
+
+
+bool Data::getIsBinaryOutput() const {
+	return isBinaryOutput;
+}
+
+
+bool Data::getIsStatisticsOutput() const {
+	return isStatisticsOutput;
+}
+
+
+int Data::getStatisticsBins() const {
+	return statisticsBins;
+}
+
+
+bool Data::getIsLockstep() const {
+	return isLockstep;
+}
+
+
+double Data::getDiffusionThreshold() const {
+	return diffusionThreshold;
+}
+
+
+const std::string& Data::getParameters() const {
+	return parameters;
+}
+
+
 size_t Data::getNbAlleles() const {
 	return allelesCount.size();
 }
 
 
-const std::vector<unsigned int>& Data::getAllelesCount() const {
+const std::vector<unsigned long long>& Data::getAllelesCount() const {
 	return allelesCount;
 }
 
@@ -411,6 +908,11 @@ const std::vector<double>& Data::getFelsensteinConstants() const {
 }
 
 
+int Data::getCompactionPeriod() const {
+	return compactionPeriod;
+}
+
+
 int Data::getMigrationModel() const {
 	return migrationModel;
 }
@@ -426,6 +928,11 @@ const std::vector<int>& Data::getMigrationRates() const {
 }
 
 
+const std::string& Data::getMigrationGraphFile() const {
+	return migrationGraphFile;
+}
+
+
 bool Data::getIsDetailedOutput() const {
 	return isMigrationDetailedOutput;
 }
@@ -8,7 +8,9 @@
 #include <sstream>
 #include <fstream>
 #include <functional> 
+#include <memory>
 #include "Globals.hpp"
+#include "Demography.hpp"
 
 
 /** \brief Class regrouping the data necessary to run a simulation
@@ -29,13 +31,31 @@ public:
 	 * \param fasta 		the path of the fasta file to be read
 	 * */
 	Data(std::string input, std::string fasta);
+
+
+	/** \brief Data constructor of a point of a sweep
+	 *
+	 * Copies the data of the sweep, without reading its files again, and
+	 * sets the swept parameters to their values at the point.
+	 *
+	 * \param sweep			the data of the sweep, with its parameter ranges
+	 * \param point			one line per swept parameter, as given by getSweepPoints()
+	 * */
+	Data(const Data& sweep, const std::vector<std::string>& point);
 	
 	
 	/** \brief Getter of the size of the populationSize
 	 *
-	 * 	\return populationSize, an int
+	 * 	\return populationSize, a long long
+	 * */
+	long long getPopulationSize() const;
+
+
+	/** \brief Get the largest population size reached during a run
+	 *
+	 * The initial size, unless the demography enlarges the population.
 	 * */
-	int getPopulationSize() const;
+	long long getMaxPopulationSize() const;
 
 
 	/** \brief Getter of the number of generations
@@ -52,6 +72,133 @@ public:
 	int getNbReplicates() const;
 
 
+	/** \brief Getter of the global random seed
+	 *
+	 * Every replicate draws from its own stream derived from this seed
+	 * and its index, so that runs are reproducible.
+	 *
+	 * 	\return seed, an unsigned long long
+	 * */
+	unsigned long long getSeed() const;
+
+
+	/** \brief Check whether the seed was given in the input file (else it was drawn)
+	 *
+	 * 	\return hasSeed, a bool
+	 * */
+	bool getIsSeeded() const;
+
+
+	/** \brief Get the parameter lines with ranges (first..last:n), which make the run a sweep
+	 *
+	 * 	\return sweptLines, the lines as read (without whitespace), in the order of the input file
+	 * */
+	const std::vector<std::string>& getSweptLines() const;
+
+
+	/** \brief Get the points of the sweep: every combination of the values of the ranges
+	 *
+	 * The ranges of the first lines vary the slowest.
+	 *
+	 * \return For every point, the lines of getSweptLines() with the values of the point
+	 * */
+	std::vector< std::vector<std::string> > getSweepPoints() const;
+
+
+	/** \brief Expand the ranges of a parameter line
+	 *
+	 * A range first..last:n stands for n evenly spaced values, from first
+	 * to last. A line may hold several ranges (e.g. one per allele).
+	 * The values of an integer parameter have to be integers.
+	 *
+	 * \param line			the parameter line, without whitespace
+	 *
+	 * \return The line with every combination of the values of its ranges
+	 * */
+	static std::vector<std::string> expandRanges(const std::string& line);
+
+
+	/** \brief Getter of the number of threads requested by the user
+	 *
+	 * 	\return nbThreads, an int (0 to let the system decide)
+	 * */
+	int getNbThreads() const;
+
+
+	/** \brief Getter of the number of replicates per scheduled task
+	 *
+	 * 	\return batchSize, an int
+	 * */
+	int getBatchSize() const;
+
+
+	/** \brief Getter of the number of generations per output block
+	 *
+	 * The output of a block is written while the next block is simulated,
+	 * so the memory used for the results is proportional to the block size.
+	 *
+	 * 	\return outputBlockSize, an int
+	 * */
+	int getOutputBlockSize() const;
+
+
+	/** \brief Get the generations whose output is recorded
+	 *
+	 * The other generations are simulated without any output.
+	 *
+	 * \return The recorded generations in increasing order, always including 0 and the last one
+	 * */
+	const std::vector<int>& getRecordedGenerations() const;
+
+
+	/** \brief Get the size of the population at every generation
+	 *
+	 * From the DEMOGRAPHY epochs, or from the bottleneck in the bottleneck mode.
+	 *
+	 * \return The demography, shared by the replicates, null if the size does not change
+	 * */
+	std::shared_ptr<const Demography> getDemography() const;
+
+
+	/** \brief Get the number of generations between two checkpoints (0: none)
+	 * */
+	int getCheckpointPeriod() const;
+
+
+	/** \brief Get whether the raw counts should also be written to the binary result file
+	 * */
+	bool getIsBinaryOutput() const;
+
+
+	/** \brief Get whether only the statistics across replicates should be written
+	 * */
+	bool getIsStatisticsOutput() const;
+
+
+	/** \brief Get the number of histogram bins used to estimate the frequency quantiles
+	 * */
+	int getStatisticsBins() const;
+
+
+	/** \brief Get whether the replicates of a batch should be advanced together
+	 * */
+	bool getIsLockstep() const;
+
+
+	/** \brief Get the minimal variance of a binomial draw replaced by a Gaussian one
+	 *
+	 * \return The threshold, 0 for exact sampling
+	 * */
+	double getDiffusionThreshold() const;
+
+
+	/** \brief Get the run parameters
+	 *
+	 * \return The parameter lines of the input file (comments and blanks removed)
+	 * */
+	const std::string& getParameters() const;
+
+
 	/** \brief Getter of the number of alleles
 	 *
 	 * 	\return numberAlleles, a size_t
@@ -63,7 +210,7 @@ public:
 	 * 
 	 * 	\return a vector of unsigned integers, the allele counts
 	 * */
-	const std::vector<unsigned int>& getAllelesCount() const;
+	const std::vector<unsigned long long>& getAllelesCount() const;
 
 
 	/** \brief Getter of the vector of the alleles
@@ -114,6 +261,13 @@ public:
 	const std::vector<double>& getFelsensteinConstants() const;
 
 
+	/** \brief Get the number of generations between two compactions of the extinct alleles
+	 *
+	 * \return The period, 0 to never compact
+	 * */
+	int getCompactionPeriod() const;
+
+
 	/** \brief Get the migration model to use for a Simulation (comppleteGraph, Star, ...)
 	 *
 	 * */
@@ -134,6 +288,13 @@ public:
      * \return The migration rates, a vector of integers
      * */
     const std::vector<int>& getMigrationRates() const;
+
+
+	/** \brief Get the edge-list file of the migration graph
+	 *
+	 * \return The path of the file, empty if the graph is built from MIG_MODEL and MIG_RATES
+	 * */
+	const std::string& getMigrationGraphFile() const;
     
 
     /** \brief Get whether the output should be detailed if in migration mode
@@ -175,6 +336,15 @@ public:
 		return !str[h] ? 5381 : (str2int(str, h + 1) * 33) ^ str[h];
 	} 
 
+
+	/** \brief Whether the values of a parameter are integers
+	 *
+	 * \param key			the key of the parameter
+	 *
+	 * \return Whether the parameter is read as an integer
+	 * */
+	static bool isIntegerKey(const std::string& key);
+
     
     /** \brief Extracts a value from a line
 	 * 
@@ -214,6 +384,9 @@ public:
 		std::stringstream ss(line);
 		std::getline(ss, key, _INPUT_DECLARATION_); // separate key from value
 
+		// the values of a line replace the previous ones (e.g. at a point of a sweep)
+		into.clear();
+
 		while (std::getline(ss, strValue, _INPUT_SEPARATOR_)) {
 			try {
 				//add elements found between each separators
@@ -241,7 +414,7 @@ protected:
 	 * Reads the number of generations, the marker sites, the number of getReplicates
 	 * Also reads the migration probabilities of each nucleotide
 	 * */
-	void collectUserFile(std::ifstream& file);
+	void collectUserFile(std::istream& file);
 
 
 	/** \brief Checks the data from the user file
@@ -251,6 +424,29 @@ protected:
 	void checkUserFile();
 
 
+	/** \brief Builds the recorded generations from the RECORD schedule
+	 *
+	 * Every k-th generation ("every k"), n log-spaced generations ("log n")
+	 * or a list of generations; every generation without a schedule.
+	 * */
+	void collectRecordSchedule();
+
+
+	/** \brief Compiles the size of the population at every generation
+	 *
+	 * Needs the initial size (see checkPopulationSize()).
+	 * */
+	void collectDemography();
+
+
+	/** \brief Checks the counts can hold the largest population of the run
+	 *
+	 * Compiles the demography first: it is called once the initial size is
+	 * known, from the user file or from the fasta file.
+	 * */
+	void checkPopulationSize();
+
+
 	/** \brief Collects data from the fasta file
 	 *
 	 * Calculates the number of individuals/size of the population
@@ -285,8 +481,16 @@ private:
 	bool withFasta;
 
 
-	//!< Size of the population, an int
-	int populationSize;
+	//!< Parameter lines of the user input file
+	std::string parameters;
+
+
+	//!< Parameter lines with ranges, if the run is a sweep
+	std::vector<std::string> sweptLines;
+
+
+	//!< Size of the population, a long long
+	long long populationSize;
 
 	
 	//!< Number of generations (number of simulation steps), an int
@@ -297,6 +501,66 @@ private:
 	int nbReplicates;
 
 	
+	//!< Global random seed
+	unsigned long long seed;
+
+
+	//!< Flag set if the seed was given in the input file
+	bool hasSeed;
+
+	
+	//!< Number of threads requested by the user (0 for automatic), an int
+	int nbThreads;
+
+
+	//!< Number of replicates per scheduled task, an int
+	int batchSize;
+
+	
+	//!< Number of generations per output block, an int
+	int outputBlockSize;
+
+	
+	//!< RECORD schedule, as read from the user file (empty: every generation)
+	std::string recordSchedule;
+
+
+	//!< Generations whose output is recorded, in increasing order
+	std::vector<int> recordedGenerations;
+
+
+	//!< DEMOGRAPHY schedule, as read from the user file (empty: constant size, or the bottleneck)
+	std::string demographySchedule;
+
+
+	//!< Size of the population at every generation, null if it does not change
+	std::shared_ptr<const Demography> demography;
+
+
+	//!< Number of generations between two checkpoints (0: none), an int
+	int checkpointPeriod;
+
+
+	//!< Flag for the binary output of the raw counts
+	bool isBinaryOutput;
+
+
+	//!< Flag for the statistics output mode
+	bool isStatisticsOutput;
+
+
+	//!< Number of histogram bins for the quantiles
+	int statisticsBins;
+
+
+	//!< Flag for the lockstep engine (batches of replicates stored together)
+	bool isLockstep;
+
+
+	//!< Minimal variance of a binomial draw for the diffusion approximation (0: exact)
+	double diffusionThreshold;
+
+	
 	//!< Vector containing the allele frequencies when running without fasta file
 	std::vector<double> allelesFqs;
 
@@ -306,7 +570,7 @@ private:
 	
 	
 	//!< Vector of double containing the allele frequencies of the fasta file
-	std::vector<unsigned int> allelesCount;
+	std::vector<unsigned long long> allelesCount;
 
 	
 	//!< Vector of double containing the user marker sites
@@ -337,6 +601,10 @@ private:
 	std::vector<double> felsensteinConstants;
 
 
+	//!< Generations between two compactions of the extinct alleles (0: never)
+	int compactionPeriod;
+
+
 	//!< Migration  model (complete graph, ring, star)
     int migrationModel;
     
@@ -353,6 +621,10 @@ private:
     bool isMigrationDetailedOutput;
 
 
+	//!< Edge-list file of the migration graph (empty: built from the model and the rates)
+	std::string migrationGraphFile;
+
+
 	//!< Vector of double containing the selection probabilities of the alleles
 	std::vector<double> selections;
 
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include "Demography.hpp"
+#include "Globals.hpp"
+
+
+Demography::Demography(long long initialSize, const std::vector<Epoch>& epochs, int nGenerations)
+  : sizes((std::size_t) std::max(nGenerations, 0) + 1, initialSize)
+{
+	assert(initialSize > 0);
+
+	std::size_t epoch = 0;
+	for (std::size_t t = 1; t < sizes.size(); ++t) {
+		// the epoch of the step from generation t - 1
+		while (epoch < epochs.size() && epochs[epoch].start < (int) t) ++epoch;
+		if (epoch == 0) continue;
+
+		const Epoch& e = epochs[epoch - 1];
+		double initial = (double) sizes[(std::size_t) e.start];
+		double elapsed = (double) t - e.start;
+		double size = initial;
+
+		switch (e.kind) {
+			case _EPOCH_CONSTANT_:
+				size = e.size;
+				break;
+
+			case _EPOCH_EXPONENTIAL_:
+				size = initial * std::exp(e.rate * elapsed);
+				break;
+
+			case _EPOCH_LOGISTIC_:
+				size = e.size / (1.0 + (e.size / initial - 1.0) * std::exp(-e.rate * elapsed));
+				break;
+
+			default:
+				break;
+		}
+
+		// at least one individual, and sizes the counts can hold
+		sizes[t] = (long long) std::llround(std::min(std::max(size, 1.0), 9.0e18));
+	}
+}
+
+
+Demography::Demography(const std::vector<long long>& s)
+  : sizes(s)
+{	}
+
+
+Demography Demography::bottleneck(long long initialSize, int start, int end, double reduction) {
+	assert(reduction != 0.0);
+
+	std::vector<long long> sizes(1, initialSize);
+	long long size = initialSize;
+
+	for (int t = 0; t <= std::max(start, end); ++t) {
+		if (t == start) {
+			size = (long long) (size / reduction);
+		} else if (t == end) {
+			size = (long long) (size * reduction);
+		}
+
+		sizes.push_back(size);
+	}
+
+	return Demography(sizes);
+}
+
+
+bool Demography::parse(const std::string& schedule, std::vector<Epoch>& epochs) {
+	epochs.clear();
+
+	std::stringstream ss(schedule);
+	std::string element;
+
+	try {
+		while (std::getline(ss, element, _INPUT_SEPARATOR_)) {
+			// start:kind:parameters
+			std::size_t kindStart = element.find(_EPOCH_SEPARATOR_);
+			std::size_t parametersStart = element.find(_EPOCH_SEPARATOR_, kindStart + 1);
+			if (kindStart == std::string::npos || parametersStart == std::string::npos) return false;
+
+			std::string kind = element.substr(kindStart + 1, parametersStart - kindStart - 1);
+			std::string parameters = element.substr(parametersStart + 1);
+			std::size_t comma = parameters.find(_EPOCH_PARAMETER_SEPARATOR_);
+
+			Epoch epoch = { std::stoi(element.substr(0, kindStart)), 0, 0.0, 0.0 };
+
+			if (kind == _EPOCH_CONSTANT_NAME_ && comma == std::string::npos) {
+				epoch.kind = _EPOCH_CONSTANT_;
+				epoch.size = std::stod(parameters);
+			} else if (kind == _EPOCH_EXPONENTIAL_NAME_ && comma == std::string::npos) {
+				epoch.kind = _EPOCH_EXPONENTIAL_;
+				epoch.rate = std::stod(parameters);
+			} else if (kind == _EPOCH_LOGISTIC_NAME_ && comma != std::string::npos) {
+				epoch.kind = _EPOCH_LOGISTIC_;
+				epoch.rate = std::stod(parameters.substr(0, comma));
+				epoch.size = std::stod(parameters.substr(comma + 1));
+			} else {
+				return false;
+			}
+
+			// the sizes are counts of individuals
+			if (epoch.start < 0 || (epoch.kind != _EPOCH_EXPONENTIAL_ && !(epoch.size >= 1.0))
+				|| (!epochs.empty() && epoch.start <= epochs.back().start)) {
+				return false;
+			}
+
+			epochs.push_back(epoch);
+		}
+	} catch (std::logic_error&) {
+		// not a number (std::invalid_argument), or out of range
+		return false;
+	}
+
+	return !epochs.empty();
+}
+
+
+long long Demography::getMaxSize() const {
+	return *std::max_element(sizes.begin(), sizes.end());
+}
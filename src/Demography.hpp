@@ -0,0 +1,93 @@
+#ifndef DEMOGRAPHY_H
+#define DEMOGRAPHY_H
+
+#include <string>
+#include <vector>
+
+
+/** \brief Size of the population at every generation
+ *
+ * The size follows a list of epochs (constant, exponential or logistic),
+ * each starting at a generation and going on until the next one starts.
+ * The epochs are compiled once into a table of the sizes, which the
+ * replicates share: the size of a generation is looked up in O(1).
+ * Generation 0 is the initial population; the step from generation t
+ * draws getSize(t + 1) offspring.
+ *
+ * */
+class Demography {
+
+public:
+
+	//!< Epoch of the demography, from the input file
+	struct Epoch {
+		int start;				//!< Generation the epoch starts at: it sets the sizes of the generations after it
+		int kind;				//!< _EPOCH_CONSTANT_, _EPOCH_EXPONENTIAL_ or _EPOCH_LOGISTIC_
+		double rate;			//!< Growth rate per generation (exponential and logistic epochs)
+		double size;			//!< Size (constant epoch), or carrying capacity (logistic epoch)
+	};
+
+
+	/** \brief Demography constructor
+	 *
+	 * \param initialSize		size of the initial population
+	 * \param epochs			the epochs, by increasing start
+	 * \param nGenerations		number of generations of the run
+	 * */
+	Demography(long long initialSize, const std::vector<Epoch>& epochs, int nGenerations);
+
+
+	/** \brief Demography of the bottleneck mode
+	 *
+	 * The population is divided by \p reduction (truncated) at step \p start,
+	 * and multiplied back (truncated) at step \p end, as the sizes were
+	 * updated in place.
+	 *
+	 * \param initialSize		size of the initial population
+	 * \param start				step of the reduction
+	 * \param end				step of the recovery
+	 * \param reduction			reduction factor
+	 * */
+	static Demography bottleneck(long long initialSize, int start, int end, double reduction);
+
+
+	/** \brief Read the epochs of a schedule
+	 *
+	 * The epochs are separated by _INPUT_SEPARATOR_, and written
+	 * start:constant:N, start:exponential:r or start:logistic:r,K.
+	 *
+	 * \param schedule			the schedule, as read from the input file
+	 * \param epochs			the epochs read
+	 *
+	 * \return false if an epoch is invalid, or if the starts do not increase
+	 * */
+	static bool parse(const std::string& schedule, std::vector<Epoch>& epochs);
+
+
+	/** \brief Get the size of the population at a generation
+	 *
+	 * \param generation		the generation (the last size of the table applies after it)
+	 * */
+	long long getSize(int generation) const {
+		return sizes[(std::size_t) generation < sizes.size() ? (std::size_t) generation : sizes.size() - 1];
+	}
+
+
+	/** \brief Get the largest size of the population
+	 * */
+	long long getMaxSize() const;
+
+private:
+
+	/** \brief Demography constructor, from the table itself
+	 *
+	 * \param sizes				size of every generation
+	 * */
+	explicit Demography(const std::vector<long long>& sizes);
+
+
+	//!< Size of every generation, from generation 0
+	std::vector<long long> sizes;
+};
+
+#endif
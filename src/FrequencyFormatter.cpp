@@ -0,0 +1,87 @@
+#include <cmath>
+#include <cstdio>
+#include "FrequencyFormatter.hpp"
+
+namespace {
+	// largest number of decimals formatted from the integers
+	const std::size_t MAX_EXACT_PRECISION = 15;
+
+
+	// N * 10^precision must stay below this bound (2^52) for the integer formatting
+	const unsigned long long MAX_EXACT_SCALED_SIZE = 1ULL << 52;
+}
+
+
+FrequencyFormatter::FrequencyFormatter(std::size_t precision, unsigned long long populationSize)
+  : precision(precision), populationSize(populationSize),
+	reciprocal(1.0 / (double) populationSize)
+{
+	for (std::size_t i = 0; i < precision && i < MAX_EXACT_PRECISION; ++i) {
+		scale *= 10;
+	}
+
+	isExact = precision <= MAX_EXACT_PRECISION && populationSize > 0 && populationSize < MAX_EXACT_SCALED_SIZE / scale;
+}
+
+
+void FrequencyFormatter::append(std::string& out, unsigned long long count) const {
+	if (!isExact || count > populationSize) {
+		char buffer[512];
+		int length = std::snprintf(buffer, sizeof(buffer), "%.*f", (int) precision, count * 1.0 / populationSize);
+
+		if (length >= 0 && length < (int) sizeof(buffer)) {
+			out.append(buffer, (std::size_t) length);
+		} else {
+			std::string large((std::size_t) length + 1, '\0');
+			std::snprintf(&large[0], large.size(), "%.*f", (int) precision, count * 1.0 / populationSize);
+			out.append(large, 0, (std::size_t) length);
+		}
+
+		return;
+	}
+
+	// quotient and remainder of count * 10^precision / N, from the reciprocal
+	unsigned long long scaled = count * scale;
+	unsigned long long q = (unsigned long long) (scaled * reciprocal);
+	long long r = (long long) scaled - (long long) (q * populationSize);
+
+	while (r < 0) {
+		--q;
+		r += (long long) populationSize;
+	}
+	while (r >= (long long) populationSize) {
+		++q;
+		r -= (long long) populationSize;
+	}
+
+	// round to nearest, as the double would be
+	unsigned long long twice = 2 * (unsigned long long) r;
+	if (twice > populationSize) {
+		++q;
+	} else if (twice == populationSize) {
+		// count / N is a tie: its double lies on one side, or on the tie itself (then to even)
+		double side = std::fma(count * 1.0 / populationSize, 2.0 * scale, -(2.0 * q + 1.0));
+		if (side > 0.0 || (side == 0.0 && q % 2 == 1)) ++q;
+	}
+
+	// integer part, then the decimals (with their leading zeroes)
+	char buffer[48];
+	char* end = buffer + sizeof(buffer);
+	char* digit = end;
+
+	unsigned long long fraction = q % scale;
+	for (std::size_t i = 0; i < precision; ++i) {
+		*--digit = (char) ('0' + fraction % 10);
+		fraction /= 10;
+	}
+
+	if (precision > 0) *--digit = '.';
+
+	unsigned long long integer = q / scale;
+	do {
+		*--digit = (char) ('0' + integer % 10);
+		integer /= 10;
+	} while (integer > 0);
+
+	out.append(digit, (std::size_t) (end - digit));
+}
@@ -0,0 +1,64 @@
+#ifndef FREQUENCY_FORMATTER_H
+#define FREQUENCY_FORMATTER_H
+
+#include <string>
+
+
+/** \brief Fixed-point formatting of the allele frequencies of a generation
+ *
+ * Writes count / N with a fixed number of decimals, exactly as
+ * std::fixed and std::setprecision format the double count * 1.0 / N,
+ * but from the integer counts: one reciprocal of N for the generation,
+ * an integer product, quotient and remainder per frequency, and the
+ * digits written straight into the output string.
+ *
+ * The double count * 1.0 / N is within 2^-53 of count / N, so it rounds
+ * to the same decimals unless count / N lies within 2^-53 of a rounding
+ * tie, which cannot happen while N * 10^precision < 2^52 except on the
+ * tie itself: the direction of the double is then found exactly with
+ * a fused multiply-add. Larger populations or precisions are formatted
+ * by snprintf, as are the counts above N.
+ *
+ * */
+class FrequencyFormatter {
+
+public:
+
+	/** \brief FrequencyFormatter constructor
+	 *
+	 * \param precision			number of decimals
+	 * \param populationSize	size N of the population of the generation
+	 * */
+	FrequencyFormatter(std::size_t precision, unsigned long long populationSize);
+
+
+	/** \brief Append the frequency of an allele to a string
+	 *
+	 * \param out			the string written to
+	 * \param count			count of the allele
+	 * */
+	void append(std::string& out, unsigned long long count) const;
+
+private:
+
+	//!< Number of decimals
+	std::size_t precision;
+
+
+	//!< Size of the population
+	unsigned long long populationSize;
+
+
+	//!< 10^precision
+	unsigned long long scale = 1;
+
+
+	//!< 1 / populationSize
+	double reciprocal;
+
+
+	//!< Whether the integer formatting is exact (else snprintf)
+	bool isExact;
+};
+
+#endif
@@ -24,6 +24,12 @@ namespace Nucl {
 #define _FASTA_COMMENT_ '>'
 
 #define _OUTPUT_SEPARATOR_ '|'
+#define _OUTPUT_FILE_ "results.txt"
+#define _OUTPUT_BINARY_FILE_ "results.bin"
+#define _OUTPUT_STATISTICS_FILE_ "statistics.txt"
+#define _OUTPUT_ABSORPTION_FILE_ "absorption.txt"
+#define _OUTPUT_CHECKPOINT_FILE_ "checkpoint.bin"
+#define _OUTPUT_COUNTS_FILE_ "counts.bin"
 #define _MIN_OUTPUT_PRECISION_ 2
 
 #define _ERROR_INPUT_UNREADABLE_CODE_ 1
@@ -54,20 +60,35 @@ namespace Nucl {
 
 #define _ERROR_TOO_MANY_FELSENSTEIN_CONSTS_CODE_ 11
 
-#define _ERROR__CODE_ 
-#define _ERROR__MSG_ ""
+#define _ERROR_BINARY_OUTPUT_UNWRITABLE_CODE_ 12
+#define _ERROR_BINARY_OUTPUT_UNWRITABLE_MSG_ "Error: binary result file impossible to open."
 
-#define _ERROR__CODE_ 
-#define _ERROR__MSG_ ""
+#define _ERROR_POPULATION_SIZE_TOO_LARGE_CODE_ 13
+#define _ERROR_POPULATION_SIZE_TOO_LARGE_MSG_ "Error: populations of more than 2147483647 individuals can only be simulated by the lockstep engine (LOCKSTEP = 1, modes 0, 3 and 4)."
 
-#define _ERROR__CODE_ 
-#define _ERROR__MSG_ ""
+#define _ERROR_CHECKPOINT_INCOMPATIBLE_CODE_ 14
+#define _ERROR_CHECKPOINT_INCOMPATIBLE_MSG_ "Error: the checkpoint does not match this run or its output files. Only GEN, THREADS, OUTPUT_BLOCK and CHECKPOINT may change when resuming."
 
-#define _ERROR__CODE_ 
-#define _ERROR__MSG_ ""
+#define _ERROR_SHARD_INVALID_CODE_ 15
+#define _ERROR_SHARD_INVALID_MSG_ "Error: --shard i/n needs 0 <= i < n <= REP, and a SEED in the input file (the same for every shard)."
 
-#define _ERROR__CODE_ 
-#define _ERROR__MSG_ ""
+#define _ERROR_SHARD_UNSUPPORTED_CODE_ 16
+#define _ERROR_SHARD_UNSUPPORTED_MSG_ "Error: the shards can only write the output of every replicate of a single run, which OUTPUT_STATS, the mutation mode and the sweeps do not."
+
+#define _ERROR_SWEEP_INVALID_CODE_ 17
+#define _ERROR_SWEEP_INVALID_MSG_ "Error: a parameter range is written first..last:n, with n > 0 values (integers for an integer parameter), and the marker sites can not be swept (the fasta file is only read once)."
+
+#define _ERROR_MIGRATION_GRAPH_UNREADABLE_CODE_ 18
+#define _ERROR_MIGRATION_GRAPH_UNREADABLE_MSG_ "Error: the migration graph file can not be read, or has a line other than \"source target migrants\" (demes numbered from 0, no self-loops)."
+
+#define _ERROR_DEMOGRAPHY_INVALID_CODE_ 19
+#define _ERROR_DEMOGRAPHY_INVALID_MSG_ "Error: the epochs of the demography are written start:constant:N, start:exponential:r or start:logistic:r,K (N, K >= 1), by increasing start."
+
+#define _ERROR_SEQUENCE_TOO_LONG_CODE_ 20
+#define _ERROR_SEQUENCE_TOO_LONG_MSG_ "Error: the mutation mode simulates sequences of less than 1073741824 sites, select some of them with SITES."
+
+#define _ERROR_COUNTS_UNREADABLE_CODE_ 21
+#define _ERROR_COUNTS_UNREADABLE_MSG_ "Error: the counts of the mutation mode can not be read back from counts.bin to write its results."
 
 #define _INPUT_KEY_GENERATIONS_ "GEN"
 #define _INPUT_KEY_REPLICAS_ "REP"
@@ -75,6 +96,18 @@ namespace Nucl {
 #define _INPUT_KEY_INITIAL_FREQ_ "FREQ"
 #define _INPUT_KEY_MARKER_SITES_ "SITES"
 #define _INPUT_KEY_MODE_ "MODE"
+#define _INPUT_KEY_SEED_ "SEED"
+#define _INPUT_KEY_THREADS_ "THREADS"
+#define _INPUT_KEY_BATCH_SIZE_ "BATCH"
+#define _INPUT_KEY_OUTPUT_BLOCK_SIZE_ "OUTPUT_BLOCK"
+#define _INPUT_KEY_OUTPUT_BINARY_ "OUTPUT_BINARY"
+#define _INPUT_KEY_OUTPUT_STATISTICS_ "OUTPUT_STATS"
+#define _INPUT_KEY_STATISTICS_BINS_ "STATS_BINS"
+#define _INPUT_KEY_LOCKSTEP_ "LOCKSTEP"
+#define _INPUT_KEY_DIFFUSION_ "DIFFUSION"
+#define _INPUT_KEY_RECORD_ "RECORD"
+#define _INPUT_KEY_DEMOGRAPHY_ "DEMOGRAPHY"
+#define _INPUT_KEY_CHECKPOINT_ "CHECKPOINT"
 
 #define _EXECUTION_MODE_NONE_ 0
 #define _EXECUTION_MODE_MUTATIONS_ 1
@@ -85,10 +118,12 @@ namespace Nucl {
 #define _INPUT_KEY_MUTATION_RATES_ "MUT"
 #define _INPUT_KEY_MUTATION_KIMURA_ "MUT_KIMURA"
 #define _INPUT_KEY_MUTATION_FELSENSTEIN_ "MUT_FELSENSTEIN"
+#define _INPUT_KEY_MUTATION_COMPACTION_ "MUT_COMPACTION"
 
 #define _INPUT_KEY_MIGRATION_MODEL_ "MIG_MODEL"
 #define _INPUT_KEY_MIGRATION_RATES_ "MIG_RATES"
 #define _INPUT_KEY_MIGRATION_DETAILED_OUTPUT_ "MIG_DETAILED_OUTPUT"
+#define _INPUT_KEY_MIGRATION_GRAPH_ "MIG_GRAPH"
 
 #define _INPUT_KEY_SELECTION_RATES_ "SEL"
 
@@ -98,6 +133,21 @@ namespace Nucl {
 
 
 #define _DEFAULT_MUTATION_RATE_ 1E-6
+
+// longest sequences identified by themselves in the output, the longer ones by their differences from the reference
+#define _MAX_SEQUENCE_IDENTIFIER_SITES_ 64
+
+// the differences of the haplotypes pack the site with the nucleotide on 32 bits
+#define _MAX_HAPLOTYPE_SITES_ (1 << 30)
+
+// mutations a haplotype reads up to its root, at most (a deeper one starts a new root)
+#define _MAX_LINEAGE_DEPTH_ 32
+
+// chains of the dictionary aligning the alleles of the replicates in the output
+#define _ALLELE_DICTIONARY_BUCKETS_ 65536
+
+// default number of generations between two compactions of the extinct alleles (mutation mode)
+#define _DEFAULT_MUTATION_COMPACTION_ 100
 #define _MUTATION_MODEL_NONE_ 0
 #define _MUTATION_MODEL_CANTOR_ 1
 #define _MUTATION_MODEL_KIMURA_ 2
@@ -114,8 +164,71 @@ namespace Nucl {
 
 #define _MIGRATION_OUTPUT_SEPARATOR_ "  "
 
+// a replicate splits its migration steps across the threads when the replicates can not
+// keep them busy, and it has at least this number of demes...
+#define _MIGRATION_PARALLEL_MIN_DEMES_ 64
+
+// ...in this number of parts per thread
+#define _MIGRATION_PARTS_PER_THREAD_ 4
+
+// default number of replicates per scheduled task
+#define _DEFAULT_BATCH_SIZE_ 4
+
+// the lockstep engine widens the batches up to this number of replicates...
+#define _LOCKSTEP_MIN_BATCH_SIZE_ 32
+
+// ...as long as there are at least this number of batches to share between the threads
+#define _LOCKSTEP_MIN_BATCHES_ 64
+
+// Berry-Esseen constant (Shevtsova, 2011): a binomial draw of variance v is replaced by a
+// Gaussian one with its cumulative distribution off by at most this constant / sqrt(v)
+#define _DIFFUSION_BERRY_ESSEEN_ 0.4748
+
+// default number of generations simulated before their output is handed to the writer
+#define _DEFAULT_OUTPUT_BLOCK_SIZE_ 100
+
+// forms of the RECORD schedule other than a list of generations: every k-th generation, n log-spaced generations
+#define _RECORD_SCHEDULE_EVERY_ "every"
+#define _RECORD_SCHEDULE_LOG_ "log"
+
+// epochs of the DEMOGRAPHY schedule: start:kind:parameters, e.g. 100:logistic:0.05,20000
+#define _EPOCH_CONSTANT_ 1
+#define _EPOCH_EXPONENTIAL_ 2
+#define _EPOCH_LOGISTIC_ 3
+
+#define _EPOCH_CONSTANT_NAME_ "constant"
+#define _EPOCH_EXPONENTIAL_NAME_ "exponential"
+#define _EPOCH_LOGISTIC_NAME_ "logistic"
+
+#define _EPOCH_SEPARATOR_ ':'
+#define _EPOCH_PARAMETER_SEPARATOR_ ','
+
+// a parameter range of a sweep: first..last:number of values
+#define _SWEEP_RANGE_ ".."
+#define _SWEEP_RANGE_VALUES_ ':'
+
+// maximal number of sweep points simulated at once (each has its replicates and writer thread)
+#define _SWEEP_MAX_ACTIVE_POINTS_ 16
+
+// index of the points of a sweep, with their parameters
+#define _OUTPUT_SWEEP_FILE_ "sweep.txt"
+
+// number of finished output blocks that may wait for the writer
+#define _OUTPUT_QUEUE_CAPACITY_ 2
+
+// default number of histogram bins for the frequency quantiles
+#define _DEFAULT_STATISTICS_BINS_ 100
+
+// maximal number of statistics accumulators (one per batch) in a block
+#define _STATISTICS_MAX_ACCUMULATORS_ 256
+
+// stream index reserved for the draws made outside of the replicates (parsing, setup)
+#define _RANDOM_STREAM_MAIN_ 0xFFFFFFFFFFFFFFFFULL
+
 #define strToInt [](const std::string& s) { return std::stoi(s); }
 #define strToUnsignedInt [](const std::string& s) { return (unsigned int) std::stoi(s); }
 #define strToDouble [](const std::string& s) { return std::stod(s); }
+#define strToUnsignedLongLong [](const std::string& s) { return std::stoull(s); }
+#define strToLongLong [](const std::string& s) { return std::stoll(s); }
 
 #endif
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "MigrationGraph.hpp"
+#include "Globals.hpp"
+
+
+MigrationGraph::MigrationGraph(const std::vector< std::vector<unsigned int> >& rates) {
+	std::vector<Edge> edges;
+
+	for (std::size_t i = 0; i < rates.size(); ++i) {
+		for (std::size_t j = 0; j < rates[i].size(); ++j) {
+			if (rates[i][j] > 0 && i != j) edges.push_back({ i, j, rates[i][j] });
+		}
+	}
+
+	build(edges, rates.size());
+}
+
+
+bool MigrationGraph::load(const std::string& fileName, MigrationGraph& graph) {
+	std::ifstream file(fileName);
+	if (!file.is_open()) return false;
+
+	std::vector<Edge> edges;
+	std::size_t nDemes = 0;
+
+	std::string line;
+	while (std::getline(file, line)) {
+		std::size_t start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == _INPUT_COMMENT_) continue;
+
+		// the demes exchange individuals, not with themselves
+		std::istringstream ss(line);
+		long long source = -1, target = -1, migrants = -1;
+		std::string rest;
+		if (!(ss >> source >> target >> migrants) || (ss >> rest) || source < 0 || target < 0 || migrants < 0
+			|| source == target || migrants > 0xFFFFFFFFLL) {
+			return false;
+		}
+
+		edges.push_back({ (std::size_t) source, (std::size_t) target, (unsigned int) migrants });
+		nDemes = std::max(nDemes, (std::size_t) std::max(source, target) + 1);
+	}
+
+	if (nDemes == 0) return false;
+
+	graph.build(edges, nDemes);
+	return true;
+}
+
+
+std::size_t MigrationGraph::getNbDemes() const {
+	return firstEdges.size() - 1;
+}
+
+
+std::size_t MigrationGraph::getFirstEdge(std::size_t deme) const {
+	return firstEdges[deme];
+}
+
+
+std::size_t MigrationGraph::getTarget(std::size_t edge) const {
+	return targets[edge];
+}
+
+
+unsigned int MigrationGraph::getMigrants(std::size_t edge) const {
+	return migrants[edge];
+}
+
+
+std::size_t MigrationGraph::getFirstIncomingEdge(std::size_t deme) const {
+	return firstIncomingEdges[deme];
+}
+
+
+std::size_t MigrationGraph::getIncomingEdge(std::size_t i) const {
+	return incomingEdges[i];
+}
+
+
+unsigned long long MigrationGraph::getEmigrants(std::size_t deme) const {
+	unsigned long long total = 0;
+	for (std::size_t edge = firstEdges[deme]; edge < firstEdges[deme + 1]; ++edge) {
+		total += migrants[edge];
+	}
+
+	return total;
+}
+
+
+unsigned int MigrationGraph::getUniformMigrants() const {
+	std::size_t nDemes = getNbDemes();
+	if (migrants.empty() || migrants.size() != nDemes * (nDemes - 1)) return 0;
+
+	// no repeated edges nor self-loops: every deme is connected to every other one
+	for (auto m : migrants) {
+		if (m != migrants.front()) return 0;
+	}
+
+	return migrants.front();
+}
+
+
+bool MigrationGraph::limitEmigrants(const std::vector<std::size_t>& demeSizes) {
+	bool isLimited = false;
+	std::vector<Edge> edges;
+
+	for (std::size_t deme = 0; deme < getNbDemes(); ++deme) {
+		std::size_t first = firstEdges[deme], last = firstEdges[deme + 1];
+		unsigned long long total = getEmigrants(deme);
+		unsigned long long size = deme < demeSizes.size() ? demeSizes[deme] : 0;
+
+		// one migrant less on every edge in turn (the emptied ones are skipped)
+		for (std::size_t edge = first; total > size; edge = edge + 1 < last ? edge + 1 : first) {
+			if (migrants[edge] > 0) {
+				--migrants[edge];
+				--total;
+				isLimited = true;
+			}
+		}
+
+		for (std::size_t edge = first; edge < last; ++edge) {
+			edges.push_back({ deme, targets[edge], migrants[edge] });
+		}
+	}
+
+	if (isLimited) build(edges, getNbDemes());
+	return isLimited;
+}
+
+
+void MigrationGraph::build(std::vector<Edge>& edges, std::size_t nDemes) {
+	std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+		return a.source < b.source || (a.source == b.source && a.target < b.target);
+	});
+
+	firstEdges.assign(nDemes + 1, 0);
+	targets.clear();
+	migrants.clear();
+
+	for (std::size_t e = 0; e < edges.size(); ) {
+		// the repeated edges add up
+		unsigned long long total = 0;
+		std::size_t f = e;
+		for (; f < edges.size() && edges[f].source == edges[e].source && edges[f].target == edges[e].target; ++f) {
+			total += edges[f].migrants;
+		}
+
+		if (total > 0) {
+			targets.push_back(edges[e].target);
+			migrants.push_back((unsigned int) std::min(total, 0xFFFFFFFFULL));
+			++firstEdges[edges[e].source + 1];
+		}
+
+		e = f;
+	}
+
+	// from the number of edges of every deme to the index of its first one
+	for (std::size_t deme = 0; deme < nDemes; ++deme) {
+		firstEdges[deme + 1] += firstEdges[deme];
+	}
+
+	// the same edges, listed by target (by increasing source within a target)
+	firstIncomingEdges.assign(nDemes + 1, 0);
+	for (auto target : targets) {
+		++firstIncomingEdges[target + 1];
+	}
+
+	for (std::size_t deme = 0; deme < nDemes; ++deme) {
+		firstIncomingEdges[deme + 1] += firstIncomingEdges[deme];
+	}
+
+	incomingEdges.resize(targets.size());
+	std::vector<std::size_t> next(firstIncomingEdges.begin(), firstIncomingEdges.end() - 1);
+	for (std::size_t edge = 0; edge < targets.size(); ++edge) {
+		incomingEdges[next[targets[edge]]++] = edge;
+	}
+}
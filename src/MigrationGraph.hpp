@@ -0,0 +1,143 @@
+#ifndef MIGRATION_GRAPH_H
+#define MIGRATION_GRAPH_H
+
+#include <string>
+#include <vector>
+
+
+/** \brief Graph of the migrations between the demes
+ *
+ * Only the edges that carry migrants are stored, in compressed sparse
+ * rows: the edges leaving deme i are edges getFirstEdge(i) to
+ * getFirstEdge(i + 1) - 1, by increasing target. A ring or a star of D
+ * demes is thus walked in O(D) instead of O(D^2). The graph does not
+ * change during a run, so the replicates share it. The edges are also
+ * indexed by target, for the demes to gather their immigrants.
+ *
+ * */
+class MigrationGraph {
+
+public:
+
+	/** \brief MigrationGraph constructor, from a matrix of migration rates
+	 *
+	 * \param rates			number of individuals moving from deme i to deme j per generation, at [i][j]
+	 * */
+	explicit MigrationGraph(const std::vector< std::vector<unsigned int> >& rates = std::vector< std::vector<unsigned int> >());
+
+
+	/** \brief Read a graph from an edge-list file
+	 *
+	 * One edge per line: "source target migrants", the demes being numbered
+	 * from 0 (lines starting with '#' are comments). The number of demes
+	 * is the largest index + 1.
+	 *
+	 * \param fileName		path of the file
+	 * \param graph			the graph read
+	 *
+	 * \return false if the file can not be read, has an invalid line or no edge
+	 * */
+	static bool load(const std::string& fileName, MigrationGraph& graph);
+
+
+	/** \brief Get the number of demes
+	 * */
+	std::size_t getNbDemes() const;
+
+
+	/** \brief Get the index of the first edge leaving a deme
+	 *
+	 * \param deme			the deme, or the number of demes for the end of the last one
+	 * */
+	std::size_t getFirstEdge(std::size_t deme) const;
+
+
+	/** \brief Get the deme an edge leads to
+	 * */
+	std::size_t getTarget(std::size_t edge) const;
+
+
+	/** \brief Get the number of individuals moving along an edge per generation
+	 * */
+	unsigned int getMigrants(std::size_t edge) const;
+
+
+	/** \brief Get the position of the first edge entering a deme, in the list of the incoming edges
+	 *
+	 * \param deme			the deme, or the number of demes for the end of the last one
+	 * */
+	std::size_t getFirstIncomingEdge(std::size_t deme) const;
+
+
+	/** \brief Get an edge of the list of the incoming edges
+	 *
+	 * \param i				position in the list, from getFirstIncomingEdge(deme) to getFirstIncomingEdge(deme + 1) - 1
+	 *
+	 * \return The index of the edge
+	 * */
+	std::size_t getIncomingEdge(std::size_t i) const;
+
+
+	/** \brief Get the number of individuals leaving a deme per generation
+	 * */
+	unsigned long long getEmigrants(std::size_t deme) const;
+
+
+	/** \brief Get the number of migrants of every edge of a complete graph with a single rate
+	 *
+	 * \return The number of migrants of the edges, 0 if some demes are not
+	 * connected or do not exchange the same number of individuals
+	 * */
+	unsigned int getUniformMigrants() const;
+
+
+	/** \brief Lower the migrations of the demes sending more individuals than they have
+	 *
+	 * The edges of such a deme lose one migrant each in turn, until the
+	 * deme sends at most its size.
+	 *
+	 * \param demeSizes		number of individuals of every deme
+	 *
+	 * \return Whether a migration was lowered
+	 * */
+	bool limitEmigrants(const std::vector<std::size_t>& demeSizes);
+
+private:
+
+	//!< Edge of the graph, before it is compressed
+	struct Edge {
+		std::size_t source;
+		std::size_t target;
+		unsigned int migrants;
+	};
+
+
+	/** \brief Compress the edges into rows, summing the repeated ones and dropping the empty ones
+	 *
+	 * \param edges			the edges, in any order
+	 * \param nDemes		number of demes
+	 * */
+	void build(std::vector<Edge>& edges, std::size_t nDemes);
+
+
+	//!< Index of the first edge of every deme, and the number of edges at the end
+	std::vector<std::size_t> firstEdges;
+
+
+	//!< Target deme of every edge
+	std::vector<std::size_t> targets;
+
+
+	//!< Number of migrants of every edge per generation
+	std::vector<unsigned int> migrants;
+
+
+	//!< Position of the first incoming edge of every deme in \ref incomingEdges, and the number of edges at the end
+	std::vector<std::size_t> firstIncomingEdges;
+
+
+	//!< Edges by target deme
+	std::vector<std::size_t> incomingEdges;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include "ParameterSweep.hpp"
+#include "SimulationsExecutor.hpp"
+#include "Globals.hpp"
+
+
+ParameterSweep::ParameterSweep(const Data& params, bool resume)
+  : data(params), isResumed(resume)
+{}
+
+
+void ParameterSweep::execute() {
+	std::vector< std::vector<std::string> > points = data.getSweepPoints();
+	std::cout << "Sweeping " << points.size() << " points" << std::endl;
+
+	writeIndex(points);
+
+	// the threads are started once, for every point
+	std::shared_ptr<ThreadPool> pool = SimulationsExecutor::createPool(data.getNbThreads());
+
+	for (std::size_t first = 0; first < points.size(); first += _SWEEP_MAX_ACTIVE_POINTS_) {
+		std::size_t last = std::min(points.size(), first + _SWEEP_MAX_ACTIVE_POINTS_);
+
+		std::vector< std::unique_ptr<SimulationsExecutor> > executors;
+		int nReplicates = 0;
+		for (std::size_t point = first; point < last; ++point) {
+			Data pointData(data, points[point]);
+			nReplicates += pointData.getNbReplicates();
+
+			executors.emplace_back(new SimulationsExecutor(pointData, isResumed, 0, 0, pool, "sweep-" + std::to_string(point)));
+		}
+
+		// the replicates of the points fill the pool together
+		for (auto& executor : executors) {
+			executor->setPoolReplicates(nReplicates);
+			executor->start();
+		}
+
+		// the blocks of the points are submitted together, and handed to their writers
+		// once the pool has run them all; a point is done once it has no block left
+		std::vector<SimulationsExecutor*> running;
+		for (auto& executor : executors) running.push_back(executor.get());
+
+		while (!running.empty()) {
+			std::vector<SimulationsExecutor*> submitted;
+			for (auto executor : running) {
+				if (executor->submitBlock()) submitted.push_back(executor);
+			}
+
+			pool->wait();
+
+			for (auto executor : submitted) {
+				executor->endBlock();
+			}
+
+			running.swap(submitted);
+		}
+
+		for (auto& executor : executors) {
+			executor->finish();
+		}
+	}
+}
+
+
+void ParameterSweep::writeIndex(const std::vector< std::vector<std::string> >& points) const {
+	std::ofstream out(_OUTPUT_SWEEP_FILE_);
+
+	out << _INPUT_COMMENT_ << " point";
+	for (auto& line : data.getSweptLines()) {
+		out << '\t' << line;
+	}
+	out << '\n';
+
+	for (std::size_t point = 0; point < points.size(); ++point) {
+		out << point;
+		for (auto& line : points[point]) {
+			out << '\t' << line;
+		}
+		out << '\n';
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+#include <string>
+#include <vector>
+#include "Data.hpp"
+
+
+/** \brief Class running a sweep: one run per combination of the parameter ranges
+ *
+ * The input file gives ranges (first..last:n) for some parameters, e.g.
+ * SEL = 0.01..0.1:10. The files are only read once: every point of the
+ * sweep copies that data with its own values. The points run on a single
+ * pool of threads, their blocks submitted together so that the pool holds
+ * tasks of every (point, batch of replicates) at once. Every point writes
+ * its own output files (results.sweep-3.txt...), listed with their
+ * parameters in sweep.txt.
+ *
+ * */
+class ParameterSweep {
+
+public:
+
+	/** \brief ParameterSweep constructor
+	 *
+	 * \param data			the parameters read from the input file, with the ranges
+	 * \param resume		whether to resume every point from its last checkpoint
+	 * */
+	ParameterSweep(const Data& data, bool resume = false);
+
+
+	/** \brief Run every point of the sweep
+	 *
+	 * At most _SWEEP_MAX_ACTIVE_POINTS_ points are simulated at once.
+	 * */
+	void execute();
+
+protected:
+
+	/** \brief Write the index of the points, with the values of their parameters
+	 *
+	 * \param points		the lines of the swept parameters, for every point
+	 * */
+	void writeIndex(const std::vector< std::vector<std::string> >& points) const;
+
+private:
+
+	//!< Parameters read from the input file, with the ranges
+	Data data;
+
+
+	//!< Whether the points resume from their last checkpoint
+	bool isResumed;
+};
+
+#endif
@@ -1,9 +1,10 @@
 #include <algorithm>
 #include <cassert>
 #include "Random.hpp"
+#include "Binomial.hpp"
+#include "Globals.hpp"
 
-std::random_device RandomDist::rd;
-std::mt19937 RandomDist::rng = std::mt19937(RandomDist::rd());
+thread_local RandomEngine RandomDist::rng;
 
 
 RandomDist::RandomDist(double m, double s, int ns, bool n) 
@@ -30,31 +31,40 @@ std::vector<double> RandomDist::generate_numbers() {
 }
 
 
-int RandomDist::binomial(int n, double p) {
-	std::binomial_distribution<int> dbinom(n, p);
-	return dbinom(rng);
+void RandomDist::seed(std::uint64_t s) {
+	rng.seed(s, _RANDOM_STREAM_MAIN_);
 }
 
 
-int RandomDist::uniformIntSingle(int min, int max) {
+RandomEngine& RandomDist::getEngine() {
+	return rng;
+}
+
+
+int RandomDist::binomial(int n, double p, RandomEngine& engine, double gaussianThreshold) {
+	return (int) Binomial(n, p, gaussianThreshold)(engine);
+}
+
+
+int RandomDist::uniformIntSingle(int min, int max, RandomEngine& engine) {
 	// init random distribution
 	std::uniform_int_distribution<int> distr(min, max);
 	
 	// get one value
-	return distr(RandomDist::rng);
+	return distr(engine);
 }
 
 
-double RandomDist::uniformDoubleSingle(double min, double max) {
+double RandomDist::uniformDoubleSingle(double min, double max, RandomEngine& engine) {
 	// init random distribution
 	std::uniform_real_distribution<> distr(min, max);
 	
 	// get one value
-	return distr(RandomDist::rng);
+	return distr(engine);
 }
 
 
-void RandomDist::uniformIntVector(std::vector<int>& toFill, int min, int max) {
+void RandomDist::uniformIntVector(std::vector<int>& toFill, int min, int max, RandomEngine& engine) {
 	// init random distribution
 	std::uniform_int_distribution<int> distr(min, max);
 
@@ -63,13 +73,13 @@ void RandomDist::uniformIntVector(std::vector<int>& toFill, int min, int max) {
 		toFill.begin(),
 		toFill.end(), 
 		[&]() { 				
-			return distr(RandomDist::rng); 
+			return distr(engine); 
 		}
 	); 
 }
 
 
-void RandomDist::uniformDoubleVector(std::vector<double>& toFill, double min, double max) {
+void RandomDist::uniformDoubleVector(std::vector<double>& toFill, double min, double max, RandomEngine& engine) {
 	// init random distribution
 	std::uniform_real_distribution<> distr(min, max);
 
@@ -78,7 +88,7 @@ void RandomDist::uniformDoubleVector(std::vector<double>& toFill, double min, do
 		toFill.begin(),
 		toFill.end(), 
 		[&]() { 				
-			return distr(RandomDist::rng); 
+			return distr(engine); 
 		}
 	); 
 }
@@ -104,34 +114,77 @@ void RandomDist::normal(std::vector< double > &res) {
 }
 
 
-void RandomDist::multinomial(std::vector<unsigned int>& pop) {
+int RandomDist::multinomial(std::vector<unsigned int>& pop, RandomEngine& engine) {
 	int n = 0;
 	for (auto& count : pop)
 		n += count;
 		
-	RandomDist::multinomial(pop, n);
+	return RandomDist::multinomial(pop, n, engine);
 }
 
 
-void RandomDist::multinomial(std::vector<unsigned int>& pop, int n) {
+int RandomDist::multinomial(std::vector<unsigned int>& pop, int n, RandomEngine& engine) {
+	static thread_local std::vector<std::size_t> active;
+	
+	active.clear();
+	for (std::size_t i = 0; i < pop.size(); ++i) {
+		if (pop[i] > 0) active.push_back(i);
+	}
+	
+	std::stable_sort(active.begin(), active.end(), [&pop](std::size_t a, std::size_t b) { return pop[a] > pop[b]; });
+	
+	return RandomDist::multinomial(pop, n, active, engine);
+}
+
+
+int RandomDist::multinomial(std::vector<unsigned int>& pop, int n, std::vector<std::size_t>& active, RandomEngine& engine,
+							double gaussianThreshold) {
+	// drop the extinct alleles, and the ones listed twice (lost and brought back by the caller)
+	static thread_local std::vector<unsigned char> isListed;
+	isListed.resize(pop.size(), 0);
+	
+	std::size_t nActive = 0;
+	for (auto i : active) {
+		if (pop[i] > 0 && !isListed[i]) {
+			isListed[i] = 1;
+			active[nActive++] = i;
+		}
+	}
+	
+	active.resize(nActive);
+	for (auto i : active)
+		isListed[i] = 0;
+	
+	// order by descending count: the list was sorted at the previous
+	// generation and changed little, which insertion sort handles in linear time
+	for (std::size_t i = 1; i < active.size(); ++i) {
+		std::size_t idx = active[i];
+		std::size_t j = i;
+		
+		for (; j > 0 && pop[active[j - 1]] < pop[idx]; --j) {
+			active[j] = active[j - 1];
+		}
+		
+		active[j] = idx;
+	}
+	
 	int total = 0;
-	for (auto& count : pop)
-		total += count;
+	for (auto i : active)
+		total += pop[i];
 	
-	for (auto& count : pop) {
+	int nDraws = 0;
+	for (auto i : active) {
+		auto& count = pop[i];
 		
 		// remaining parent population size should be 0 or more	
 		assert(total >= 0);
-		if (total == 0) {
-			// the only way for the parent population to be 0 is if the 
-			// current allele is not present anymore (wiped out)
-			assert(count == 0);
-			assert(n == 0);
-			
-			// if the parent population is empty, there are no more 
-			// alleles to be distributed, thus we can exit the loop
-			break;
-		} 
+		assert(total > 0 || n == 0);
+		
+		// every offspring has been drawn: the remaining alleles are lost
+		if (n == 0) {
+			count = 0;
+			continue;
+		}
 		
 		// generate new allele copy number
 		double p = count * 1.0 / total;
@@ -140,21 +193,28 @@ void RandomDist::multinomial(std::vector<unsigned int>& pop, int n) {
 		total -= count;
 		
 		// generate new number of allele copies in population
-        count = RandomDist::binomial(n, p);
+		// (the last allele gets every offspring left)
+		if (total == 0) {
+			count = n;
+		} else {
+			count = RandomDist::binomial(n, p, engine, gaussianThreshold);
+			++nDraws;
+		}
 		
 		// reduce residual offspring population size to fill
 		n -= count;
 	}
 	
 	assert(n == 0);
-	assert(total == 0);
+	
+	return (int) pop.size() - nDraws;
 }
 
 
-std::vector<unsigned int> RandomDist::multinomialByValue(const std::vector<unsigned int>& pop, int n) {	
+std::vector<unsigned int> RandomDist::multinomialByValue(const std::vector<unsigned int>& pop, int n, RandomEngine& engine) {	
 	std::vector<unsigned int> res = pop;
 	
-	RandomDist::multinomial(res, n);
+	RandomDist::multinomial(res, n, engine);
 	
 	return res;
 }
\ No newline at end of file
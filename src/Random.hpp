@@ -3,17 +3,22 @@
 
 #include <random>
 #include <vector>
+#include "RandomEngine.hpp"
 
 
 /*!
-  This is a random number class based on standard c++-11 generators
+  This is a random number class based on standard c++-11 distributions.
+
+  The static draws take the engine to use as last argument. Simulations pass
+  their own per-replicate stream; when omitted, the calling thread's default
+  engine (see \ref getEngine) is used.
  */
 class RandomDist {
     
 public:
 
 	/*!
-	  Initializes the generator \ref rng with the Mersenne twister *mt19937* engine. 
+	  Initializes the distribution, which draws from the thread's default engine. 
 	  Must provide mean *m*, standard deviation *sd* and sample size *ns*, 
 	  set whether to use normal distribution (default uniform) and can provide a seed *s*.
 	 */
@@ -26,32 +31,48 @@ public:
     std::vector<double> generate_numbers();
 
 
-	/** \brief Get a number following a binomial distribution
+	/** \brief Seed the calling thread's default engine
 	 *
-	 * Uses a mt19937 mersenne twister.
+	 * \param seed		the global seed of the run
+	 * */
+    static void seed(std::uint64_t seed);
+
+
+	/** \brief Get the calling thread's default engine
+	 * */
+    static RandomEngine& getEngine();
+
+
+	/** \brief Get a number following a binomial distribution
 	 *
+	 * \param n					number of trials
+	 * \param p					success probability
+	 * \param engine			the random stream to draw from
+	 * \param gaussianThreshold	minimal variance of a draw approximated by a Gaussian (see Binomial)
 	 * */
-    static int binomial(int n, double p);
+    static int binomial(int n, double p, RandomEngine& engine = getEngine(), double gaussianThreshold = 0.0);
 
     
     /** \brief Get an integer following a uniform distribution in the range [min, max]
 	 *
 	 * \param min		minimal value of distribution
 	 * \param max		maximal value of distribution
+	 * \param engine	the random stream to draw from
 	 * 
 	 * \return Random integer in the given range
 	 * */
-    static int uniformIntSingle(int min, int max);
+    static int uniformIntSingle(int min, int max, RandomEngine& engine = getEngine());
 
 
     /** \brief Get a double following a uniform distribution in the range [min, max]
 	 *
 	 * \param min		minimal value of distribution
 	 * \param max		maximal value of distribution
+	 * \param engine	the random stream to draw from
 	 * 
 	 * \return Random double in the given range
 	 * */
-    static double uniformDoubleSingle(double min, double max);
+    static double uniformDoubleSingle(double min, double max, RandomEngine& engine = getEngine());
     
 
     /** \brief Fill a vector with integers following a uniform distribution in the range [min, max]
@@ -59,8 +80,9 @@ public:
 	 * \param toFill	vector to fill, presupposedly initialized to a certain size
 	 * \param min		minimal value of distribution
 	 * \param max		maximal value of distribution
+	 * \param engine	the random stream to draw from
 	 * */
-    static void uniformIntVector(std::vector<int>& toFill, int min, int max);
+    static void uniformIntVector(std::vector<int>& toFill, int min, int max, RandomEngine& engine = getEngine());
 
 
     /** \brief Fill a vector with doubles following a uniform distribution in the range [min, max]
@@ -68,8 +90,9 @@ public:
 	 * \param toFill	vector to fill, presupposedly initialized to a certain size
 	 * \param min		minimal value of distribution
 	 * \param max		maximal value of distribution
+	 * \param engine	the random stream to draw from
 	 * */
-    static void uniformDoubleVector(std::vector<double>& toFill, double min, double max);
+    static void uniformDoubleVector(std::vector<double>& toFill, double min, double max, RandomEngine& engine = getEngine());
 
     
     /** \brief Generate a offspring population based on the parent population
@@ -78,21 +101,53 @@ public:
      * Calls multinomial(pop, {size of population});
 	 *
 	 * \param pop		parent population
+	 * \param engine	the random stream to draw from
+	 *
+	 * \return The number of binomial draws skipped (see below)
 	 * */
-    static void multinomial(std::vector<unsigned int>& pop);
+    static int multinomial(std::vector<unsigned int>& pop, RandomEngine& engine = getEngine());
 
 
     /** \brief Generate a offspring population based on the parent population
      * 
      * Replaces parent population
-     * Calls multinomial(pop, {size of population});
+     * Calls multinomial(pop, n, {alleles present in pop});
 	 *
 	 * \param pop		parent population
 	 * \param n			the size of the child population
+	 * \param engine	the random stream to draw from
+	 *
+	 * \return The number of binomial draws skipped (see below)
 	 * */
-   
+    static int multinomial(std::vector<unsigned int>& pop, int n, RandomEngine& engine = getEngine());
+
+
+    /** \brief Generate a offspring population based on the parent population
+     * 
+     * Replaces parent population. Only the alleles of \p active are drawn,
+     * by descending count: the offspring left to draw reach 0 after a few
+     * draws, and the remaining alleles get no offspring without drawing.
+     * The list is kept by the caller between generations: the extinct
+     * alleles are removed from it, and it is kept sorted by count. The
+     * caller adds the alleles it brings back from a count of 0 (e.g. by
+     * mutation).
+     *
+     * With a Gaussian threshold, the draws of the common alleles are
+     * approximated (diffusion step) while the rare ones stay exact.
+	 *
+	 * \param pop				parent population
+	 * \param n					the size of the child population
+	 * \param active			indices of (at least) every allele with a non-zero count
+	 * \param engine			the random stream to draw from
+	 * \param gaussianThreshold	minimal variance of a draw approximated by a Gaussian (see Binomial)
+	 *
+	 * \return The number of binomial draws skipped, compared to one draw
+	 * per allele of \p pop
+	 * */
+    static int multinomial(std::vector<unsigned int>& pop, int n, std::vector<std::size_t>& active,
+						   RandomEngine& engine = getEngine(), double gaussianThreshold = 0.0);
+
 
-    static void multinomial(std::vector<unsigned int>& pop, int n);
     /** \brief Generate a offspring population based on the parent population
      * 
      * Generates new vector, does not overwrite passed argument
@@ -100,17 +155,14 @@ public:
 	 *
 	 * \param pop		parent population
 	 * \param n			the size of the child population
+	 * \param engine	the random stream to draw from
 	 * */
-    static std::vector<unsigned int> multinomialByValue(const std::vector<unsigned int>& pop, int n);
+    static std::vector<unsigned int> multinomialByValue(const std::vector<unsigned int>& pop, int n, RandomEngine& engine = getEngine());
      
 private:
 
-	//!< Random device
-	static std::random_device rd;
-
-
-	//!< Random number generator
-	static std::mt19937 rng;
+	//!< Default random number generator of the calling thread
+	static thread_local RandomEngine rng;
 
 
 	//!< Fill a vector with uniform values
@@ -0,0 +1,107 @@
+#include <atomic>
+#include <cassert>
+#include <random>
+#include "RandomEngine.hpp"
+
+namespace {
+	// Philox4x32 multipliers and Weyl key increments (Salmon et al., 2011)
+	const std::uint32_t PHILOX_M0 = 0xD2511F53;
+	const std::uint32_t PHILOX_M1 = 0xCD9E8D57;
+	const std::uint32_t PHILOX_W0 = 0x9E3779B9;
+	const std::uint32_t PHILOX_W1 = 0xBB67AE85;
+	const int PHILOX_ROUNDS = 10;
+}
+
+
+RandomEngine::RandomEngine() {
+	// one random seed per process, and a new stream for every engine
+	static const std::uint64_t processSeed = []() -> std::uint64_t {
+		std::random_device rd;
+		return ((std::uint64_t) rd() << 32) | rd();
+	}();
+	static std::atomic<std::uint64_t> nextStream(0);
+
+	seed(processSeed, nextStream++);
+}
+
+
+RandomEngine::RandomEngine(std::uint64_t s, std::uint64_t stream) {
+	seed(s, stream);
+}
+
+
+void RandomEngine::seed(std::uint64_t s, std::uint64_t stream) {
+	key = { { (std::uint32_t) s, (std::uint32_t) (s >> 32) } };
+	counter = { { 0, 0, (std::uint32_t) stream, (std::uint32_t) (stream >> 32) } };
+
+	// buffer is empty: the first call generates block 0
+	bufferIdx = 4;
+}
+
+
+std::uint64_t RandomEngine::getSeed() const {
+	return ((std::uint64_t) key[1] << 32) | key[0];
+}
+
+
+std::uint64_t RandomEngine::getStream() const {
+	return ((std::uint64_t) counter[3] << 32) | counter[2];
+}
+
+
+std::uint64_t RandomEngine::getSubstream(std::uint64_t stream, std::uint64_t substream) {
+	assert(stream < ((std::uint64_t) 1 << 32) && substream + 1 < ((std::uint64_t) 1 << 32));
+
+	// the high half of the stream index is 0 for the streams themselves
+	return ((substream + 1) << 32) | stream;
+}
+
+
+void RandomEngine::discard(unsigned long long n) {
+	// absolute position (in words) of the next output
+	std::uint64_t nextBlock = ((std::uint64_t) counter[1] << 32) | counter[0];
+	std::uint64_t position = nextBlock * 4 - (4 - bufferIdx) + n;
+
+	// move the counter to the block containing the new position
+	nextBlock = position / 4;
+	counter[0] = (std::uint32_t) nextBlock;
+	counter[1] = (std::uint32_t) (nextBlock >> 32);
+	bufferIdx = 4;
+
+	if (position % 4 != 0) {
+		generateBlock();
+		bufferIdx = (unsigned int) (position % 4);
+	}
+}
+
+
+std::array<std::uint32_t, 4> RandomEngine::philox(std::array<std::uint32_t, 4> ctr,
+													std::array<std::uint32_t, 2> k) {
+	for (int round = 0; round < PHILOX_ROUNDS; ++round) {
+		std::uint64_t prod0 = (std::uint64_t) PHILOX_M0 * ctr[0];
+		std::uint64_t prod1 = (std::uint64_t) PHILOX_M1 * ctr[2];
+
+		ctr = { {
+			(std::uint32_t) (prod1 >> 32) ^ ctr[1] ^ k[0],
+			(std::uint32_t) prod1,
+			(std::uint32_t) (prod0 >> 32) ^ ctr[3] ^ k[1],
+			(std::uint32_t) prod0
+		} };
+
+		k[0] += PHILOX_W0;
+		k[1] += PHILOX_W1;
+	}
+
+	return ctr;
+}
+
+
+void RandomEngine::generateBlock() {
+	buffer = philox(counter, key);
+	bufferIdx = 0;
+
+	// increment the 64-bit block index (the stream index is left untouched)
+	if (++counter[0] == 0) {
+		++counter[1];
+	}
+}
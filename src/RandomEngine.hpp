@@ -0,0 +1,127 @@
+#ifndef RANDOM_ENGINE_H
+#define RANDOM_ENGINE_H
+
+#include <array>
+#include <cstdint>
+
+
+/** \brief Counter-based random number engine (Philox4x32-10)
+ *
+ * Every output block is a pure function of a 64-bit key (the global seed),
+ * a 64-bit stream index (e.g. the replicate index) and a 64-bit block counter.
+ * Engines built from the same seed but with different streams therefore
+ * never overlap, and a replicate draws exactly the same numbers whichever
+ * thread runs it. The engine satisfies the UniformRandomBitGenerator
+ * requirements and can be used with the standard distributions.
+ *
+ * */
+class RandomEngine {
+
+public:
+
+	typedef std::uint32_t result_type;
+
+
+	/** \brief RandomEngine constructor
+	 *
+	 * Seeds the engine from the system's random device (non-reproducible).
+	 * The device is only read once per process: every default-constructed
+	 * engine then gets its own stream of that seed.
+	 * */
+	RandomEngine();
+
+
+	/** \brief RandomEngine constructor
+	 *
+	 * \param seed			global seed of the run
+	 * \param stream		index of the independent stream (e.g. the replicate index)
+	 * */
+	RandomEngine(std::uint64_t seed, std::uint64_t stream = 0);
+
+
+	/** \brief Reset the engine to the beginning of a stream
+	 *
+	 * \param seed			global seed of the run
+	 * \param stream		index of the independent stream
+	 * */
+	void seed(std::uint64_t seed, std::uint64_t stream = 0);
+
+
+	/** \brief Get the global seed of the engine
+	 * */
+	std::uint64_t getSeed() const;
+
+
+	/** \brief Get the stream index of the engine
+	 * */
+	std::uint64_t getStream() const;
+
+
+	/** \brief Get the index of a substream of a stream
+	 *
+	 * Splits a stream below 2^32 (e.g. a replicate) into independent
+	 * substreams (e.g. its demes), which overlap neither each other nor
+	 * any stream below 2^32.
+	 *
+	 * \param stream		index of the stream, below 2^32
+	 * \param substream		index of the substream, below 2^32 - 1
+	 * */
+	static std::uint64_t getSubstream(std::uint64_t stream, std::uint64_t substream);
+
+
+	static constexpr result_type min() { return 0; }
+
+
+	static constexpr result_type max() { return UINT32_MAX; }
+
+
+	//!< Get the next 32-bit random number of the stream
+	inline result_type operator()() {
+		if (bufferIdx == 4) {
+			generateBlock();
+		}
+
+		return buffer[bufferIdx++];
+	}
+
+
+	/** \brief Skip ahead in the stream
+	 *
+	 * Jumps over \p n outputs in O(1), without generating them.
+	 * */
+	void discard(unsigned long long n);
+
+
+	/** \brief Compute one raw Philox4x32-10 block
+	 *
+	 * \param counter		the 128-bit counter
+	 * \param key			the 64-bit key
+	 *
+	 * \return The 4 random words associated to (counter, key)
+	 * */
+	static std::array<std::uint32_t, 4> philox(std::array<std::uint32_t, 4> counter,
+												std::array<std::uint32_t, 2> key);
+
+private:
+
+	//!< Generate the block at the current counter and increment the counter
+	void generateBlock();
+
+
+	//!< Key of the engine: the global seed
+	std::array<std::uint32_t, 2> key;
+
+
+	//!< Counter of the engine: 64-bit block index followed by the 64-bit stream index
+	std::array<std::uint32_t, 4> counter;
+
+
+	//!< Last generated block
+	std::array<std::uint32_t, 4> buffer;
+
+
+	//!< Index of the next unused word in \ref buffer (4 means exhausted)
+	unsigned int bufferIdx;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include <cstdint>
+#include <limits>
+#include "ReplicateBatch.hpp"
+#include "SimulationBatch.hpp"
+
+
+bool ReplicateBatch::isSupported(int executionMode) {
+	return executionMode == _EXECUTION_MODE_NONE_
+		|| executionMode == _EXECUTION_MODE_SELECTION_
+		|| executionMode == _EXECUTION_MODE_BOTTLENECK_;
+}
+
+
+std::size_t ReplicateBatch::getCountWidth(long long maxPopulationSize) {
+	if (maxPopulationSize <= (long long) std::numeric_limits<std::uint16_t>::max()) {
+		return sizeof(std::uint16_t);
+	}
+
+	if (maxPopulationSize <= (long long) std::numeric_limits<std::uint32_t>::max()) {
+		return sizeof(std::uint32_t);
+	}
+
+	return sizeof(std::uint64_t);
+}
+
+
+std::unique_ptr<ReplicateBatch> ReplicateBatch::create(const Simulation& prototype,
+													   const std::vector<unsigned long long>& initialCounts,
+													   long long maxPopulationSize, std::size_t nReplicates,
+													   unsigned long long seed, unsigned long long firstStream) {
+	switch (getCountWidth(maxPopulationSize)) {
+		case sizeof(std::uint16_t):
+			return std::unique_ptr<ReplicateBatch>(
+				new SimulationBatch<std::uint16_t>(prototype, initialCounts, nReplicates, seed, firstStream));
+
+		case sizeof(std::uint32_t):
+			return std::unique_ptr<ReplicateBatch>(
+				new SimulationBatch<std::uint32_t>(prototype, initialCounts, nReplicates, seed, firstStream));
+
+		default:
+			return std::unique_ptr<ReplicateBatch>(
+				new SimulationBatch<std::uint64_t>(prototype, initialCounts, nReplicates, seed, firstStream));
+	}
+}
@@ -0,0 +1,127 @@
+#ifndef REPLICATE_BATCH_H
+#define REPLICATE_BATCH_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Simulation.hpp"
+
+
+/** \brief Interface of a batch of replicates advanced in lockstep
+ *
+ * The batches (see \ref SimulationBatch) store their allele counts with the
+ * narrowest unsigned type that holds the largest population of the run:
+ * 16-bit counts fit twice as many replicates per vector instruction and
+ * halve the memory traffic of the many small replicates, while 64-bit
+ * counts allow populations beyond the 2^32 individuals of the
+ * \ref Simulation. The type is chosen once per run by \ref create.
+ *
+ * */
+class ReplicateBatch {
+
+public:
+
+	virtual ~ReplicateBatch() = default;
+
+
+	/** \brief Check whether an execution mode can be run in lockstep
+	 * */
+	static bool isSupported(int executionMode);
+
+
+	/** \brief Get the size in bytes of the counts used for a population size
+	 *
+	 * \param maxPopulationSize	largest population size reached during the run
+	 * */
+	static std::size_t getCountWidth(long long maxPopulationSize);
+
+
+	/** \brief Create a batch with counts wide enough for the run
+	 *
+	 * \param prototype			parameters shared by every replicate (its counts are ignored)
+	 * \param initialCounts		initial allele counts of every replicate
+	 * \param maxPopulationSize	largest population size reached during the run
+	 * \param nReplicates		number of replicates in the batch
+	 * \param seed				global seed of the run
+	 * \param firstStream		stream (replicate index) of the first replicate of the batch
+	 * */
+	static std::unique_ptr<ReplicateBatch> create(const Simulation& prototype,
+												  const std::vector<unsigned long long>& initialCounts,
+												  long long maxPopulationSize, std::size_t nReplicates,
+												  unsigned long long seed, unsigned long long firstStream);
+
+
+	/** \brief Update every replicate of the batch by one step
+	 *
+	 * \param t				the time of the simulation
+	 * */
+	virtual void update(int t) = 0;
+
+
+	/** \brief Get the number of replicates in the batch
+	 * */
+	virtual std::size_t getNbReplicates() const = 0;
+
+
+	/** \brief Get the total population size (common to every replicate)
+	 * */
+	virtual unsigned long long getPopulationSize() const = 0;
+
+
+	/** \brief Get the alleles in the population (common to every replicate)
+	 * */
+	virtual const std::vector<std::string>& getAlleles() const = 0;
+
+
+	/** \brief Utility function to get and format the allele identifiers
+	 * */
+	virtual const std::string& getAlleleStrings() const = 0;
+
+
+	/** \brief Utility function to format the allele frequencies of a replicate for the output
+	 *
+	 * \return The same string as \ref Simulation::getAlleleFqsForOutput
+	 * */
+	virtual std::string getAlleleFqsForOutput(std::size_t replicate) const = 0;
+
+
+	/** \brief Utility function to get the raw allele counts of a replicate for the output
+	 *
+	 * \param replicate		index of the replicate in the batch
+	 * \param counts		the vector to fill with the counts
+	 * */
+	virtual void getAlleleCountsForOutput(std::size_t replicate, std::vector<unsigned long long>& counts) const = 0;
+
+
+	/** \brief Get the number of binomial draws skipped by the multinomials of the batch
+	 * */
+	virtual unsigned long long getSkippedDraws() const = 0;
+
+
+	/** \brief Get the number of alleles covered by the multinomials of the batch
+	 * */
+	virtual unsigned long long getMultinomialAlleles() const = 0;
+
+
+	/** \brief Get the step at which an allele fixed in a replicate (-1 if none did)
+	 * */
+	virtual int getFixationTime(std::size_t replicate) const = 0;
+
+
+	/** \brief Get the steps at which the alleles were lost in a replicate (-1 if present)
+	 * */
+	virtual std::vector<int> getLossTimes(std::size_t replicate) const = 0;
+
+
+	/** \brief Write what evolves during the run, as Simulation::saveState
+	 * */
+	virtual void saveState(std::ostream& out) const = 0;
+
+
+	/** \brief Read the state written by \ref saveState, into a batch created with the same parameters
+	 * */
+	virtual void loadState(std::istream& in) = 0;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <sstream>
+#include "ReplicateStatistics.hpp"
+
+
+ReplicateStatistics::ReplicateStatistics(std::size_t nSteps, std::size_t bins)
+  : nBins(bins), nReplicates(nSteps, 0), moments(nSteps), histograms(nSteps)
+{
+	assert(nBins > 0);
+}
+
+
+template <typename Count>
+void ReplicateStatistics::add(std::size_t step, const std::vector<Count>& counts, unsigned long long populationSize) {
+	assert(populationSize > 0);
+
+	addGroups(step, counts, &populationSize, 1);
+}
+
+
+template <typename Count>
+void ReplicateStatistics::add(std::size_t step, const std::vector<Count>& counts, const std::vector<unsigned long long>& groupSizes) {
+	addGroups(step, counts, groupSizes.data(), groupSizes.size());
+}
+
+
+template <typename Count>
+void ReplicateStatistics::addGroups(std::size_t step, const std::vector<Count>& counts, const unsigned long long* groupSizes,
+									std::size_t nGroups) {
+	assert(step < nReplicates.size());
+	assert(nGroups > 0 && counts.size() % nGroups == 0);
+
+	reserveColumns(step, counts.size());
+	++nReplicates[step];
+
+	std::size_t groupColumns = std::max(counts.size() / nGroups, (std::size_t) 1);
+	for (std::size_t c = 0; c < counts.size(); ++c) {
+		Moments& m = moments[step][c];
+		unsigned long long size = groupSizes[c / groupColumns];
+		double fq = size > 0 ? counts[c] * 1.0 / size : 0.0;
+
+		// Welford's update
+		++m.n;
+		double delta = fq - m.mean;
+		m.mean += delta / m.n;
+		m.m2 += delta * (fq - m.mean);
+
+		if (size > 0 && counts[c] == size) ++m.fixed;
+		if (counts[c] == 0) ++m.lost;
+
+		std::size_t bin = std::min((std::size_t) (fq * nBins), nBins - 1);
+		++histograms[step][c * nBins + bin];
+	}
+}
+
+
+// counts of the replicates simulated one by one, and of the lockstep batches
+template void ReplicateStatistics::add(std::size_t, const std::vector<unsigned int>&, unsigned long long);
+template void ReplicateStatistics::add(std::size_t, const std::vector<unsigned long long>&, unsigned long long);
+template void ReplicateStatistics::add(std::size_t, const std::vector<unsigned int>&, const std::vector<unsigned long long>&);
+
+
+void ReplicateStatistics::merge(const ReplicateStatistics& other) {
+	assert(other.nBins == nBins);
+	assert(other.nReplicates.size() == nReplicates.size());
+
+	for (std::size_t step = 0; step < nReplicates.size(); ++step) {
+		reserveColumns(step, other.moments[step].size());
+		nReplicates[step] += other.nReplicates[step];
+
+		for (std::size_t c = 0; c < other.moments[step].size(); ++c) {
+			moments[step][c] = combine(moments[step][c], other.moments[step][c]);
+		}
+
+		for (std::size_t i = 0; i < other.histograms[step].size(); ++i) {
+			histograms[step][i] += other.histograms[step][i];
+		}
+	}
+}
+
+
+std::size_t ReplicateStatistics::getNbSteps() const {
+	return nReplicates.size();
+}
+
+
+std::size_t ReplicateStatistics::getNbColumns(std::size_t step) const {
+	return moments[step].size();
+}
+
+
+unsigned long long ReplicateStatistics::getNbReplicates(std::size_t step) const {
+	return nReplicates[step];
+}
+
+
+double ReplicateStatistics::getMean(std::size_t step, std::size_t column) const {
+	return getMoments(step, column).mean;
+}
+
+
+double ReplicateStatistics::getVariance(std::size_t step, std::size_t column) const {
+	Moments m = getMoments(step, column);
+	return m.n > 1 ? m.m2 / (m.n - 1) : 0.0;
+}
+
+
+double ReplicateStatistics::getFixedFraction(std::size_t step, std::size_t column) const {
+	Moments m = getMoments(step, column);
+	return m.n > 0 ? m.fixed * 1.0 / m.n : 0.0;
+}
+
+
+double ReplicateStatistics::getLostFraction(std::size_t step, std::size_t column) const {
+	Moments m = getMoments(step, column);
+	return m.n > 0 ? m.lost * 1.0 / m.n : 0.0;
+}
+
+
+double ReplicateStatistics::getQuantile(std::size_t step, std::size_t column, double q) const {
+	unsigned long long n = nReplicates[step];
+	if (n == 0) return 0.0;
+
+	// the replicates without the column are in the first bin
+	unsigned long long missing = column < moments[step].size() ? n - moments[step][column].n : n;
+	double rank = q * n;
+	double cumulated = 0.0;
+
+	for (std::size_t bin = 0; bin < nBins; ++bin) {
+		double binCount = column < moments[step].size() ? histograms[step][column * nBins + bin] : 0.0;
+		if (bin == 0) binCount += missing;
+
+		if (binCount > 0.0 && cumulated + binCount >= rank) {
+			double withinBin = std::max(0.0, rank - cumulated) / binCount;
+			return (bin + withinBin) / nBins;
+		}
+
+		cumulated += binCount;
+	}
+
+	return 1.0;
+}
+
+
+std::string ReplicateStatistics::getStatisticsForOutput(std::size_t step) const {
+	std::stringstream ss;
+	ss << std::setprecision(6);
+
+	for (std::size_t c = 0; c < moments[step].size(); ++c) {
+		if (c != 0) ss << '\t';
+
+		ss << getMean(step, c) << _OUTPUT_SEPARATOR_
+		   << getVariance(step, c) << _OUTPUT_SEPARATOR_
+		   << getFixedFraction(step, c) << _OUTPUT_SEPARATOR_
+		   << getLostFraction(step, c) << _OUTPUT_SEPARATOR_
+		   << getQuantile(step, c, 0.05) << _OUTPUT_SEPARATOR_
+		   << getQuantile(step, c, 0.5) << _OUTPUT_SEPARATOR_
+		   << getQuantile(step, c, 0.95);
+	}
+
+	return ss.str();
+}
+
+
+ReplicateStatistics::Moments ReplicateStatistics::combine(const Moments& a, const Moments& b) {
+	if (a.n == 0) return b;
+	if (b.n == 0) return a;
+
+	Moments m;
+	m.n = a.n + b.n;
+
+	double delta = b.mean - a.mean;
+	m.mean = a.mean + delta * b.n / m.n;
+	m.m2 = a.m2 + b.m2 + delta * delta * ((double) a.n * b.n / m.n);
+	m.fixed = a.fixed + b.fixed;
+	m.lost = a.lost + b.lost;
+
+	return m;
+}
+
+
+ReplicateStatistics::Moments ReplicateStatistics::getMoments(std::size_t step, std::size_t column) const {
+	Moments present = { 0, 0.0, 0.0, 0, 0 };
+	if (column < moments[step].size()) present = moments[step][column];
+
+	// replicates without the column have a frequency of 0
+	unsigned long long nMissing = nReplicates[step] - present.n;
+	Moments zeroes = { nMissing, 0.0, 0.0, 0, nMissing };
+
+	return combine(present, zeroes);
+}
+
+
+void ReplicateStatistics::reserveColumns(std::size_t step, std::size_t nColumns) {
+	if (moments[step].size() < nColumns) {
+		Moments empty = { 0, 0.0, 0.0, 0, 0 };
+		moments[step].resize(nColumns, empty);
+		histograms[step].resize(nColumns * nBins, 0);
+	}
+}
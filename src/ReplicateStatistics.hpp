@@ -0,0 +1,162 @@
+#ifndef REPLICATE_STATISTICS_H
+#define REPLICATE_STATISTICS_H
+
+#include <string>
+#include <vector>
+#include "Globals.hpp"
+
+
+/** \brief Class accumulating allele frequency statistics across replicates
+ *
+ * For every step and every output column, keeps the running mean and
+ * variance of the frequencies (Welford's algorithm), the number of
+ * replicates where the allele is fixed or lost, and a histogram of the
+ * frequencies from which quantiles are estimated (with an error of at
+ * most one bin width).
+ * Accumulators filled with disjoint sets of replicates can be merged;
+ * merging them in a fixed order gives a deterministic result.
+ *
+ * A replicate that does not have a column (e.g. an allele that only
+ * appeared in other replicates) counts as a frequency of 0 for it.
+ *
+ * */
+class ReplicateStatistics {
+
+public:
+
+	/** \brief ReplicateStatistics constructor
+	 *
+	 * \param nSteps		number of steps to accumulate
+	 * \param nBins			number of bins of the frequency histograms
+	 * */
+	ReplicateStatistics(std::size_t nSteps = 0, std::size_t nBins = _DEFAULT_STATISTICS_BINS_);
+
+
+	/** \brief Add the state of one replicate at one step
+	 *
+	 * \param step				index of the step
+	 * \param counts			allele counts of the replicate (output columns)
+	 * \param populationSize	total population size, the counts' denominator
+	 * */
+	template <typename Count>
+	void add(std::size_t step, const std::vector<Count>& counts, unsigned long long populationSize);
+
+
+	/** \brief Add the state of one replicate at one step, its columns being split into groups
+	 *
+	 * The columns form groups of the same size, one after the other (e.g. the
+	 * alleles of every deme), each counted over the size of its group. The
+	 * frequencies of an empty group are 0.
+	 *
+	 * \param step				index of the step
+	 * \param counts			allele counts of the replicate (output columns)
+	 * \param groupSizes		size of every group, the denominator of its counts
+	 * */
+	template <typename Count>
+	void add(std::size_t step, const std::vector<Count>& counts, const std::vector<unsigned long long>& groupSizes);
+
+
+	/** \brief Merge the statistics of other replicates into this accumulator
+	 *
+	 * \param other			accumulator over the same steps and bins
+	 * */
+	void merge(const ReplicateStatistics& other);
+
+
+	/** \brief Get the number of steps
+	 * */
+	std::size_t getNbSteps() const;
+
+
+	/** \brief Get the number of columns seen at a step
+	 * */
+	std::size_t getNbColumns(std::size_t step) const;
+
+
+	/** \brief Get the number of replicates added at a step
+	 * */
+	unsigned long long getNbReplicates(std::size_t step) const;
+
+
+	/** \brief Get the mean frequency of a column
+	 * */
+	double getMean(std::size_t step, std::size_t column) const;
+
+
+	/** \brief Get the (unbiased) variance of the frequency of a column
+	 * */
+	double getVariance(std::size_t step, std::size_t column) const;
+
+
+	/** \brief Get the fraction of replicates where the allele is fixed (frequency 1)
+	 * */
+	double getFixedFraction(std::size_t step, std::size_t column) const;
+
+
+	/** \brief Get the fraction of replicates where the allele is lost (frequency 0)
+	 * */
+	double getLostFraction(std::size_t step, std::size_t column) const;
+
+
+	/** \brief Estimate a quantile of the frequency of a column
+	 *
+	 * Interpolates linearly within the histogram bin holding the quantile.
+	 *
+	 * \param q			the quantile, in [0, 1]
+	 * */
+	double getQuantile(std::size_t step, std::size_t column, double q) const;
+
+
+	/** \brief Utility function to format the statistics of a step for the output
+	 *
+	 * \return A string with, for every column, the following format:
+	 * mean|variance|fixed|lost|q05|q50|q95, the columns being separated by tabs
+	 * */
+	std::string getStatisticsForOutput(std::size_t step) const;
+
+private:
+
+	//!< Moments and absorbing-state counts of one column
+	struct Moments {
+		unsigned long long n;
+		double mean;
+		double m2;
+		unsigned long long fixed;
+		unsigned long long lost;
+	};
+
+
+	//!< Combine two sets of moments (Chan et al.)
+	static Moments combine(const Moments& a, const Moments& b);
+
+
+	//!< Moments of a column, including the zeros of the replicates without that column
+	Moments getMoments(std::size_t step, std::size_t column) const;
+
+
+	//!< Add the counts of a replicate, split into \p nGroups groups of columns over their \p groupSizes
+	template <typename Count>
+	void addGroups(std::size_t step, const std::vector<Count>& counts, const unsigned long long* groupSizes, std::size_t nGroups);
+
+
+	//!< Make sure a step has at least \p nColumns columns
+	void reserveColumns(std::size_t step, std::size_t nColumns);
+
+
+	//!< Number of histogram bins
+	std::size_t nBins;
+
+
+	//!< Number of replicates added, per step
+	std::vector<unsigned long long> nReplicates;
+
+
+	//!< Moments, indexed by [step][column]
+	std::vector< std::vector<Moments> > moments;
+
+
+	//!< Histograms, indexed by [step][column * nBins + bin]
+	std::vector< std::vector<unsigned int> > histograms;
+};
+
+#endif
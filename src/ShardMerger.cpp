@@ -0,0 +1,184 @@
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <vector>
+#include "ShardMerger.hpp"
+#include "TrajectoryReader.hpp"
+#include "TrajectoryWriter.hpp"
+#include "Globals.hpp"
+
+
+namespace {
+	// read the files of every shard at once
+	std::vector< std::unique_ptr<std::ifstream> > openAll(const std::vector<std::string>& paths) {
+		std::vector< std::unique_ptr<std::ifstream> > files;
+
+		for (auto& path : paths) {
+			files.emplace_back(new std::ifstream(path));
+			if (!files.back()->is_open()) {
+				throw std::runtime_error("Shard file impossible to open: " + path);
+			}
+		}
+
+		return files;
+	}
+
+
+	bool exists(const std::string& path) {
+		struct stat info;
+		return stat(path.c_str(), &info) == 0;
+	}
+}
+
+
+ShardMerger::ShardMerger(int n, const std::string& dir)
+  : nShards(n), directory(dir)
+{
+	if (nShards < 1) {
+		throw std::runtime_error("The number of shards must be > 0.");
+	}
+}
+
+
+std::string ShardMerger::getShardFileName(const std::string& fileName, int shard, int nShards) {
+	std::size_t extension = fileName.rfind('.');
+	if (extension == std::string::npos) extension = fileName.size();
+
+	return fileName.substr(0, extension) + ".shard-" + std::to_string(shard) + "-of-" + std::to_string(nShards)
+		+ fileName.substr(extension);
+}
+
+
+void ShardMerger::merge() const {
+	mergeResults(_OUTPUT_FILE_);
+
+	if (exists(getShardPath(_OUTPUT_ABSORPTION_FILE_, 0))) {
+		mergeAbsorptionTimes(_OUTPUT_ABSORPTION_FILE_);
+	}
+
+	if (exists(getShardPath(_OUTPUT_BINARY_FILE_, 0))) {
+		mergeBinaryResults(_OUTPUT_BINARY_FILE_);
+	}
+}
+
+
+void ShardMerger::mergeResults(const std::string& fileName) const {
+	std::vector<std::string> paths;
+	for (int shard = 0; shard < nShards; ++shard) {
+		paths.push_back(getShardPath(fileName, shard));
+	}
+
+	std::vector< std::unique_ptr<std::ifstream> > shards = openAll(paths);
+	std::ofstream out(fileName);
+
+	// a line is the step, then the columns of the replicates, each followed by a tab
+	std::string line, shardLine;
+	while (std::getline(*shards.front(), line)) {
+		std::size_t stepEnd = line.find('\t');
+		if (stepEnd == std::string::npos) {
+			throw std::runtime_error("Not a result file: " + paths.front());
+		}
+
+		for (int shard = 1; shard < nShards; ++shard) {
+			if (!std::getline(*shards[shard], shardLine) || shardLine.compare(0, stepEnd + 1, line, 0, stepEnd + 1) != 0) {
+				throw std::runtime_error("The steps of " + paths[shard] + " do not match those of " + paths.front());
+			}
+
+			line.append(shardLine, stepEnd + 1, std::string::npos);
+		}
+
+		out << line << '\n';
+	}
+
+	for (int shard = 1; shard < nShards; ++shard) {
+		if (std::getline(*shards[shard], shardLine)) {
+			throw std::runtime_error("The steps of " + paths[shard] + " do not match those of " + paths.front());
+		}
+	}
+}
+
+
+void ShardMerger::mergeAbsorptionTimes(const std::string& fileName) const {
+	std::vector<std::string> paths;
+	for (int shard = 0; shard < nShards; ++shard) {
+		paths.push_back(getShardPath(fileName, shard));
+	}
+
+	std::vector< std::unique_ptr<std::ifstream> > shards = openAll(paths);
+	std::ofstream out(fileName);
+
+	// the replicates are numbered across the run: only the header is repeated
+	std::string header;
+	for (int shard = 0; shard < nShards; ++shard) {
+		std::getline(*shards[shard], header);
+		if (shard == 0) out << header << '\n';
+
+		if (shards[shard]->peek() != std::ifstream::traits_type::eof()) {
+			out << shards[shard]->rdbuf();
+		}
+	}
+}
+
+
+void ShardMerger::mergeBinaryResults(const std::string& fileName) const {
+	std::vector< std::unique_ptr<TrajectoryReader> > shards;
+	std::size_t nReplicates = 0;
+
+	for (int shard = 0; shard < nShards; ++shard) {
+		std::string path = getShardPath(fileName, shard);
+		shards.emplace_back(new TrajectoryReader(path));
+
+		const TrajectoryReader& first = *shards.front();
+		const TrajectoryReader& reader = *shards.back();
+		if (reader.getNbDemes() != first.getNbDemes() || reader.getExecutionMode() != first.getExecutionMode()
+			|| reader.getSeed() != first.getSeed() || reader.getParameters() != first.getParameters()
+			|| reader.getNbSteps() != first.getNbSteps()) {
+			throw std::runtime_error("The run of " + path + " does not match that of " + getShardPath(fileName, 0));
+		}
+
+		nReplicates += reader.getNbReplicates();
+	}
+
+	const TrajectoryReader& first = *shards.front();
+	TrajectoryWriter out(fileName, (int) nReplicates, (int) first.getNbDemes(), first.getExecutionMode(),
+						 first.getSeed(), first.getParameters());
+
+	// one step of every replicate at a time, the columns of the shards are mapped in place
+	std::vector< std::vector<unsigned int> > counts(nReplicates);
+	for (std::size_t step = 0; step < first.getNbSteps(); ++step) {
+		std::size_t replicate = 0;
+
+		for (int shard = 0; shard < nShards; ++shard) {
+			const TrajectoryReader& reader = *shards[shard];
+			if (reader.getGeneration(step) != first.getGeneration(step)
+				|| reader.getPopulationSize(step) != first.getPopulationSize(step)) {
+				throw std::runtime_error("The steps of " + getShardPath(fileName, shard) + " do not match those of " + getShardPath(fileName, 0));
+			}
+
+			for (std::size_t r = 0; r < reader.getNbReplicates(); ++r, ++replicate) {
+				counts[replicate].resize(reader.getNbColumns(step));
+
+				for (std::size_t c = 0; c < counts[replicate].size(); ++c) {
+					counts[replicate][c] = reader.getColumn(step, c)[r];
+				}
+			}
+		}
+
+		out.writeStep((int) first.getGeneration(step), first.getPopulationSize(step), counts);
+	}
+
+	std::vector< std::vector<std::string> > alleles;
+	for (auto& reader : shards) {
+		for (std::size_t r = 0; r < reader->getNbReplicates(); ++r) {
+			alleles.push_back(reader->getAlleles(r));
+		}
+	}
+
+	out.close(alleles);
+}
+
+
+std::string ShardMerger::getShardPath(const std::string& fileName, int shard) const {
+	return directory + "/" + getShardFileName(fileName, shard, nShards);
+}
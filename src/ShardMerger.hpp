@@ -0,0 +1,89 @@
+#ifndef SHARD_MERGER_H
+#define SHARD_MERGER_H
+
+#include <string>
+
+
+/** \brief Class merging the output of a run split into shards
+ *
+ * A run started with --shard i/n only simulates the i-th contiguous slice
+ * of the replicates, and writes its own copy of every output file (see
+ * getShardFileName()). The merger puts the replicates of the n shards back
+ * side by side, in the layout of a run that was not split: the files are
+ * streamed line by line (step by step for the binary output), so only one
+ * line of every shard is held in memory.
+ * Throws std::runtime_error if a shard is missing, or if the shards do not
+ * come from the same run.
+ *
+ * */
+class ShardMerger {
+
+public:
+
+	/** \brief ShardMerger constructor
+	 *
+	 * \param nShards		number of shards the run was split into
+	 * \param directory	directory holding the output files of the shards
+	 * */
+	ShardMerger(int nShards, const std::string& directory = ".");
+
+
+	/** \brief Get the name of the output file of a shard
+	 *
+	 * The shard is inserted before the extension: results.txt becomes
+	 * results.shard-2-of-8.txt.
+	 *
+	 * \param fileName		name of the output file of a run that is not split
+	 * \param shard			index of the shard, from 0
+	 * \param nShards		number of shards
+	 * */
+	static std::string getShardFileName(const std::string& fileName, int shard, int nShards);
+
+
+	/** \brief Merge the output files the shards have written into the working directory
+	 *
+	 * The result file is required, the absorption times and the binary
+	 * output are merged if the first shard has them.
+	 * */
+	void merge() const;
+
+
+	/** \brief Merge the result files: every line gets the columns of every shard, in order
+	 *
+	 * \param fileName		name of the merged file (that of the run that is not split)
+	 * */
+	void mergeResults(const std::string& fileName) const;
+
+
+	/** \brief Merge the absorption times: the replicates of every shard, in order
+	 *
+	 * \param fileName		name of the merged file (that of the run that is not split)
+	 * */
+	void mergeAbsorptionTimes(const std::string& fileName) const;
+
+
+	/** \brief Merge the binary result files, step by step
+	 *
+	 * \param fileName		name of the merged file (that of the run that is not split)
+	 * */
+	void mergeBinaryResults(const std::string& fileName) const;
+
+private:
+
+	/** \brief Get the path of the output file of a shard
+	 *
+	 * \param fileName		name of the output file of a run that is not split
+	 * \param shard			index of the shard
+	 * */
+	std::string getShardPath(const std::string& fileName, int shard) const;
+
+
+	//!< Number of shards
+	int nShards;
+
+
+	//!< Directory holding the output files of the shards
+	std::string directory;
+};
+
+#endif
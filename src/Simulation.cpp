@@ -1,11 +1,65 @@
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <string>
 #include <algorithm>
+#include <numeric>
 #include "Simulation.hpp"
 #include "Random.hpp"
+#include "FrequencyFormatter.hpp"
+#include "Checkpoint.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+	// slot of an extinct allele, once reclaimed
+	const std::size_t NO_SLOT = (std::size_t) -1;
+	
+	
+	// Fenwick tree over the cells of a table: tree[j] sums the cells (j - lowbit(j), j]
+	void buildTree(std::vector<unsigned int>& tree, const std::vector<unsigned int>& cells) {
+		tree[0] = 0;
+		std::copy(cells.begin(), cells.end(), tree.begin() + 1);
+		
+		for (std::size_t j = 1; j < tree.size(); ++j) {
+			std::size_t parent = j + (j & (~j + 1));
+			if (parent < tree.size()) tree[parent] += tree[j];
+		}
+	}
+	
+	
+	// sum of the cells before a cell
+	std::size_t sumBefore(const std::vector<unsigned int>& tree, std::size_t cell) {
+		std::size_t sum = 0;
+		for (std::size_t j = cell; j > 0; j -= j & (~j + 1)) {
+			sum += tree[j];
+		}
+		
+		return sum;
+	}
+	
+	
+	// cell of the individual at a position, removed from the tree
+	std::size_t takeFromTree(std::vector<unsigned int>& tree, std::size_t position) {
+		std::size_t cell = 0;
+		std::size_t step = 1;
+		while (step * 2 < tree.size()) step *= 2;
+		
+		for (; step > 0; step /= 2) {
+			if (cell + step < tree.size() && tree[cell + step] <= position) {
+				cell += step;
+				position -= tree[cell];
+			}
+		}
+		
+		for (std::size_t j = cell + 1; j < tree.size(); j += j & (~j + 1)) {
+			--tree[j];
+		}
+		
+		return cell;
+	}
+}
 
 
 Simulation::Simulation(const Simulation& other)
@@ -14,11 +68,44 @@ Simulation::Simulation(const Simulation& other)
 	alleles(other.alleles),
 	allelesCount(other.allelesCount),
 	mutationFqs(other.mutationFqs),
+	maxMutationFq(other.maxMutationFq),
 	mutationTable(other.mutationTable),
+	haplotypes(other.haplotypes),
+	mutationTargets(other.mutationTargets),
+	slotAlleles(other.slotAlleles),
+	alleleSlots(other.alleleSlots),
+	compactionPeriod(other.compactionPeriod),
+	reclaimedSlots(other.reclaimedSlots),
+	allelesCountByIndex(other.allelesCountByIndex),
 	selectionFqs(other.selectionFqs),
-	subPopulations(other.subPopulations),
+	demeCounts(other.demeCounts),
+	nextDemeCounts(other.nextDemeCounts),
+	drawCounts(other.drawCounts),
+	drawAlleles(other.drawAlleles),
+	firstMigrantSlots(other.firstMigrantSlots),
+	lastMigrantSlots(other.lastMigrantSlots),
+	migrantAlleles(other.migrantAlleles),
+	migrantCounts(other.migrantCounts),
+	demeEngines(other.demeEngines),
+	demePool(other.demePool),
+	islandMigrants(other.islandMigrants),
+	emigrantCounts(other.emigrantCounts),
+	emigrantTotals(other.emigrantTotals),
+	migrantTree(other.migrantTree),
 	subPopulationSizes(other.subPopulationSizes),
-	migrationRates(other.migrationRates),
+	migrationGraph(other.migrationGraph),
+	isMigrationDetailedOutput(other.isMigrationDetailedOutput),
+	demography(other.demography),
+	initialDemeSizes(other.initialDemeSizes),
+	demeTargets(other.demeTargets),
+	lossTimes(other.lossTimes),
+	fixationTime(other.fixationTime),
+	fixedAllele(other.fixedAllele),
+	activeAlleles(other.activeAlleles),
+	skippedDraws(other.skippedDraws),
+	multinomialAlleles(other.multinomialAlleles),
+	diffusionThreshold(other.diffusionThreshold),
+	rng(other.rng),
 	precision(other.precision),
 	additionalSpaces(other.additionalSpaces)
 {	}
@@ -29,11 +116,44 @@ Simulation& Simulation::operator=(const Simulation& other) {
 	alleles = other.alleles;
 	allelesCount = other.allelesCount;
 	mutationFqs = other.mutationFqs;
+	maxMutationFq = other.maxMutationFq;
 	mutationTable = other.mutationTable;
+	haplotypes = other.haplotypes;
+	mutationTargets = other.mutationTargets;
+	slotAlleles = other.slotAlleles;
+	alleleSlots = other.alleleSlots;
+	compactionPeriod = other.compactionPeriod;
+	reclaimedSlots = other.reclaimedSlots;
+	allelesCountByIndex = other.allelesCountByIndex;
 	selectionFqs = other.selectionFqs;
-	subPopulations = other.subPopulations;
+	demeCounts = other.demeCounts;
+	nextDemeCounts = other.nextDemeCounts;
+	drawCounts = other.drawCounts;
+	drawAlleles = other.drawAlleles;
+	firstMigrantSlots = other.firstMigrantSlots;
+	lastMigrantSlots = other.lastMigrantSlots;
+	migrantAlleles = other.migrantAlleles;
+	migrantCounts = other.migrantCounts;
+	demeEngines = other.demeEngines;
+	demePool = other.demePool;
+	islandMigrants = other.islandMigrants;
+	emigrantCounts = other.emigrantCounts;
+	emigrantTotals = other.emigrantTotals;
+	migrantTree = other.migrantTree;
 	subPopulationSizes = other.subPopulationSizes;
-	migrationRates = other.migrationRates;
+	migrationGraph = other.migrationGraph;
+	isMigrationDetailedOutput = other.isMigrationDetailedOutput;
+	demography = other.demography;
+	initialDemeSizes = other.initialDemeSizes;
+	demeTargets = other.demeTargets;
+	lossTimes = other.lossTimes;
+	fixationTime = other.fixationTime;
+	fixedAllele = other.fixedAllele;
+	activeAlleles = other.activeAlleles;
+	skippedDraws = other.skippedDraws;
+	multinomialAlleles = other.multinomialAlleles;
+	diffusionThreshold = other.diffusionThreshold;
+	rng = other.rng;
 	precision = other.precision;
 	additionalSpaces = other.additionalSpaces;
 	
@@ -56,7 +176,12 @@ Simulation::Simulation(const std::vector<std::string>& als,
 	assert(populationSize > 0);
 	
 	
+	// every allele takes part in the first multinomial
+	activeAlleles.resize(alleles.size());
+	std::iota(activeAlleles.begin(), activeAlleles.end(), 0);
+	
 	calcOutputConstants();
+	updateAbsorption(0);
 }
 
 
@@ -67,9 +192,15 @@ Simulation::Simulation(const std::vector<std::string>& als,
   : executionMode(_EXECUTION_MODE_MUTATIONS_),
 	populationSize(0), 
 	alleles(als), allelesCount(alsCount), 
-	mutationFqs(mutationRates), mutationTable(nuclMutationProbs)
+	mutationFqs(mutationRates), mutationTable(nuclMutationProbs),
+	haplotypes(als)
 {	
 	assert(alleles.size() == allelesCount.size());
+	assert(haplotypes.size() == alleles.size());
+	
+	// long sequences are identified by their differences from the reference
+	alleles.clear();
+	syncAlleles();
 	
 	for (auto& count : allelesCount)
 		populationSize += count;
@@ -78,11 +209,28 @@ Simulation::Simulation(const std::vector<std::string>& als,
 	assert(populationSize > 0);
 	
 	// mutation rates - sanitize input
-	while (mutationFqs.size() < alleles.front().size()) {
+	while (mutationFqs.size() < haplotypes.getNbSites()) {
 		mutationFqs.push_back(_DEFAULT_MUTATION_RATE_);
 	}
 	
+	maxMutationFq = mutationFqs.empty() ? 0.0 : *std::max_element(mutationFqs.begin(), mutationFqs.end());
+	
+	// mutation targets, drawn from a single uniform
+	for (int i = 0; i < Nucl::Nucleotide::N; ++i) {
+		mutationTargets[i] = AliasTable(std::vector<double>(mutationTable[i].begin(), mutationTable[i].end()));
+	}
+	
+	// every allele starts in its own slot
+	slotAlleles.resize(alleles.size());
+	std::iota(slotAlleles.begin(), slotAlleles.end(), 0);
+	alleleSlots = slotAlleles;
+	
+	// every allele takes part in the first multinomial
+	activeAlleles.resize(alleles.size());
+	std::iota(activeAlleles.begin(), activeAlleles.end(), 0);
+	
 	calcOutputConstants();
+	updateAbsorption(0);
 }
 
 
@@ -90,10 +238,22 @@ Simulation::Simulation(const std::vector<std::string>& als,
 						const std::vector< std::vector<unsigned int> >& subPopsCount,
 						const std::vector< std::vector<unsigned int> >& migrationFqs,
 						bool detailedOutput)
+  : Simulation(als, subPopsCount, std::make_shared<const MigrationGraph>(migrationFqs), detailedOutput)
+{
+	assert(migrationFqs.size() == subPopsCount.size());
+}
+
+
+Simulation::Simulation(const std::vector<std::string>& als,
+						const std::vector< std::vector<unsigned int> >& subPopsCount,
+						std::shared_ptr<const MigrationGraph> graph,
+						bool detailedOutput)
   : executionMode(_EXECUTION_MODE_MIGRATION_), 
 	populationSize(0), 
-	alleles(als), subPopulations(subPopsCount),
-	migrationRates(migrationFqs),
+	alleles(als),
+	drawCounts(1, std::vector<unsigned int>(als.size(), 0)),
+	drawAlleles(1, std::vector<std::size_t>(als.size(), 0)),
+	migrationGraph(graph),
 	isMigrationDetailedOutput(detailedOutput)
 {    
     for (auto& population : subPopsCount) {
@@ -103,24 +263,49 @@ Simulation::Simulation(const std::vector<std::string>& als,
 		for (auto& count : population)
 			subPopSize += count;
 			
+		demeCounts.insert(demeCounts.end(), population.begin(), population.end());
 		subPopulationSizes.push_back(subPopSize);
 		populationSize += subPopSize;
 	}
+	
+	nextDemeCounts.resize(demeCounts.size());
+	initialDemeSizes = subPopulationSizes;
+	demeTargets = subPopulationSizes;
 		
 	// make sure sensible parameters were used
 	assert(populationSize > 0);
-	assert(migrationRates.size() == subPopulations.size());
-	assert(migrationRates.front().size() == subPopulations.size());
+	assert(migrationGraph->getNbDemes() == subPopulationSizes.size());
 	
-	for (size_t i = 0; i < subPopulations.size(); ++i) {
-		int outgoing = 0;
-		for (auto& out : migrationRates[i])
-			outgoing += out;
-			
-		assert(outgoing <= (int) subPopulationSizes[i]);
+	for (size_t i = 0; i < migrationGraph->getNbDemes(); ++i) {
+		assert(migrationGraph->getEmigrants(i) <= subPopulationSizes[i]);
 	}
 	
+	// a complete graph with a single rate goes through a pool of migrants, in O(D.K)
+	if (subPopulationSizes.size() > 2) {
+		islandMigrants = migrationGraph->getUniformMigrants();
+	}
+	
+	if (islandMigrants > 0) {
+		emigrantCounts.resize(demeCounts.size());
+		emigrantTotals.resize(subPopulationSizes.size());
+		migrantTree.resize(demeCounts.size() + 1);
+	}
+	
+	// otherwise an edge keeps every allele drawn along it, at most one per migrant
+	std::size_t nEdges = islandMigrants > 0 ? 0 : migrationGraph->getFirstEdge(migrationGraph->getNbDemes());
+	firstMigrantSlots.assign(nEdges + 1, 0);
+	for (std::size_t edge = 0; edge < nEdges; ++edge) {
+		firstMigrantSlots[edge + 1] = firstMigrantSlots[edge] + std::min((std::size_t) migrationGraph->getMigrants(edge), alleles.size());
+	}
+	
+	lastMigrantSlots.assign(firstMigrantSlots.begin(), firstMigrantSlots.end() - 1);
+	migrantAlleles.resize(firstMigrantSlots.back());
+	migrantCounts.resize(firstMigrantSlots.back());
+	
+	setRandomStream(rng.getSeed(), rng.getStream());
+	
 	calcOutputConstants();
+	updateAbsorption(0);
 }
 
 
@@ -149,6 +334,7 @@ Simulation::Simulation(const std::vector<std::string>& als,
 	}
 	
 	calcOutputConstants();
+	updateAbsorption(0);
 }
 
 
@@ -159,10 +345,7 @@ Simulation::Simulation(const std::vector<std::string>& als,
 						const double reduction)
   : executionMode(_EXECUTION_MODE_BOTTLENECK_),
 	populationSize(0), 
-	alleles(als), allelesCount(alsCount),
-	popReduction(reduction),
-	bottleneckStart(start),
-	bottleneckEnd(stop)
+	alleles(als), allelesCount(alsCount)
 {
 	assert(alleles.size() == allelesCount.size());
 	
@@ -172,10 +355,16 @@ Simulation::Simulation(const std::vector<std::string>& als,
 	// make sure sensible parameters were used
 	assert(populationSize > 0);
 	
+	// every allele takes part in the first multinomial
+	activeAlleles.resize(alleles.size());
+	std::iota(activeAlleles.begin(), activeAlleles.end(), 0);
+	
 	calcOutputConstants();
+	updateAbsorption(0);
 	
-	assert(popReduction != 0);
-	assert(bottleneckStart <= bottleneckEnd);
+	assert(reduction != 0);
+	assert(start <= stop);
+	demography = std::make_shared<const Demography>(Demography::bottleneck(populationSize, start, stop, reduction));
 }
 
 
@@ -189,60 +378,123 @@ void Simulation::calcOutputConstants() {
 
 
 const std::vector<std::string>& Simulation::getAlleles() const {
+	syncAlleles();
 	return alleles;
 }
 
 
+void Simulation::syncAlleles() const {
+	if (executionMode != _EXECUTION_MODE_MUTATIONS_) return;
+	
+	// the alleles only get appended, so only the new ones are built
+	bool isSequence = haplotypes.getNbSites() <= _MAX_SEQUENCE_IDENTIFIER_SITES_;
+	
+	for (std::size_t i = alleles.size(); i < haplotypes.size(); ++i) {
+		alleles.push_back(isSequence ? haplotypes.toString(i) : haplotypes.describe(i));
+	}
+}
+
+
 const std::vector<unsigned int>& Simulation::getAllelesCount() const {
-	return allelesCount;
+	return getCountsByAllele();
+}
+
+
+const std::vector<unsigned int>& Simulation::getCountsByAllele() const {
+	// the slots match the alleles until the first slot is reclaimed
+	if (reclaimedSlots == 0) return allelesCount;
+	
+	allelesCountByIndex.assign(haplotypes.size(), 0);
+	for (std::size_t slot = 0; slot < allelesCount.size(); ++slot) {
+		allelesCountByIndex[slotAlleles[slot]] = allelesCount[slot];
+	}
+	
+	return allelesCountByIndex;
 }
 
 
 std::string Simulation::getAlleleFqsForOutput() const {
-	std::stringstream ss;
+	FrequencyFormatter formatter(precision, (unsigned long long) populationSize);
+	std::string out;
 	
 	if (executionMode != _EXECUTION_MODE_MIGRATION_) {
+		const std::vector<unsigned int>& counts = getCountsByAllele();
+		out.reserve(counts.size() * (precision + 3));
 		
-		for (auto allele = allelesCount.begin(); allele != allelesCount.end(); ++allele) {
-			if (allele != allelesCount.begin()) ss << _OUTPUT_SEPARATOR_;
-			ss << std::setprecision((int) precision) << std::fixed << (*allele) * 1.0 / populationSize;
+		for (auto allele = counts.begin(); allele != counts.end(); ++allele) {
+			if (allele != counts.begin()) out += _OUTPUT_SEPARATOR_;
+			formatter.append(out, *allele);
 		}
 		
 	} else {
 		
+		std::size_t nAlleles = alleles.size();
+		
 		if (isMigrationDetailedOutput) {
 
-			for (auto subPop = subPopulations.begin(); subPop != subPopulations.end(); ++subPop) {
-				for (auto allele = subPop->begin(); allele != subPop->end(); ++allele) {
-					if (allele != subPop->begin()) ss << _OUTPUT_SEPARATOR_;
-					ss << std::setprecision((int) precision) << std::fixed << (*allele) * 1.0 / populationSize;
+			for (std::size_t deme = 0; deme < subPopulationSizes.size(); ++deme) {
+				for (std::size_t i = 0; i < nAlleles; ++i) {
+					if (i != 0) out += _OUTPUT_SEPARATOR_;
+					formatter.append(out, demeCounts[deme * nAlleles + i]);
 				}
 				
-				ss << _MIGRATION_OUTPUT_SEPARATOR_;
+				out += _MIGRATION_OUTPUT_SEPARATOR_;
 			}
 		} else {
-			int nAlleles = (int)subPopulations.front().size();
-			for (int i = 0; i < nAlleles; ++i) {
-				int sum = 0;
-				for (int j = 0; j < (int) subPopulations.size(); ++j) {
-					sum += subPopulations[j][i];
+			for (std::size_t i = 0; i < nAlleles; ++i) {
+				unsigned long long sum = 0;
+				for (std::size_t deme = 0; deme < subPopulationSizes.size(); ++deme) {
+					sum += demeCounts[deme * nAlleles + i];
 				}
 				
-				if (i != 0) ss << _OUTPUT_SEPARATOR_;
-				ss << std::setprecision((int) precision) << std::fixed << sum * 1.0 / populationSize;
+				if (i != 0) out += _OUTPUT_SEPARATOR_;
+				formatter.append(out, sum);
 			}
 		}
 	}
 	
-	return ss.str();
+	return out;
+}
+
+
+void Simulation::getAlleleCountsForOutput(std::vector<unsigned int>& counts) const {
+	if (executionMode != _EXECUTION_MODE_MIGRATION_) {
+		counts = getCountsByAllele();
+		
+	} else if (isMigrationDetailedOutput) {
+		// the rows of the demes, one after the other
+		counts = demeCounts;
+		
+	} else {
+		counts.assign(alleles.size(), 0);
+		for (std::size_t i = 0; i < demeCounts.size(); ++i) {
+			counts[i % counts.size()] += demeCounts[i];
+		}
+	}
+}
+
+
+void Simulation::getColumnSizesForOutput(std::vector<unsigned long long>& sizes) const {
+	if (executionMode == _EXECUTION_MODE_MIGRATION_ && isMigrationDetailedOutput) {
+		sizes.assign(subPopulationSizes.begin(), subPopulationSizes.end());
+	} else {
+		sizes.assign(1, (unsigned long long) populationSize);
+	}
 }
 
 
 std::string Simulation::getAlleleStrings() const {
+	syncAlleles();
+	
+	return getAlleleStrings(alleles);
+}
+
+
+std::string Simulation::getAlleleStrings(const std::vector<std::string>& identifiers) const {
 	std::stringstream ss;
 
-	for (auto allele = alleles.begin(); allele != alleles.end(); ++allele) {
-		if (allele != alleles.begin()) ss << _OUTPUT_SEPARATOR_;
+	for (auto allele = identifiers.begin(); allele != identifiers.end(); ++allele) {
+		if (allele != identifiers.begin()) ss << _OUTPUT_SEPARATOR_;
 		ss << (*allele) << std::string(additionalSpaces, ' ');
 	}
 	
@@ -250,9 +502,9 @@ std::string Simulation::getAlleleStrings() const {
 	if (executionMode == _EXECUTION_MODE_MIGRATION_ && isMigrationDetailedOutput) {
 		std::string onePop = ss.str();
 		
-		assert(!subPopulations.empty());
+		assert(!subPopulationSizes.empty());
 		
-		for (std::size_t i = 1; i < subPopulations.size(); ++i) {
+		for (std::size_t i = 1; i < subPopulationSizes.size(); ++i) {
 			ss << _MIGRATION_OUTPUT_SEPARATOR_ << onePop;
 		}
 	}
@@ -261,10 +513,107 @@ std::string Simulation::getAlleleStrings() const {
 }
 
 
+void Simulation::setRandomStream(unsigned long long seed, unsigned long long stream) {
+	rng.seed(seed, stream);
+	
+	demeEngines.resize(subPopulationSizes.size());
+	for (std::size_t deme = 0; deme < demeEngines.size(); ++deme) {
+		demeEngines[deme].seed(seed, RandomEngine::getSubstream(stream, deme));
+	}
+}
+
+
+void Simulation::setThreadPool(ThreadPool* pool) {
+	demePool = pool;
+	
+	// a few parts per thread, so that the threads stay busy when the demes are uneven
+	std::size_t nParts = pool ? std::min(subPopulationSizes.size(), (std::size_t) pool->getNbThreads() * _MIGRATION_PARTS_PER_THREAD_) : 1;
+	drawCounts.resize(std::max(nParts, (std::size_t) 1), std::vector<unsigned int>(alleles.size(), 0));
+	drawAlleles.resize(drawCounts.size(), std::vector<std::size_t>(alleles.size(), 0));
+}
+
+
+void Simulation::saveState(std::ostream& out) const {
+	Checkpoint::put(out, populationSize);
+	Checkpoint::put(out, allelesCount);
+	Checkpoint::put(out, demeCounts);
+	Checkpoint::put(out, subPopulationSizes);
+	Checkpoint::put(out, demeEngines);
+	Checkpoint::put(out, lossTimes);
+	Checkpoint::put(out, fixationTime);
+	Checkpoint::put(out, fixedAllele);
+	Checkpoint::put(out, activeAlleles);
+	Checkpoint::put(out, skippedDraws);
+	Checkpoint::put(out, multinomialAlleles);
+	Checkpoint::put(out, rng);
+	
+	if (executionMode == _EXECUTION_MODE_MUTATIONS_) {
+		// the identifiers of the freed haplotypes can not be built again
+		syncAlleles();
+		
+		haplotypes.saveState(out);
+		Checkpoint::put(out, alleles);
+		Checkpoint::put(out, slotAlleles);
+		Checkpoint::put(out, alleleSlots);
+		Checkpoint::put(out, reclaimedSlots);
+	}
+}
+
+
+void Simulation::loadState(std::istream& in) {
+	Checkpoint::get(in, populationSize);
+	Checkpoint::get(in, allelesCount);
+	Checkpoint::get(in, demeCounts);
+	Checkpoint::get(in, subPopulationSizes);
+	Checkpoint::get(in, demeEngines);
+	Checkpoint::get(in, lossTimes);
+	Checkpoint::get(in, fixationTime);
+	Checkpoint::get(in, fixedAllele);
+	Checkpoint::get(in, activeAlleles);
+	Checkpoint::get(in, skippedDraws);
+	Checkpoint::get(in, multinomialAlleles);
+	Checkpoint::get(in, rng);
+	
+	if (executionMode == _EXECUTION_MODE_MUTATIONS_) {
+		haplotypes.loadState(in);
+		Checkpoint::get(in, alleles);
+		Checkpoint::get(in, slotAlleles);
+		Checkpoint::get(in, alleleSlots);
+		Checkpoint::get(in, reclaimedSlots);
+	}
+}
+
+
+void Simulation::setDiffusionThreshold(double threshold) {
+	diffusionThreshold = threshold;
+}
+
+
+void Simulation::setCompactionPeriod(int period) {
+	compactionPeriod = period;
+}
+
+
 void Simulation::update(int t) {	
+	// the size of the next generation
+	if (executionMode == _EXECUTION_MODE_MIGRATION_) {
+		resizeDemes(t);
+	} else if (demography) {
+		populationSize = (int) demography->getSize(t + 1);
+	}
+	
+	if (isAbsorbed()) {
+		// nothing can change anymore, apart from the size of the population
+		if (demography && executionMode != _EXECUTION_MODE_MIGRATION_) {
+			allelesCount[fixedAllele] = (unsigned int) populationSize;
+		}
+		
+		return;
+	}
+	
 	switch (executionMode) {
 		case _EXECUTION_MODE_MUTATIONS_:
-			RandomDist::multinomial(allelesCount);	
+			sampleOffspring();
 			mutatePopulation();
 			break;
 			
@@ -276,121 +625,327 @@ void Simulation::update(int t) {
         	updateWithSelection();
         	break;
 			
-		case _EXECUTION_MODE_BOTTLENECK_:
-			bottleneck(t);
-			RandomDist::multinomial(allelesCount, populationSize);
-			break;
-        	
         case _EXECUTION_MODE_NONE_:
 		default:
-			RandomDist::multinomial(allelesCount);
+			sampleOffspring();
 			break;
 	}
+	
+	updateAbsorption(t + 1);
+	
+	if (executionMode == _EXECUTION_MODE_MUTATIONS_ && compactionPeriod > 0 && (t + 1) % compactionPeriod == 0) {
+		compactAlleles();
+	}
+}
+
+
+void Simulation::sampleOffspring() {
+	skippedDraws += (unsigned long long) RandomDist::multinomial(allelesCount, populationSize, activeAlleles, rng, diffusionThreshold);
+	multinomialAlleles += allelesCount.size();
 }
 
 
 void Simulation::mutatePopulation() {
 	assert(!mutationFqs.empty());
+	
+	size_t nbMarkers = haplotypes.getNbSites();
+	if (maxMutationFq <= 0.0 || nbMarkers == 0) return;
+	
+	// individuals are laid out allele by allele, in the order of the
+	// multinomial, with the counts before any mutation of this generation
+	static thread_local std::vector<std::size_t> blockAlleles;
+	static thread_local std::vector<long long> blockEnds;
+	
+	blockAlleles.clear();
+	blockEnds.clear();
+	
+	long long nbIndividuals = 0;
+	for (auto alleleIdx : activeAlleles) {
+		if (allelesCount[alleleIdx] == 0) continue;
+		
+		nbIndividuals += allelesCount[alleleIdx];
+		blockAlleles.push_back(alleleIdx);
+		blockEnds.push_back(nbIndividuals);
+	}
+	
+	// gaps between the (individual, marker) pairs hit at the largest rate
+	double logNoMutation = std::log1p(-std::min(maxMutationFq, 1.0));
+	long long nbSites = nbIndividuals * (long long) nbMarkers;
+	
+	long long site = -1;
+	long long individual = -1;
+	std::size_t block = 0;
+	std::size_t alleleIdx = 0;
+	
+	while (true) {
+		double u = 1.0 - RandomDist::uniformDoubleSingle(0.0, 1.0, rng);
+		double gap = std::floor(std::log(u) / logNoMutation);
+		if (!(gap < (double) (nbSites - site - 1))) break;
 		
-	// mutations
-	size_t nbMarkers = alleles.front().size();
-	for (size_t markerIdx = 0; markerIdx < nbMarkers; ++markerIdx) {
+		site += 1 + (long long) gap;
+		size_t markerIdx = (size_t) (site % (long long) nbMarkers);
 		
-		size_t nbAlleles = allelesCount.size();
-		for (size_t alleleIdx = 0; alleleIdx < nbAlleles; ++alleleIdx) {
+		// markers of lower rate keep part of the landings
+		if (mutationFqs[markerIdx] < maxMutationFq
+			&& RandomDist::uniformDoubleSingle(0.0, 1.0, rng) * maxMutationFq >= mutationFqs[markerIdx]) {
+			continue;
+		}
 		
-			// generate certain number of mutations
-			int nbMut = RandomDist::binomial(allelesCount[alleleIdx], mutationFqs[markerIdx]);
+		// an individual hit again carries its previous mutations
+		if (site / (long long) nbMarkers != individual) {
+			individual = site / (long long) nbMarkers;
+			while (blockEnds[block] <= individual) ++block;
 			
-			// iterate over mutations
-			for (int mutation = 0; mutation < nbMut; ++mutation) {
-										
-				// generate the target mutation
-				double mut = RandomDist::uniformDoubleSingle(0.0, 1.0);
-				Nucl::Nucleotide target = Nucl::Nucleotide::N;
-				
-				double pCount = 0.0;
-				for (int i = 0; i < Nucl::Nucleotide::N; ++i) {
-					pCount += mutationTable[Nucl::fromChar.at(alleles[alleleIdx][markerIdx])][i];
-					if (mut <= pCount) {
-						target = (Nucl::Nucleotide) i;
-						break;
-					}							
-				}
-				
-				if (target == Nucl::Nucleotide::N) {
-					std::cerr << _ERROR_MUTATION_TARGET_UNFINDABLE_MSG_ << std::endl;
-					exit(_ERROR_MUTATION_TARGET_UNFINDABLE_CODE_);
-				}
-				
-				// create new mutated allele
-				std::string newAllele = std::string(alleles[alleleIdx]);
-				newAllele[markerIdx] = Nucl::toChar[target];
-				
-				// remove original allele
-				allelesCount[alleleIdx]--;
-				
-				// add mutated allele
-				std::size_t newAlleleIdx = std::distance(
-					alleles.begin(), 
-					std::find(
-						alleles.begin(),
-						alleles.end(),
-						newAllele
-					));
-				 
-				if (newAlleleIdx < alleles.size()) {
-					allelesCount[newAlleleIdx]++;
-				} else {
-					alleles.push_back(newAllele);
-					allelesCount.push_back(1);
-				}
-				
-				// some user info
-				// std::cout << "Mutated a " << alleles[alleleIdx] << " to a " << newAllele << std::endl;
+			alleleIdx = blockAlleles[block];
+		}
+		
+		const AliasTable& targets = mutationTargets[haplotypes.getSite(slotAlleles[alleleIdx], markerIdx)];
+		if (targets.isEmpty()) {
+			std::cerr << _ERROR_MUTATION_TARGET_UNFINDABLE_MSG_ << std::endl;
+			exit(_ERROR_MUTATION_TARGET_UNFINDABLE_CODE_);
+		}
+		
+		// generate the target mutation
+		Nucl::Nucleotide target = (Nucl::Nucleotide) targets.draw(RandomDist::uniformDoubleSingle(0.0, 1.0, rng));
+		
+		// remove original allele
+		allelesCount[alleleIdx]--;
+		
+		// add mutated allele, found through the hash index of the haplotypes
+		std::size_t newAllele = haplotypes.mutate(slotAlleles[alleleIdx], markerIdx, target);
+		std::size_t newAlleleIdx = newAllele < alleleSlots.size() ? alleleSlots[newAllele] : NO_SLOT;
+		
+		if (newAlleleIdx != NO_SLOT) {
+			// an allele brought back takes part in the multinomial again
+			if (allelesCount[newAlleleIdx]++ == 0) {
+				activeAlleles.push_back(newAlleleIdx);
 			}
+		} else {
+			// a new allele, or one brought back after its slot was reclaimed
+			newAlleleIdx = allelesCount.size();
+			
+			if (newAllele < alleleSlots.size()) {
+				alleleSlots[newAllele] = newAlleleIdx;
+			} else {
+				alleleSlots.push_back(newAlleleIdx);
+			}
+			
+			slotAlleles.push_back(newAllele);
+			allelesCount.push_back(1);
+			activeAlleles.push_back(newAlleleIdx);
+		}
+		
+		alleleIdx = newAlleleIdx;
+	}
+}
+
+
+void Simulation::compactAlleles() {
+	static thread_local std::vector<std::size_t> newSlots;
+	newSlots.assign(allelesCount.size(), NO_SLOT);
+	
+	std::size_t nSlots = 0;
+	for (std::size_t slot = 0; slot < allelesCount.size(); ++slot) {
+		std::size_t allele = slotAlleles[slot];
+		
+		if (allelesCount[slot] == 0) {
+			alleleSlots[allele] = NO_SLOT;
+			continue;
 		}
+		
+		newSlots[slot] = nSlots;
+		alleleSlots[allele] = nSlots;
+		slotAlleles[nSlots] = allele;
+		allelesCount[nSlots] = allelesCount[slot];
+		++nSlots;
+	}
+	
+	reclaimedSlots += allelesCount.size() - nSlots;
+	allelesCount.resize(nSlots);
+	slotAlleles.resize(nSlots);
+	
+	// the haplotypes of the extinct alleles are freed, once their identifiers are built
+	syncAlleles();
+	haplotypes.release(slotAlleles);
+	
+	// the extinct alleles leave the multinomial, the others keep their order
+	std::size_t nActive = 0;
+	for (auto slot : activeAlleles) {
+		if (newSlots[slot] != NO_SLOT) activeAlleles[nActive++] = newSlots[slot];
 	}
+	
+	activeAlleles.resize(nActive);
 }
 
 
 void Simulation::updateWithMigration() {
-	// big container for all movements
-	std::vector< std::vector< std::vector<unsigned int> > > exchange;
-	
-	for (int i = 0; i < (int) subPopulations.size(); ++i) {
-		// exchange for current subpopulation
-		std::vector< std::vector<unsigned int> > subExchange(subPopulations.size(), std::vector<unsigned int>(subPopulations[i].size(), 0));
-		
-		// new values for population that will go
-		int gone = 0;
-		for (int j = 0; j < (int) subExchange.size(); ++j) {
-			gone += migrationRates[i][j];
-			subExchange[j] = RandomDist::multinomialByValue(subPopulations[i], migrationRates[i][j]);
+	// the demes draw their emigrants, then gather their immigrants: every
+	// deme only writes its own row, and the slots of its own edges
+	if (islandMigrants > 0) {
+		forEachDeme(&Simulation::emigrateToPool);
+		immigrateFromPool();
+	} else {
+		forEachDeme(&Simulation::emigrate);
+		forEachDeme(&Simulation::immigrate);
+	}
+	
+	demeCounts.swap(nextDemeCounts);
+	
+	// the demography, or a graph that is not symmetric, changes the sizes
+	populationSize = (int) std::accumulate(subPopulationSizes.begin(), subPopulationSizes.end(), (std::size_t) 0);
+}
+
+
+void Simulation::forEachDeme(void (Simulation::*step)(std::size_t, std::size_t)) {
+	std::size_t nDemes = subPopulationSizes.size();
+	std::size_t nParts = drawCounts.size();
+	
+	if (demePool && nParts > 1) {
+		demePool->parallelFor(nParts, [this, step, nDemes, nParts](std::size_t part) {
+			for (std::size_t deme = part * nDemes / nParts; deme < (part + 1) * nDemes / nParts; ++deme) {
+				(this->*step)(deme, part);
+			}
+		});
+	} else {
+		for (std::size_t deme = 0; deme < nDemes; ++deme) {
+			(this->*step)(deme, 0);
+		}
+	}
+}
+
+
+void Simulation::emigrate(std::size_t deme, std::size_t part) {
+	const MigrationGraph& graph = *migrationGraph;
+	std::vector<unsigned int>& counts = drawCounts[part];
+	
+	// individuals that go, along the edges leaving the deme (a deme shrunk
+	// by a graph that is not symmetric, or by the demography, sends what it has left)
+	std::size_t left = demeTargets[deme];
+	for (std::size_t edge = graph.getFirstEdge(deme); edge < graph.getFirstEdge(deme + 1); ++edge) {
+		std::size_t n = std::min((std::size_t) graph.getMigrants(edge), left);
+		left -= n;
+		drawFromDeme(deme, (int) n, part);
+		
+		std::size_t slot = firstMigrantSlots[edge];
+		for (auto allele : drawAlleles[part]) {
+			if (counts[allele] > 0) {
+				migrantAlleles[slot] = (unsigned int) allele;
+				migrantCounts[slot] = counts[allele];
+				++slot;
+			}
+		}
+		
+		lastMigrantSlots[edge] = slot;
+	}
+	
+	// individuals that stay
+	drawFromDeme(deme, (int) left, part);
+	std::copy(counts.begin(), counts.end(), nextDemeCounts.begin() + deme * alleles.size());
+}
+
+
+void Simulation::immigrate(std::size_t deme, std::size_t) {
+	const MigrationGraph& graph = *migrationGraph;
+	unsigned int* row = &nextDemeCounts[deme * alleles.size()];
+	
+	for (std::size_t i = graph.getFirstIncomingEdge(deme); i < graph.getFirstIncomingEdge(deme + 1); ++i) {
+		std::size_t edge = graph.getIncomingEdge(i);
+		
+		for (std::size_t slot = firstMigrantSlots[edge]; slot < lastMigrantSlots[edge]; ++slot) {
+			row[migrantAlleles[slot]] += migrantCounts[slot];
 		}
+	}
+	
+	// the sizes only change when a deme receives more or less than it sends
+	subPopulationSizes[deme] = std::accumulate(row, row + alleles.size(), (std::size_t) 0);
+}
+
+
+void Simulation::emigrateToPool(std::size_t deme, std::size_t part) {
+	std::size_t nAlleles = alleles.size();
+	std::vector<unsigned int>& counts = drawCounts[part];
 	
-		// new values for population that stays
-		subPopulations[i] = RandomDist::multinomialByValue(subPopulations[i],(int) subPopulationSizes[i] - gone);
+	// individuals that go to the pool: as many as the deme would send to all the others
+	std::size_t n = std::min((std::size_t) islandMigrants * (subPopulationSizes.size() - 1), demeTargets[deme]);
+	drawFromDeme(deme, (int) n, part);
+	std::copy(counts.begin(), counts.end(), emigrantCounts.begin() + deme * nAlleles);
+	
+	// individuals that stay
+	drawFromDeme(deme, (int) (demeTargets[deme] - n), part);
+	std::copy(counts.begin(), counts.end(), nextDemeCounts.begin() + deme * nAlleles);
+}
+
 
-		exchange.push_back(subExchange);
+void Simulation::immigrateFromPool() {
+	std::size_t nAlleles = alleles.size();
+	std::size_t nDemes = subPopulationSizes.size();
+	
+	std::size_t poolSize = 0;
+	for (std::size_t deme = 0; deme < nDemes; ++deme) {
+		emigrantTotals[deme] = std::accumulate(&emigrantCounts[deme * nAlleles], &emigrantCounts[(deme + 1) * nAlleles], (std::size_t) 0);
+		poolSize += emigrantTotals[deme];
 	}
 	
-	int nAlleles = (int) subPopulations.front().size();
+	buildTree(migrantTree, emigrantCounts);
 	
-	// assign exchanges to target populations
-	for (int i = 0; i < (int) exchange.size(); ++i) {
-		for (int j = 0; j < (int) exchange[i].size(); ++j) {
-			for (int k = 0; k < nAlleles; ++k) {
-				subPopulations[j][k] += exchange[i][j][k];
+	// the demes take their immigrants in turn from what is left of the pool,
+	// one individual at a time, without their own emigrants (as on the complete graph)
+	for (std::size_t deme = 0; deme < nDemes; ++deme) {
+		RandomEngine& engine = demeEngines[deme];
+		unsigned int* row = &nextDemeCounts[deme * nAlleles];
+		std::size_t nOthers = poolSize - emigrantTotals[deme];
+		std::size_t nBefore = sumBefore(migrantTree, deme * nAlleles);
+		
+		// as many as the deme sent (unless the other demes have fewer left)
+		std::size_t n = std::min({ (std::size_t) islandMigrants * (nDemes - 1), demeTargets[deme], nOthers });
+		
+		for (std::size_t k = 0; k < n; ++k, --nOthers) {
+			// a position among the others: the emigrants of the deme are skipped
+			std::size_t position = (std::size_t) RandomDist::uniformIntSingle(0, (int) nOthers - 1, engine);
+			if (position >= nBefore) {
+				position += emigrantTotals[deme];
 			}
+			
+			std::size_t cell = takeFromTree(migrantTree, position);
+			nBefore -= cell < deme * nAlleles;
+			--emigrantCounts[cell];
+			--emigrantTotals[cell / nAlleles];
+			++row[cell % nAlleles];
 		}
-	}	
+		
+		poolSize -= n;
+	}
+	
+	// the emigrants left in the pool found no other deme: they stay in their own
+	for (std::size_t deme = 0; deme < nDemes; ++deme) {
+		unsigned int* row = &nextDemeCounts[deme * nAlleles];
+		for (std::size_t i = 0; i < nAlleles; ++i) {
+			row[i] += emigrantCounts[deme * nAlleles + i];
+		}
+		
+		subPopulationSizes[deme] = std::accumulate(row, row + nAlleles, (std::size_t) 0);
+	}
+}
+
+
+void Simulation::drawFromDeme(std::size_t deme, int n, std::size_t part) {
+	std::size_t nAlleles = alleles.size();
+	std::vector<unsigned int>& counts = drawCounts[part];
+	std::vector<std::size_t>& active = drawAlleles[part];
+	std::copy(demeCounts.begin() + deme * nAlleles, demeCounts.begin() + (deme + 1) * nAlleles, counts.begin());
+	
+	// every allele is listed: the multinomial drops the absent ones, and draws
+	// the others by decreasing count
+	active.resize(nAlleles);
+	std::iota(active.begin(), active.end(), 0);
+	
+	RandomDist::multinomial(counts, n, active, demeEngines[deme]);
 }
 
 
 void Simulation::updateWithSelection() {
-	// genetic drift
-	int nParent = populationSize;
+	// genetic drift, from the parents to the offspring (their sizes differ with a demography)
+	int nParent = (int) std::accumulate(allelesCount.begin(), allelesCount.end(), 0LL);
 	int nOffspring = 0;
 	double nParentCorrection = 0.0;
 
@@ -435,7 +990,7 @@ void Simulation::updateWithSelection() {
 		nParentCorrection -= count * selectionFqs[i];
 		
 		// generate new number of allele copies in population
-        count = (unsigned int) RandomDist::binomial(populationSize - nOffspring, p);
+        count = (unsigned int) RandomDist::binomial(populationSize - nOffspring, p, rng, diffusionThreshold);
 		
 		// increase offspring population size
 		nOffspring += count;
@@ -447,15 +1002,81 @@ void Simulation::updateWithSelection() {
 }
 
 
-void Simulation::bottleneck(int simulationTime) {
-	if (simulationTime == bottleneckStart) {
-		populationSize /= popReduction;
-	} else if (simulationTime == bottleneckEnd) {
-		populationSize *= popReduction;
+void Simulation::resizeDemes(int step) {
+	// every deme keeps its share of the initial population, an empty deme stays empty
+	for (std::size_t i = 0; i < demeTargets.size(); ++i) {
+		if (!demography || subPopulationSizes[i] == 0) {
+			demeTargets[i] = subPopulationSizes[i];
+		} else {
+			unsigned long long size = (unsigned long long) initialDemeSizes[i] * (unsigned long long) demography->getSize(step + 1)
+				/ (unsigned long long) demography->getSize(0);
+			demeTargets[i] = std::max((std::size_t) size, (std::size_t) 1);
+		}
+	}
+	
+	if (isAbsorbed()) {
+		populationSize = 0;
+		for (std::size_t i = 0; i < demeTargets.size(); ++i) {
+			demeCounts[i * alleles.size() + fixedAllele] = (unsigned int) demeTargets[i];
+			subPopulationSizes[i] = demeTargets[i];
+			populationSize += (int) demeTargets[i];
+		}
 	}
 }
 
 
+void Simulation::updateAbsorption(int step) {
+	std::vector<unsigned int> totals;
+	const std::vector<unsigned int>* counts = &allelesCount;
+	
+	// in the migration mode, an allele is lost or fixed in the whole population
+	if (executionMode == _EXECUTION_MODE_MIGRATION_) {
+		totals.assign(alleles.size(), 0);
+		for (std::size_t i = 0; i < demeCounts.size(); ++i) {
+			totals[i % totals.size()] += demeCounts[i];
+		}
+		
+		counts = &totals;
+	}
+	
+	// in the mutation mode, the loss times are by allele and the counts by slot
+	lossTimes.resize(slotAlleles.empty() ? counts->size() : haplotypes.size(), -1);
+	
+	std::size_t nPresent = 0;
+	for (std::size_t i = 0; i < counts->size(); ++i) {
+		int& lossTime = lossTimes[slotAlleles.empty() ? i : slotAlleles[i]];
+		
+		if ((*counts)[i] == 0) {
+			if (lossTime < 0) lossTime = step;
+		} else {
+			// only a mutation can bring an allele back
+			lossTime = -1;
+			fixedAllele = i;
+			++nPresent;
+		}
+	}
+	
+	if (nPresent == 1 && executionMode != _EXECUTION_MODE_MUTATIONS_) {
+		fixationTime = step;
+	}
+}
+
+
+bool Simulation::isAbsorbed() const {
+	return fixationTime >= 0;
+}
+
+
+int Simulation::getFixationTime() const {
+	return fixationTime;
+}
+
+
+const std::vector<int>& Simulation::getLossTimes() const {
+	return lossTimes;
+}
+
+
 size_t Simulation::getPrecision() const {
 	return precision;
 }
@@ -464,7 +1085,44 @@ int Simulation::getPopulationSize() const {
 	return populationSize;
 }
 
-const std::vector< std::vector<unsigned int> >& Simulation::getSubPopulations() const {
+double Simulation::getDiffusionThreshold() const {
+	return diffusionThreshold;
+}
+
+unsigned long long Simulation::getReclaimedSlots() const {
+	return reclaimedSlots;
+}
+
+unsigned long long Simulation::getSkippedDraws() const {
+	return skippedDraws;
+}
+
+unsigned long long Simulation::getMultinomialAlleles() const {
+	return multinomialAlleles;
+}
+
+int Simulation::getExecutionMode() const {
+	return executionMode;
+}
+
+const std::vector<double>& Simulation::getSelectionRates() const {
+	return selectionFqs;
+}
+
+std::shared_ptr<const Demography> Simulation::getDemography() const {
+	return demography;
+}
+
+void Simulation::setDemography(std::shared_ptr<const Demography> d) {
+	demography = d;
+}
+
+std::vector< std::vector<unsigned int> > Simulation::getSubPopulations() const {
+	std::vector< std::vector<unsigned int> > subPopulations;
+	for (auto deme = demeCounts.begin(); deme != demeCounts.end(); deme += alleles.size()) {
+		subPopulations.push_back(std::vector<unsigned int>(deme, deme + alleles.size()));
+	}
+	
 	return subPopulations;
 }
 
@@ -3,7 +3,16 @@
 
 #include <vector>
 #include <array>
+#include <iostream>
+#include <memory>
 #include "Globals.hpp"
+#include "RandomEngine.hpp"
+#include "AliasTable.hpp"
+#include "SparseHaplotypes.hpp"
+#include "MigrationGraph.hpp"
+#include "Demography.hpp"
+
+class ThreadPool;
 
 /** \brief Class representing a Simulation
  *
@@ -64,6 +73,21 @@ public:
 				const std::vector< std::vector<unsigned int> >& migrationRates,
 				bool detailedOutput = false);
 
+
+	/** \brief Simulation constructor
+	 *
+	 * Initialises a new population genetics simulation, with any number of demes.
+	 *
+	 * \param alleles				List of alleles in the population
+	 * \param subPopulations		Number of each allele in every deme (common index with \p alleles)
+	 * \param migrationGraph		Migrations between the demes, shared by the replicates
+	 * \param detailedOutput		Flag for the output format; true will print every subpopulation's frequencies
+	 * */
+	Simulation(const std::vector<std::string>& alleles,
+				const std::vector< std::vector<unsigned int> >& subPopulations,
+				std::shared_ptr<const MigrationGraph> migrationGraph,
+				bool detailedOutput = false);
+
 				
 	/** \brief Simulation constructor
 	 *
@@ -120,6 +144,26 @@ public:
 	std::string getAlleleFqsForOutput() const;
 
 
+	/** \brief Utility function to get the raw allele counts for the output
+	 *
+	 * The counts are in the same order as the frequencies of getAlleleFqsForOutput().
+	 *
+	 * \param counts		the vector to fill with the counts
+	 * */
+	void getAlleleCountsForOutput(std::vector<unsigned int>& counts) const;
+
+
+	/** \brief Get the sizes the counts of getAlleleCountsForOutput() are frequencies of
+	 *
+	 * The size of every deme with the detailed output of the migration mode,
+	 * whose counts are the alleles of every deme in turn, else the size of the
+	 * population.
+	 *
+	 * \param sizes		the vector to fill with the sizes
+	 * */
+	void getColumnSizesForOutput(std::vector<unsigned long long>& sizes) const;
+
+
 	/** \brief Utility function to get and format the allele identifiers
 	 *
 	 * \return A string containing the allele identifiers with the following
@@ -128,6 +172,65 @@ public:
 	std::string getAlleleStrings() const;
 
 
+	/** \brief Format the given allele identifiers as \ref getAlleleStrings does
+	 *
+	 * \param identifiers	the allele identifiers, in the order of the columns
+	 * */
+	std::string getAlleleStrings(const std::vector<std::string>& identifiers) const;
+
+
+	/** \brief Select the random stream of the Simulation
+	 *
+	 * The stream is fully determined by the global seed and the stream index
+	 * (the replicate index), which makes every replicate reproducible
+	 * independently of the thread running it.
+	 *
+	 * \param seed			global seed of the run
+	 * \param stream		index of the stream
+	 * */
+	void setRandomStream(unsigned long long seed, unsigned long long stream);
+
+
+	/** \brief Split the migration steps across a pool of threads
+	 *
+	 * The demes are drawn in parallel, then gather their immigrants in
+	 * parallel. Every deme draws from its own substream of the random
+	 * stream, so the output does not depend on the pool.
+	 *
+	 * \param pool			the pool, which must outlive the Simulation (null for serial steps)
+	 * */
+	void setThreadPool(ThreadPool* pool);
+
+
+	/** \brief Write what evolves during the run: counts, alleles, absorption and random stream
+	 * 
+	 * The parameters are not written: the state is read back by a Simulation
+	 * created with the same ones.
+	 * */
+	void saveState(std::ostream& out) const;
+
+
+	/** \brief Read the state written by \ref saveState
+	 * */
+	void loadState(std::istream& in);
+
+
+	/** \brief Approximate the large binomial draws of the offspring by Gaussian ones
+	 *
+	 * \param threshold		minimal variance of an approximated draw (0: exact sampling)
+	 * */
+	void setDiffusionThreshold(double threshold);
+
+
+	/** \brief Reclaim the slots of the extinct alleles periodically (mutation mode)
+	 *
+	 * The alleles keep their index (and output column) whatever their slot.
+	 *
+	 * \param period		number of steps between two compactions (0: never)
+	 * */
+	void setCompactionPeriod(int period);
+
+
 	/** \brief Update the Simulation by one step
 	 *
 	 * "Creates" a new population of N individuals, choosing the alleles
@@ -137,6 +240,34 @@ public:
 	void update(int t);
 
 	
+	/** \brief Check whether the Simulation reached an absorbing state
+	 *
+	 * A single allele is left in the whole population (in every deme for the
+	 * migration mode), and no mutation can bring another one back: every
+	 * further update leaves the frequencies unchanged.
+	 *
+	 * */
+	bool isAbsorbed() const;
+
+
+	/** \brief Get the step at which an allele fixed
+	 *
+	 * \return The step of the absorption, or -1 if no allele fixed
+	 * */
+	int getFixationTime() const;
+
+
+	/** \brief Get the steps at which the alleles were lost
+	 *
+	 * In the mutation mode an allele can appear again: the step is then the
+	 * last time it was lost, and -1 if it is present at the current step.
+	 *
+	 * \return For every allele (common index with getAlleles()), the step at
+	 * which its count dropped to 0, or -1 if it is still present
+	 * */
+	const std::vector<int>& getLossTimes() const;
+
+
 	/** \brief Get the output precision for the frequencies 
 	 *
 	 * */
@@ -149,10 +280,63 @@ public:
 	int getPopulationSize() const;
 	
 
+	/** \brief Get the number of binomial draws skipped by the multinomials
+	 * 
+	 * Extinct alleles and the alleles left once every offspring was drawn
+	 * need no draw (see RandomDist::multinomial).
+	 * */
+	unsigned long long getSkippedDraws() const;
+
+
+	/** \brief Get the number of alleles covered by the multinomials, skipped or not
+	 * 
+	 * */
+	unsigned long long getMultinomialAlleles() const;
+
+
+	/** \brief Get the minimal variance of the binomial draws approximated by Gaussian ones
+	 * */
+	double getDiffusionThreshold() const;
+
+
+	/** \brief Get the number of slots of extinct alleles reclaimed by the compactions
+	 * */
+	unsigned long long getReclaimedSlots() const;
+
+
+	/** \brief Get the execution mode
+	 * 
+	 * */
+	int getExecutionMode() const;
+
+
+	/** \brief Get the selection rates of the alleles (selection mode)
+	 * 
+	 * */
+	const std::vector<double>& getSelectionRates() const;
+
+
+	/** \brief Get the size of the population at every generation
+	 * 
+	 * \return The demography, null if the size does not change
+	 * */
+	std::shared_ptr<const Demography> getDemography() const;
+
+
+	/** \brief Set the size of the population at every generation
+	 *
+	 * In the migration mode, every deme keeps its share of the initial population.
+	 *
+	 * \param demography		the demography, shared by the replicates (null: the size does not change)
+	 * */
+	void setDemography(std::shared_ptr<const Demography> demography);
+
+
 	/** \brief Get the subpopulations
 	 * 
+	 * \return The number of each allele in every deme
 	 * */
-	const std::vector< std::vector<unsigned int> >& getSubPopulations() const;
+	std::vector< std::vector<unsigned int> > getSubPopulations() const;
 
 
 	/** \brief Get the sizes of the subpopulations
@@ -169,11 +353,50 @@ protected:
 	 * 
 	 * */
 	void calcOutputConstants();
+
+
+	/** \brief Build the identifiers of the new alleles from the haplotypes (mutation mode)
+	 *
+	 * The identifiers are the sequences, or their differences from the
+	 * reference for the sequences longer than _MAX_SEQUENCE_IDENTIFIER_SITES_.
+	 *
+	 * */
+	void syncAlleles() const;
+
+
+	/** \brief Get the count of every allele, by allele index rather than slot
+	 *
+	 * */
+	const std::vector<unsigned int>& getCountsByAllele() const;
+
+
+	/** \brief Drop the slots of the extinct alleles (mutation mode)
+	 *
+	 * The slots left keep their order, and so do the alleles of the
+	 * multinomial: the trajectories do not depend on the compactions.
+	 * The haplotypes of the extinct alleles are freed: an allele brought
+	 * back after that gets its index again.
+	 *
+	 * */
+	void compactAlleles();
 	
 	
+	/** \brief Draw the offspring generation from the current one
+	 * 
+	 * Multinomial over the alleles present, drawn by descending count
+	 * 
+	 * */
+	void sampleOffspring();
+
+
 	/** \brief Generates mutations in the current population
 	 * 
-	 * Mutates nucleotides from the marker sequences depending on model
+	 * Mutates nucleotides from the marker sequences depending on model.
+	 * The (individual, marker) pairs form one index space, walked by
+	 * geometric jumps from one mutation to the next at the largest
+	 * marker rate, each landing kept with the probability of its marker
+	 * relative to that rate: the cost is that of the mutations, not of
+	 * the alleles times the markers.
 	 * 
 	 * */
 	void mutatePopulation();
@@ -181,8 +404,73 @@ protected:
 
 	/** \brief Update the Simulation by one step
 	 *
+	 * Every deme sends multinomial draws of its alleles along the edges of
+	 * the migration graph, and keeps a draw of the size it has left: the
+	 * deme sizes only change if the graph is not symmetric. The
+	 * next generation is built in preallocated storage: no allocation is
+	 * made once the first generation is done.
 	 * */
 	void updateWithMigration();
+
+
+	/** \brief Draw the emigrants of a deme, and the individuals that stay
+	 *
+	 * The emigrants are kept in the slots of their edge, the individuals
+	 * that stay in the row of the deme in \ref nextDemeCounts: the demes
+	 * can be drawn concurrently.
+	 *
+	 * \param deme				index of the deme
+	 * \param part				index of the part of the demes, which owns the scratch space
+	 * */
+	void emigrate(std::size_t deme, std::size_t part);
+
+
+	/** \brief Add the immigrants of a deme to its row in \ref nextDemeCounts
+	 *
+	 * \param deme				index of the deme
+	 * \param part				index of the part of the demes (unused)
+	 * */
+	void immigrate(std::size_t deme, std::size_t part);
+
+
+	/** \brief Draw the emigrants of a deme to the pool of the island model, and the individuals that stay
+	 *
+	 * On a complete graph with a single rate m, a deme sends m (D - 1)
+	 * individuals in a single draw, instead of one draw per edge.
+	 *
+	 * \param deme				index of the deme
+	 * \param part				index of the part of the demes, which owns the scratch space
+	 * */
+	void emigrateToPool(std::size_t deme, std::size_t part);
+
+
+	/** \brief Split the pool of the island model among the demes
+	 *
+	 * The demes take their m (D - 1) immigrants in turn, one at a time and
+	 * without replacement, from the emigrants of the other demes still in
+	 * the pool: every emigrant arrives in a single deme, with its allele,
+	 * and the allele counts leaving the pool are those entering the demes.
+	 * The emigrants that no other deme took stay in their deme. Serial,
+	 * with the stream of each deme: the split does not depend on the
+	 * threads. Costs O(log(D.K)) per migrant.
+	 * */
+	void immigrateFromPool();
+
+
+	/** \brief Run a step of the migration on every deme, split across \ref demePool if any
+	 *
+	 * \param step				the step, called with the deme and the part of the demes it is in
+	 * */
+	void forEachDeme(void (Simulation::*step)(std::size_t, std::size_t));
+
+
+	/** \brief Draw individuals from a deme into the scratch row of a part
+	 *
+	 * \param deme				index of the deme
+	 * \param n					number of individuals to draw
+	 * \param part				index of the part of the demes
+	 * */
+	void drawFromDeme(std::size_t deme, int n, std::size_t part);
 	
 
     /** \brief Update the Simulation by one step
@@ -195,13 +483,21 @@ protected:
 	void updateWithSelection();
 	
 
-	/** \brief Bottleneck effet
+	/** \brief Set the sizes the demes reach at the next generation
 	 *
-	 * Creates a time-dependent population size
-	 * 
-	 * \param the time of the simulation, an int
+	 * Their size, unless the demography changes it; an absorbed replicate
+	 * reaches them at once.
+	 *
+	 * \param step			the step of the current population
+	 * */
+	void resizeDemes(int step);
+
+
+	/** \brief Record the alleles lost or fixed at a step
+	 *
+	 * \param step			the step of the current population
 	 * */
-	void bottleneck(int simulationTime);
+	void updateAbsorption(int step);
 	
 	
 private:
@@ -214,54 +510,170 @@ private:
 	int populationSize;
 
 
-	//!< List of alleles of the current simulation
-	std::vector<std::string> alleles;
+	//!< List of alleles of the current simulation (built on demand in mutation mode)
+	mutable std::vector<std::string> alleles;
 	
 
-	//!< Count of the alleles in the current simulation
+	//!< Count of the alleles in the current simulation (by slot in mutation mode, see \ref slotAlleles)
 	std::vector<unsigned int> allelesCount;
 	
 	
 	//!< List of marker-specifix mutation frequencies
 	std::vector<double> mutationFqs;
+
+
+	//!< Largest of the marker-specific mutation frequencies
+	double maxMutationFq = 0.0;
 	
 
 	//!< Mutation rates for every nucleotide to every nucleotide
 	std::array< std::array<double, Nucl::Nucleotide::N>, Nucl::Nucleotide::N > mutationTable;
+
+
+	//!< Alleles of the current simulation, as differences from a reference sequence (mutation mode)
+	SparseHaplotypes haplotypes;
+
+
+	//!< Alias tables of the mutation targets, per source nucleotide
+	std::array<AliasTable, Nucl::Nucleotide::N> mutationTargets;
+
+
+	//!< Allele (index of \ref haplotypes) counted by every slot of \ref allelesCount (mutation mode)
+	std::vector<std::size_t> slotAlleles;
+
+
+	//!< Slot of every allele, none once extinct and reclaimed (mutation mode)
+	std::vector<std::size_t> alleleSlots;
+
+
+	//!< Number of steps between two compactions of the extinct alleles (0: never)
+	int compactionPeriod = 0;
+
+
+	//!< Number of slots reclaimed by the compactions
+	unsigned long long reclaimedSlots = 0;
+
+
+	//!< Counts by allele index, rebuilt on demand once slots were reclaimed
+	mutable std::vector<unsigned int> allelesCountByIndex;
 	
 	
 	//!< List of selections frequencies of each alleles
 	std::vector<double> selectionFqs;
 	
 	
-	//!< Table containing the sub-populations
-    std::vector< std::vector<unsigned int> > subPopulations;
+	//!< Number of each allele in every deme, one row of alleles per deme
+	std::vector<unsigned int> demeCounts;
+
+
+	//!< Next generation of \ref demeCounts, preallocated
+	std::vector<unsigned int> nextDemeCounts;
+
+
+	//!< Scratch row of the individuals drawn from a deme, for every part of the demes
+	std::vector< std::vector<unsigned int> > drawCounts;
+
+
+	//!< Scratch list of the alleles of the multinomial draws from a deme, for every part of the demes
+	std::vector< std::vector<std::size_t> > drawAlleles;
+
+
+	//!< Index of the first slot of every edge in \ref migrantAlleles (and the number of slots at the end)
+	std::vector<std::size_t> firstMigrantSlots;
+
+
+	//!< Index of the slot after the last one filled by every edge
+	std::vector<std::size_t> lastMigrantSlots;
+
+
+	//!< Alleles of the migrants along the edges, at most as many slots per edge as migrants or alleles
+	std::vector<unsigned int> migrantAlleles;
+
+
+	//!< Number of migrants of the alleles in \ref migrantAlleles
+	std::vector<unsigned int> migrantCounts;
+
+
+	//!< Random stream of every deme, a substream of \ref rng
+	std::vector<RandomEngine> demeEngines;
+
+
+	//!< Pool the migration steps are split across, null for serial steps
+	ThreadPool* demePool = nullptr;
+
+
+	//!< Migrants of every edge of a complete graph with a single rate, which go through a pool (0: the edges are walked)
+	unsigned int islandMigrants = 0;
+
+
+	//!< Emigrants of every deme still in the pool, one row of alleles per deme
+	std::vector<unsigned int> emigrantCounts;
+
+
+	//!< Emigrants still in the pool of every deme
+	std::vector<std::size_t> emigrantTotals;
+
+
+	//!< Fenwick tree over \ref emigrantCounts, to take an individual from the pool in O(log(D.K))
+	std::vector<unsigned int> migrantTree;
     
 
     //!< Table of subpopulation sizes
     std::vector<std::size_t> subPopulationSizes;
     
 
-    //!< Table containing migration rates for each sub group
-    std::vector< std::vector<unsigned int> > migrationRates;
+    //!< Migrations between the demes, shared by the replicates
+    std::shared_ptr<const MigrationGraph> migrationGraph;
     
 
     //!< Flag for detailed output in migration mode
     bool isMigrationDetailedOutput = false;
 	
 	
-	//!< Bottleneck population reduction factor
-	double popReduction;
-	
+	//!< Size of the population at every generation, shared by the replicates (null: constant)
+	std::shared_ptr<const Demography> demography;
+
+
+	//!< Size of every deme at the start of the run, scaled by the demography
+	std::vector<std::size_t> initialDemeSizes;
 
-	//!< Bottleneck start time
-	int bottleneckStart;
-	
 
-	//!< Bottleneck stop time
-	int bottleneckEnd;
+	//!< Size every deme reaches at the next generation
+	std::vector<std::size_t> demeTargets;
 	
 	
+	//!< Step at which each allele was lost (-1 if present)
+	std::vector<int> lossTimes;
+
+
+	//!< Step at which the population reached an absorbing state (-1 if it did not)
+	int fixationTime = -1;
+
+
+	//!< Index of the fixed allele, once absorbed
+	std::size_t fixedAllele = 0;
+
+
+	//!< Alleles taking part in the multinomial, by descending count
+	std::vector<std::size_t> activeAlleles;
+
+
+	//!< Number of binomial draws skipped by the multinomials
+	unsigned long long skippedDraws = 0;
+
+
+	//!< Number of alleles covered by the multinomials
+	unsigned long long multinomialAlleles = 0;
+
+
+	//!< Minimal variance of the binomial draws approximated by Gaussian ones (0: exact)
+	double diffusionThreshold = 0.0;
+
+
+	//!< Random stream of the simulation
+	RandomEngine rng;
+
+
 	//!< Precision for output
 	std::size_t precision;
 	
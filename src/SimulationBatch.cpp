@@ -0,0 +1,347 @@
+#include <cassert>
+#include <cstdint>
+#include "SimulationBatch.hpp"
+#include "FrequencyFormatter.hpp"
+#include "Checkpoint.hpp"
+
+
+template <typename Count>
+SimulationBatch<Count>::SimulationBatch(const Simulation& prototype, const std::vector<unsigned long long>& initialCounts,
+								std::size_t n, unsigned long long seed, unsigned long long firstStream)
+  : executionMode(prototype.getExecutionMode()),
+	nReplicates(n),
+	populationSize(0),
+	alleles(prototype.getAlleles()),
+	alleleStrings(prototype.getAlleleStrings()),
+	selectionFqs(prototype.getSelectionRates()),
+	demography(prototype.getDemography()),
+	counts(alleles.size() * n),
+	rankAlleles(alleles.size() * n),
+	lossTimes(alleles.size() * n),
+	fixationTimes(n, -1),
+	fixedRanks(n, 0),
+	sampler(0, 0.0, prototype.getDiffusionThreshold()),
+	parents(n), offspring(n), corrections(n), probabilities(n), draws(n), nPresent(n),
+	precision(prototype.getPrecision())
+{
+	assert(isSupported(executionMode));
+	assert(nReplicates > 0);
+	assert(initialCounts.size() == alleles.size());
+
+	if (executionMode != _EXECUTION_MODE_SELECTION_) {
+		selectionFqs.assign(alleles.size(), 0.0);
+	}
+
+	for (auto count : initialCounts) {
+		populationSize += (long long) count;
+	}
+
+	// the ranks start in the order of the alleles
+	for (std::size_t a = 0; a < alleles.size(); ++a) {
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			counts[a * nReplicates + r] = (Count) initialCounts[a];
+			rankAlleles[a * nReplicates + r] = a;
+		}
+	}
+
+	for (std::size_t r = 0; r < nReplicates; ++r) {
+		engines.emplace_back(seed, firstStream + r);
+	}
+
+	lossTimes.assign(lossTimes.size(), -1);
+	updateAbsorption(0);
+}
+
+
+template <typename Count>
+void SimulationBatch<Count>::update(int t) {
+	long long parentsSize = populationSize;
+
+	if (demography) {
+		populationSize = demography->getSize(t + 1);
+	}
+
+	if (nAbsorbed < nReplicates) {
+		// the absorbed replicates have no parents left to draw from
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			bool isActive = fixationTimes[r] < 0;
+			parents[r] = isActive ? parentsSize : 0;
+			offspring[r] = isActive ? populationSize : 0;
+			corrections[r] = 0.0;
+		}
+
+		if (executionMode == _EXECUTION_MODE_SELECTION_) {
+			updateWithSelection();
+		} else {
+			sortByCount();
+			sampleOffspring();
+		}
+
+		updateAbsorption(t + 1);
+	}
+
+	// the fixed allele follows the size of the population
+	if (demography && nAbsorbed > 0) {
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			if (fixationTimes[r] >= 0) {
+				counts[fixedRanks[r] * nReplicates + r] = (Count) populationSize;
+			}
+		}
+	}
+}
+
+
+template <typename Count>
+void SimulationBatch<Count>::updateWithSelection() {
+	// selection correction: same summation order as Simulation::updateWithSelection
+	// (the ranks are never sorted in this mode: the rank of an allele is its index)
+	for (std::size_t k = 0; k < alleles.size(); ++k) {
+		const Count* c = &counts[k * nReplicates];
+		double s = selectionFqs[k];
+
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			corrections[r] += c[r] * s;
+		}
+	}
+
+	// conditional binomials, allele by allele
+	for (std::size_t k = 0; k < alleles.size(); ++k) {
+		Count* c = &counts[k * nReplicates];
+		double s = selectionFqs[k];
+
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			double adjustedPopulation = parents[r] + corrections[r];
+			probabilities[r] = adjustedPopulation != 0.0 ? c[r] * (1 + s) / adjustedPopulation : 0.0;
+			corrections[r] -= c[r] * s;
+		}
+
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			draws[r] = parents[r] > 0 ? DRAW : KEEP;
+			parents[r] -= draws[r] == DRAW ? c[r] : 0;
+		}
+
+		drawBinomials(c);
+
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			offspring[r] -= draws[r] == DRAW ? c[r] : 0;
+		}
+	}
+}
+
+
+template <typename Count>
+void SimulationBatch<Count>::sampleOffspring() {
+	// same draws as RandomDist::multinomial: by descending count, the
+	// last allele present takes the offspring left, and once every
+	// offspring is drawn the remaining alleles are lost
+	for (std::size_t k = 0; k < alleles.size(); ++k) {
+		Count* c = &counts[k * nReplicates];
+
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			long long remaining = parents[r] - (long long) c[r];
+			probabilities[r] = parents[r] > 0 ? c[r] * 1.0 / parents[r] : 0.0;
+
+			draws[r] = fixationTimes[r] >= 0 ? KEEP
+				: offspring[r] == 0 ? NONE
+				: remaining == 0 ? REST
+				: DRAW;
+
+			parents[r] = draws[r] == KEEP ? parents[r] : remaining;
+		}
+
+		drawBinomials(c);
+
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			c[r] = draws[r] == NONE ? 0 : draws[r] == REST ? (Count) offspring[r] : c[r];
+			offspring[r] -= draws[r] == KEEP ? 0 : c[r];
+
+			multinomialAlleles += draws[r] != KEEP;
+			skippedDraws += draws[r] == NONE || draws[r] == REST;
+		}
+	}
+}
+
+
+template <typename Count>
+void SimulationBatch<Count>::drawBinomials(Count* c) {
+	// one setup and one draw per replicate: the sampler only keeps its setup
+	// when consecutive replicates have the same parameters
+	for (std::size_t r = 0; r < nReplicates; ++r) {
+		if (draws[r] == DRAW) {
+			sampler.param(offspring[r], probabilities[r]);
+			c[r] = (Count) sampler(engines[r]);
+		}
+	}
+}
+
+
+template <typename Count>
+void SimulationBatch<Count>::sortByCount() {
+	// stable insertion sort of every replicate's ranks by descending count,
+	// the same order as the active alleles of RandomDist::multinomial
+	for (std::size_t r = 0; r < nReplicates; ++r) {
+		if (fixationTimes[r] >= 0) continue;
+
+		for (std::size_t k = 1; k < alleles.size(); ++k) {
+			Count count = counts[k * nReplicates + r];
+			std::size_t allele = rankAlleles[k * nReplicates + r];
+			std::size_t j = k;
+
+			for (; j > 0 && counts[(j - 1) * nReplicates + r] < count; --j) {
+				counts[j * nReplicates + r] = counts[(j - 1) * nReplicates + r];
+				rankAlleles[j * nReplicates + r] = rankAlleles[(j - 1) * nReplicates + r];
+			}
+
+			counts[j * nReplicates + r] = count;
+			rankAlleles[j * nReplicates + r] = allele;
+		}
+	}
+}
+
+
+template <typename Count>
+void SimulationBatch<Count>::updateAbsorption(int step) {
+	nPresent.assign(nReplicates, 0);
+
+	for (std::size_t k = 0; k < alleles.size(); ++k) {
+		const Count* c = &counts[k * nReplicates];
+		const std::size_t* a = &rankAlleles[k * nReplicates];
+
+		for (std::size_t r = 0; r < nReplicates; ++r) {
+			int& loss = lossTimes[a[r] * nReplicates + r];
+
+			if (c[r] == 0) {
+				if (loss < 0) loss = step;
+			} else {
+				loss = -1;
+				fixedRanks[r] = k;
+				++nPresent[r];
+			}
+		}
+	}
+
+	for (std::size_t r = 0; r < nReplicates; ++r) {
+		if (nPresent[r] == 1 && fixationTimes[r] < 0) {
+			fixationTimes[r] = step;
+			++nAbsorbed;
+		}
+	}
+}
+
+
+template <typename Count>
+std::size_t SimulationBatch<Count>::getNbReplicates() const {
+	return nReplicates;
+}
+
+
+template <typename Count>
+unsigned long long SimulationBatch<Count>::getPopulationSize() const {
+	return populationSize;
+}
+
+
+template <typename Count>
+const std::vector<std::string>& SimulationBatch<Count>::getAlleles() const {
+	return alleles;
+}
+
+
+template <typename Count>
+const std::string& SimulationBatch<Count>::getAlleleStrings() const {
+	return alleleStrings;
+}
+
+
+template <typename Count>
+std::string SimulationBatch<Count>::getAlleleFqsForOutput(std::size_t replicate) const {
+	std::vector<unsigned long long> alleleCounts;
+	getAlleleCountsForOutput(replicate, alleleCounts);
+
+	FrequencyFormatter formatter(precision, (unsigned long long) populationSize);
+	std::string out;
+	out.reserve(alleles.size() * (precision + 3));
+
+	for (std::size_t a = 0; a < alleles.size(); ++a) {
+		if (a != 0) out += _OUTPUT_SEPARATOR_;
+		formatter.append(out, alleleCounts[a]);
+	}
+
+	return out;
+}
+
+
+template <typename Count>
+void SimulationBatch<Count>::getAlleleCountsForOutput(std::size_t replicate, std::vector<unsigned long long>& out) const {
+	out.resize(alleles.size());
+
+	for (std::size_t k = 0; k < alleles.size(); ++k) {
+		out[rankAlleles[k * nReplicates + replicate]] = counts[k * nReplicates + replicate];
+	}
+}
+
+
+template <typename Count>
+unsigned long long SimulationBatch<Count>::getSkippedDraws() const {
+	return skippedDraws;
+}
+
+
+template <typename Count>
+unsigned long long SimulationBatch<Count>::getMultinomialAlleles() const {
+	return multinomialAlleles;
+}
+
+
+template <typename Count>
+int SimulationBatch<Count>::getFixationTime(std::size_t replicate) const {
+	return fixationTimes[replicate];
+}
+
+
+template <typename Count>
+std::vector<int> SimulationBatch<Count>::getLossTimes(std::size_t replicate) const {
+	std::vector<int> times(alleles.size());
+
+	for (std::size_t a = 0; a < alleles.size(); ++a) {
+		times[a] = lossTimes[a * nReplicates + replicate];
+	}
+
+	return times;
+}
+
+
+template <typename Count>
+void SimulationBatch<Count>::saveState(std::ostream& out) const {
+	Checkpoint::put(out, populationSize);
+	Checkpoint::put(out, counts);
+	Checkpoint::put(out, rankAlleles);
+	Checkpoint::put(out, lossTimes);
+	Checkpoint::put(out, fixationTimes);
+	Checkpoint::put(out, fixedRanks);
+	Checkpoint::put(out, nAbsorbed);
+	Checkpoint::put(out, skippedDraws);
+	Checkpoint::put(out, multinomialAlleles);
+	Checkpoint::put(out, engines);
+}
+
+
+template <typename Count>
+void SimulationBatch<Count>::loadState(std::istream& in) {
+	Checkpoint::get(in, populationSize);
+	Checkpoint::get(in, counts);
+	Checkpoint::get(in, rankAlleles);
+	Checkpoint::get(in, lossTimes);
+	Checkpoint::get(in, fixationTimes);
+	Checkpoint::get(in, fixedRanks);
+	Checkpoint::get(in, nAbsorbed);
+	Checkpoint::get(in, skippedDraws);
+	Checkpoint::get(in, multinomialAlleles);
+	Checkpoint::get(in, engines);
+}
+
+
+// the count widths chosen by ReplicateBatch::create
+template class SimulationBatch<std::uint16_t>;
+template class SimulationBatch<std::uint32_t>;
+template class SimulationBatch<std::uint64_t>;
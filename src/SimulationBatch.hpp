@@ -0,0 +1,209 @@
+#ifndef SIMULATION_BATCH_H
+#define SIMULATION_BATCH_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Globals.hpp"
+#include "RandomEngine.hpp"
+#include "Binomial.hpp"
+#include "Simulation.hpp"
+#include "Demography.hpp"
+#include "ReplicateBatch.hpp"
+
+
+/** \brief Class advancing a batch of replicates in lockstep
+ *
+ * The allele counts of the B replicates of the batch are stored as one
+ * contiguous rank x replicate matrix (structure of arrays): a step draws
+ * the multinomial of every replicate rank by rank, so that the
+ * conditional probabilities, the selection correction and the bookkeeping
+ * are computed by simple loops over contiguous replicates, which the
+ * compiler vectorizes. Outside of the selection mode, the alleles of every
+ * replicate are kept sorted by descending count, as in
+ * RandomDist::multinomial: the rank of an allele differs between
+ * replicates. Only the binomial draws remain per replicate, each with the
+ * parameters of its replicate; the setup of the sampler is only skipped
+ * when consecutive replicates have the same parameters (grouping them
+ * costs more than it saves, since the replicates diverge within a few
+ * generations).
+ *
+ * Every replicate draws from its own stream, exactly as a \ref Simulation
+ * would: the results are identical to running the replicates one by one.
+ * Supports the modes without mutations or migrations (neutral, selection
+ * and bottleneck), under any demography.
+ *
+ * \tparam Count			unsigned type of the allele counts (uint16_t, uint32_t or uint64_t)
+ *
+ * */
+template <typename Count>
+class SimulationBatch : public ReplicateBatch {
+
+public:
+
+	/** \brief SimulationBatch constructor
+	 *
+	 * \param prototype			parameters shared by every replicate (its counts are ignored)
+	 * \param initialCounts		initial allele counts of every replicate
+	 * \param nReplicates		number of replicates in the batch
+	 * \param seed				global seed of the run
+	 * \param firstStream		stream (replicate index) of the first replicate of the batch
+	 * */
+	SimulationBatch(const Simulation& prototype, const std::vector<unsigned long long>& initialCounts,
+					std::size_t nReplicates, unsigned long long seed, unsigned long long firstStream);
+
+
+	void update(int t) override;
+
+
+	std::size_t getNbReplicates() const override;
+
+
+	unsigned long long getPopulationSize() const override;
+
+
+	const std::vector<std::string>& getAlleles() const override;
+
+
+	const std::string& getAlleleStrings() const override;
+
+
+	std::string getAlleleFqsForOutput(std::size_t replicate) const override;
+
+
+	void getAlleleCountsForOutput(std::size_t replicate, std::vector<unsigned long long>& counts) const override;
+
+
+	unsigned long long getSkippedDraws() const override;
+
+
+	unsigned long long getMultinomialAlleles() const override;
+
+
+	int getFixationTime(std::size_t replicate) const override;
+
+
+	std::vector<int> getLossTimes(std::size_t replicate) const override;
+
+
+	void saveState(std::ostream& out) const override;
+
+
+	void loadState(std::istream& in) override;
+
+private:
+
+	//!< What a step does to the count of a replicate at a rank
+	enum Draw : unsigned char {
+		KEEP,	//!< nothing (absorbed replicate)
+		NONE,	//!< no offspring left: the allele is lost
+		REST,	//!< last allele present: it takes the offspring left
+		DRAW	//!< binomial draw
+	};
+
+
+	//!< Draw the offspring with selection, in the order of the alleles
+	void updateWithSelection();
+
+
+	//!< Draw the offspring, by descending count
+	void sampleOffspring();
+
+
+	//!< Binomial draws of the replicates marked \ref DRAW, at one rank
+	void drawBinomials(Count* c);
+
+
+	//!< Sort the ranks of every replicate by descending count
+	void sortByCount();
+
+
+	/** \brief Record the alleles lost or fixed at a step
+	 *
+	 * \param step			the step of the current population
+	 * */
+	void updateAbsorption(int step);
+
+
+	//!< Execution mode
+	int executionMode;
+
+
+	//!< Number of replicates of the batch
+	std::size_t nReplicates = 0;
+
+
+	//!< Size of the population of every replicate
+	long long populationSize;
+
+
+	//!< Alleles of the population
+	std::vector<std::string> alleles;
+
+
+	//!< Formatted allele identifiers
+	std::string alleleStrings;
+
+
+	//!< Selection rates of each allele (0 outside of the selection mode)
+	std::vector<double> selectionFqs;
+
+
+	//!< Size of the population at every generation (null: constant)
+	std::shared_ptr<const Demography> demography;
+
+
+	//!< Allele counts, indexed by [rank * nReplicates + replicate]
+	std::vector<Count> counts;
+
+
+	//!< Allele at each rank, indexed as \ref counts
+	std::vector<std::size_t> rankAlleles;
+
+
+	//!< Steps at which the alleles were lost, indexed by [allele * nReplicates + replicate]
+	std::vector<int> lossTimes;
+
+
+	//!< Step at which each replicate reached an absorbing state (-1 if it did not)
+	std::vector<int> fixationTimes;
+
+
+	//!< Rank of the fixed allele of each absorbed replicate
+	std::vector<std::size_t> fixedRanks;
+
+
+	//!< Number of absorbed replicates
+	std::size_t nAbsorbed = 0;
+
+
+	//!< Number of binomial draws skipped by the multinomials
+	unsigned long long skippedDraws = 0;
+
+
+	//!< Number of alleles covered by the multinomials
+	unsigned long long multinomialAlleles = 0;
+
+
+	//!< Random stream of each replicate
+	std::vector<RandomEngine> engines;
+
+
+	//!< Binomial sampler, set up again only when the parameters change
+	Binomial sampler;
+
+
+	//!< Scratch space of a step, one entry per replicate
+	std::vector<long long> parents;
+	std::vector<long long> offspring;
+	std::vector<double> corrections;
+	std::vector<double> probabilities;
+	std::vector<Draw> draws;
+	std::vector<unsigned int> nPresent;
+
+
+	//!< Precision for output
+	std::size_t precision;
+};
+
+#endif
@@ -1,19 +1,62 @@
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <iomanip>
+#include <numeric>
 #include <sstream>
-#include <thread>
 #include <ctime>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "SimulationsExecutor.hpp"
 #include "Random.hpp"
+#include "FrequencyFormatter.hpp"
+#include "ShardMerger.hpp"
+
 
+namespace {
+	// cut an output file to the size it had at a checkpoint
+	bool cutOutput(const std::string& fileName, std::uint64_t size) {
+		struct stat info;
+		if (stat(fileName.c_str(), &info) != 0 || (std::uint64_t) info.st_size < size) return false;
+
+		return truncate(fileName.c_str(), (off_t) size) == 0;
+	}
+}
 
-SimulationsExecutor::SimulationsExecutor(std::string input, std::string fasta)
-  : data(input, fasta)
+
+SimulationsExecutor::SimulationsExecutor(std::string input, std::string fasta, bool resume, int shard, int nShards)
+  : SimulationsExecutor(Data(input, fasta), resume, shard, nShards)
+{}
+
+
+SimulationsExecutor::SimulationsExecutor(const Data& params, bool resume, int shardIdx, int shardCount,
+										 std::shared_ptr<ThreadPool> sharedPool, const std::string& tag)
+  : data(params), shard(shardIdx), nShards(shardCount), firstReplicate(0), nReplicates(data.getNbReplicates()),
+	outputTag(tag), isResumed(resume), seed(data.getSeed()), outputQueue(_OUTPUT_QUEUE_CAPACITY_), pool(sharedPool)
 {
-	int allelesCountSum = 0;
+	// a shard runs a contiguous slice of the replicates, on the streams they have in the whole run
+	if (nShards != 0) {
+		if (shard < 0 || shard >= nShards || nShards > data.getNbReplicates() || !data.getIsSeeded()) {
+			std::cerr << _ERROR_SHARD_INVALID_MSG_ << std::endl;
+			exit(_ERROR_SHARD_INVALID_CODE_);
+		}
+
+		if (data.getIsStatisticsOutput() || data.getExecutionMode() == _EXECUTION_MODE_MUTATIONS_ || !data.getSweptLines().empty()) {
+			std::cerr << _ERROR_SHARD_UNSUPPORTED_MSG_ << std::endl;
+			exit(_ERROR_SHARD_UNSUPPORTED_CODE_);
+		}
+
+		firstReplicate = (int) ((long long) shard * data.getNbReplicates() / nShards);
+		nReplicates = (int) ((long long) (shard + 1) * data.getNbReplicates() / nShards) - firstReplicate;
+
+		std::cout << "Running replicates " << firstReplicate << " to " << firstReplicate + nReplicates - 1
+				  << " (shard " << shard << " of " << nShards << ")" << std::endl;
+	}
+
+	long long allelesCountSum = 0;
 	for (auto& alleleCount : data.getAllelesCount())
-		allelesCountSum += alleleCount;
+		allelesCountSum += (long long) alleleCount;
 
 	assert(data.getPopulationSize() == allelesCountSum);
 
@@ -30,173 +73,850 @@ SimulationsExecutor::SimulationsExecutor(std::string input, std::string fasta)
 		default:
 			break;
 	}
-	    
-    // init number of threads
-    nThreads = std::thread::hardware_concurrency();
-    if (nThreads == 0) {
-		nThreads = 4;
-		std::cout << "No hardware info detected, running on 4 threads" << std::endl;
+
+	// the points of a sweep share the threads of the sweep
+	if (!pool) {
+		pool = createPool(data.getNbThreads());
+	}
+
+	poolReplicates = nReplicates;
+}
+
+
+std::shared_ptr<ThreadPool> SimulationsExecutor::createPool(int nRequested) {
+	// init number of threads
+	unsigned int nThreads = (unsigned int) nRequested;
+	if (nThreads > 0) {
+		std::cout << "Running on " << nThreads << " threads as requested" << std::endl;
 	} else {
-		std::cout << "Running on " << nThreads << " threads by system recommandation" << std::endl;
+		nThreads = ThreadPool::getAvailableConcurrency();
+		if (nThreads == 0) {
+			nThreads = 4;
+			std::cout << "No hardware info detected, running on 4 threads" << std::endl;
+		} else {
+			std::cout << "Running on " << nThreads << " threads by system recommandation" << std::endl;
+		}
 	}
-	
-	// output vals
-	outputVals = std::vector< std::vector<std::string> >(
-            (unsigned long) (data.getNbGenerations() + 2),
-			std::vector<std::string>((unsigned long) data.getNbReplicates())
-	);
+
+	return std::make_shared<ThreadPool>(nThreads);
 }
 
 
 void SimulationsExecutor::execute() {
+	start();
+
+	while (submitBlock()) {
+		// wait for every batch to end the block, then hand it to the writer
+		// (waits if the writer is too far behind, which bounds the memory used)
+		pool->wait();
+		endBlock();
+	}
+
+	finish();
+}
+
+
+void SimulationsExecutor::start() {
 	// chrono
-	time_t t1 = time(0);
-	
-	// create simulation partition
-	std::vector<int> nbSimulations(nThreads, data.getNbReplicates() / nThreads);
-	
-	// assign remaining simulations
-	int rest = data.getNbReplicates() % nThreads;
-	while (rest > 0) {
-		++nbSimulations[rest];
-		--rest;
+	startTime = time(0);
+
+	batchSize = data.getBatchSize();
+	withStatistics = data.getIsStatisticsOutput();
+	isLockstep = data.getIsLockstep() && ReplicateBatch::isSupported(data.getExecutionMode());
+
+	// with mutations, the columns are only known once every replicate has found its
+	// alleles: the blocks are written as raw counts, formatted over the columns at the end
+	isAligned = data.getExecutionMode() == _EXECUTION_MODE_MUTATIONS_;
+	const std::vector<int>& recorded = data.getRecordedGenerations();
+	blockSize = data.getOutputBlockSize();
+
+	if (isAligned) {
+		alleleDictionary = std::unique_ptr<AlleleDictionary>(new AlleleDictionary(_ALLELE_DICTIONARY_BUCKETS_));
+		alleleColumns.assign((std::size_t) nReplicates, std::vector<std::size_t>());
+	} else {
+		alleleDictionary.reset();
+		alleleColumns.clear();
 	}
-	
-	// create correct number of threads
-	std::vector<std::thread> threads(nThreads);
-
-	// init each thread
-	int minSimulationIdx = 0;
-	for (size_t i = 0; i < nThreads; ++i) {
-		threads[i] = std::thread([=] {
-			runSimulation(nbSimulations[i], minSimulationIdx);
-		});
-		
-		minSimulationIdx += nbSimulations[i];
+
+	// a lockstep batch is only efficient with enough replicates
+	if (isLockstep) {
+		batchSize = std::max(batchSize, std::min(_LOCKSTEP_MIN_BATCH_SIZE_, (nReplicates + _LOCKSTEP_MIN_BATCHES_ - 1) / _LOCKSTEP_MIN_BATCHES_));
 	}
 
-	// join threads (wait for every thread to end before ending main thread)
-	for (auto& th : threads) th.join();
-	
-	// write data to ouput file
-	writeData();
+	// every batch has its own statistics accumulator: their number is bounded by
+	// making the batches larger. The batches only depend on the number of replicates,
+	// so merging their accumulators in order gives the same results on any number of threads
+	if (withStatistics) {
+		batchSize = std::max(batchSize, (nReplicates + _STATISTICS_MAX_ACCUMULATORS_ - 1) / _STATISTICS_MAX_ACCUMULATORS_);
+	}
+	nBatches = (nReplicates + batchSize - 1) / batchSize;
+
+	// the simulations are created by their batch, on the first step
+	if (isLockstep) {
+		simulations.clear();
+		batches.clear();
+		batches.resize((std::size_t) nBatches);
+	} else {
+		batches.clear();
+		simulations = std::vector<Simulation>((std::size_t) nReplicates);
+	}
+
+	checkpointPeriod = data.getCheckpointPeriod();
+
+	// a resumed run starts with the first line after its checkpoint
+	resumed.reset();
+	firstResumedLine = 0;
+	if (isResumed && loadCheckpoint(batchSize, isLockstep)) {
+		firstResumedLine = (int) (std::upper_bound(recorded.begin(), recorded.end(), (int) resumed->generation) - recorded.begin());
+
+		// the alleles of the resumed replicates take their place in the dictionary again
+		if (alleleDictionary) {
+			for (int i = 0; i < nReplicates; ++i) {
+				alignAlleles(i);
+			}
+		}
+	}
+
+	nextLine = firstResumedLine;
+	nextCheckpoint = (resumed ? (int) resumed->generation : 0) + checkpointPeriod;
+
+	// the writer thread writes the finished blocks while the next ones are simulated
+	writer = std::thread(&SimulationsExecutor::writeData, this);
+}
+
+
+bool SimulationsExecutor::submitBlock() {
+	const std::vector<int>& recorded = data.getRecordedGenerations();
+	int nRecorded = (int) recorded.size();
+	if (nextLine >= nRecorded) return false;
+
+	// a block holds blockSize recorded steps, and simulates every step up to its last one
+	int firstLine = nextLine;
+	int nSteps = std::min(blockSize, nRecorded - firstLine);
+	int firstStep = firstLine == 0 ? 0 : recorded[firstLine - 1] + 1;
+	std::vector<int> generations(recorded.begin() + firstLine, recorded.begin() + firstLine + nSteps);
+	nextLine += nSteps;
+
+	// a checkpoint ends the block past its period, and the run (so that it can be extended)
+	if (resumed && firstLine == firstResumedLine) {
+		firstStep = (int) resumed->generation + 1;
+	}
+
+	block = std::unique_ptr<OutputBlock>(new OutputBlock(firstStep, generations, nReplicates, !withStatistics && !isAligned, data.getIsBinaryOutput() || isAligned));
+	OutputBlock* blockPtr = block.get();
+
+	if (checkpointPeriod > 0 && (generations.back() >= nextCheckpoint || firstLine + nSteps == nRecorded)) {
+		block->states.resize((std::size_t) nBatches);
+		nextCheckpoint = generations.back() + checkpointPeriod;
+	}
+
+	// the statistics of the mutation mode are computed over the columns, at the end
+	batchStatistics.clear();
+	if (withStatistics && !isAligned) {
+		batchStatistics.assign((std::size_t) nBatches, ReplicateStatistics((std::size_t) nSteps, (std::size_t) data.getStatisticsBins()));
+	}
+
+	// schedule the replicates in small batches: a batch always covers the same
+	// replicates (and output slots), whichever worker ends up running it
+	for (int batch = 0; batch < nBatches; ++batch) {
+		int first = batch * batchSize;
+		int nSimulations = std::min(batchSize, nReplicates - first);
+		ReplicateStatistics* statistics = batchStatistics.empty() ? nullptr : &batchStatistics[batch];
+		std::string* state = block->states.empty() ? nullptr : &block->states[batch];
+
+		if (isLockstep) {
+			pool->submit([=] {
+				runBatch(*blockPtr, batch, nSimulations, first, statistics, state);
+			});
+		} else {
+			pool->submit([=] {
+				runSimulation(*blockPtr, nSimulations, first, statistics, state);
+			});
+		}
+	}
+
+	return true;
+}
+
+
+void SimulationsExecutor::endBlock() {
+	if (!batchStatistics.empty()) {
+		block->statistics = ReplicateStatistics(block->generations.size(), (std::size_t) data.getStatisticsBins());
+		for (auto& statistics : batchStatistics) {
+			block->statistics.merge(statistics);
+		}
+	}
+
+	outputQueue.push(std::move(block));
+}
+
+
+void SimulationsExecutor::finish() {
+	int T = data.getNbGenerations();
+
+	// write final line: allele identifiers
+	// (in mutation mode, the binary output only takes the alleles: the text is written from the columns)
+	std::unique_ptr<OutputBlock> identifiers(new OutputBlock(T + 1, std::vector<int>(1, T + 1), nReplicates));
+	for (auto& simul : simulations) {
+		if (!alleleDictionary) {
+			identifiers->steps.front()[identifiers->alleles.size()] = simul.getAlleleStrings();
+		}
+
+		identifiers->alleles.push_back(simul.getAlleles());
+	}
+	for (auto& batch : batches) {
+		for (std::size_t r = 0; r < batch->getNbReplicates(); ++r) {
+			identifiers->steps.front()[identifiers->alleles.size()] = batch->getAlleleStrings();
+			identifiers->alleles.push_back(batch->getAlleles());
+		}
+	}
+	outputQueue.push(std::move(identifiers));
+
+	// an empty block ends the output
+	outputQueue.push(std::unique_ptr<OutputBlock>());
+	writer.join();
+
+	if (alleleDictionary) {
+		writeAlignedData();
+	}
+
+	writeAbsorptionTimes();
+
+	// binomial draws saved by the multinomials skipping the extinct alleles
+	unsigned long long skippedDraws = 0, multinomialAlleles = 0, reclaimedSlots = 0;
+	for (auto& simul : simulations) {
+		skippedDraws += simul.getSkippedDraws();
+		multinomialAlleles += simul.getMultinomialAlleles();
+		reclaimedSlots += simul.getReclaimedSlots();
+	}
+	for (auto& batch : batches) {
+		skippedDraws += batch->getSkippedDraws();
+		multinomialAlleles += batch->getMultinomialAlleles();
+	}
+
+	if (multinomialAlleles > 0) {
+		std::cout << "Multinomials: " << skippedDraws << " of " << multinomialAlleles
+				  << " binomial draws skipped (" << std::setprecision(1) << std::fixed
+				  << skippedDraws * 100.0 / multinomialAlleles << " %)" << std::endl;
+	}
+
+	// slots of extinct alleles dropped by the compactions (mutation mode)
+	if (reclaimedSlots > 0) {
+		std::cout << "Compactions: " << reclaimedSlots << " extinct allele slots reclaimed" << std::endl;
+	}
 
 	// get end of the simulation
 	time_t t2 = time(0);
 
-	std::cout << "[done in " << t2 - t1 << " s]" << std::endl;
+	std::cout << "[done in " << t2 - startTime << " s]" << std::endl;
+}
+
+
+void SimulationsExecutor::setPoolReplicates(int n) {
+	poolReplicates = n;
 }
 
 
-Simulation SimulationsExecutor::createSimulation() const {
+Simulation SimulationsExecutor::createSimulation(const std::vector<unsigned int>& allelesCount) const {
+	Simulation simul;
+
 	switch (data.getExecutionMode()) {
 		case _EXECUTION_MODE_MUTATIONS_:
-			return Simulation(data.getAlleles(), data.getAllelesCount(), data.getMutationRates(), nuclMutationProbs);
+			simul = Simulation(data.getAlleles(), allelesCount, data.getMutationRates(), nuclMutationProbs);
+			break;
 
 		case _EXECUTION_MODE_MIGRATION_:
-			return Simulation(data.getAlleles(), subPopulations, migrationRates, data.getIsDetailedOutput());
+			simul = Simulation(data.getAlleles(), subPopulations, migrationGraph, data.getIsDetailedOutput());
+
+			// too few replicates for the threads: every replicate splits its demes across them
+			if (poolReplicates < (int) pool->getNbThreads() && subPopulations.size() >= _MIGRATION_PARALLEL_MIN_DEMES_) {
+				simul.setThreadPool(pool.get());
+			}
+			break;
 			
 		case _EXECUTION_MODE_SELECTION_:
-			return Simulation(data.getAlleles(), data.getAllelesCount(), data.getSelections());
+			simul = Simulation(data.getAlleles(), allelesCount, data.getSelections());
+			break;
 
 		case _EXECUTION_MODE_BOTTLENECK_:
-			return Simulation(data.getAlleles(), data.getAllelesCount(), 
+			simul = Simulation(data.getAlleles(), allelesCount, 
 				data.getBottleneckStart(), data.getBottleneckEnd(), data.getPopReduction());
+			break;
 
 		case _EXECUTION_MODE_NONE_:
 		default:
-			return Simulation(data.getAlleles(), data.getAllelesCount());
+			simul = Simulation(data.getAlleles(), allelesCount);
+			break;
 	}
+
+	// the table of the sizes is built once, from the size of the whole population
+	simul.setDemography(data.getDemography());
+	simul.setDiffusionThreshold(data.getDiffusionThreshold());
+	simul.setCompactionPeriod(data.getCompactionPeriod());
+	return simul;
 }
 
 
-void SimulationsExecutor::runSimulation(int nSimulations, int firstSimulationIdx) {
-	if (nSimulations == 0) return;
-	
-	// generate container for states of simulation
-	int T = data.getNbGenerations();
-	
-	for (int i = firstSimulationIdx; i < nSimulations + firstSimulationIdx; ++i) {
-		// create new simulation
-		Simulation simul = createSimulation();		
+std::unique_ptr<ReplicateBatch> SimulationsExecutor::createBatch(int nSimulations, int firstSimulationIdx) const {
+	// every replicate draws from its own stream, as in runSimulation. The prototype only
+	// carries the parameters: the counts may not fit the ints of a Simulation
+	Simulation prototype = createSimulation(std::vector<unsigned int>(data.getNbAlleles(), 1));
+
+	return ReplicateBatch::create(prototype, data.getAllelesCount(), data.getMaxPopulationSize(),
+								  (std::size_t) nSimulations, seed, (unsigned long long) (firstReplicate + firstSimulationIdx));
+}
 
-		// write initial allele frequencies
-		outputVals[0][i] = simul.getAlleleFqsForOutput();
 
-		int t = 0;
-		while (t < T) {
-			// update simulation
-			simul.update(t);
+bool SimulationsExecutor::loadCheckpoint(int batchSize, bool isLockstep) {
+	std::unique_ptr<Checkpoint> checkpoint(new Checkpoint());
+	if (!checkpoint->load(getOutputFileName(_OUTPUT_CHECKPOINT_FILE_))) {
+		std::cerr << "Error: no checkpoint to resume from, starting a new run." << std::endl;
+		return false;
+	}
+
+	int nBatches = (nReplicates + batchSize - 1) / batchSize;
+
+	// the output files are cut where the checkpoint was taken
+	bool isConsistent = checkpoint->isCompatible(data.getParameters())
+		&& checkpoint->generation <= data.getNbGenerations()
+		&& checkpoint->states.size() == (std::size_t) nBatches
+		&& cutOutput(getTextFileName(), checkpoint->resultsSize)
+		&& (!data.getIsBinaryOutput() || cutOutput(getOutputFileName(_OUTPUT_BINARY_FILE_), checkpoint->binarySize));
+
+	if (!isConsistent) {
+		std::cerr << _ERROR_CHECKPOINT_INCOMPATIBLE_MSG_ << std::endl;
+		exit(_ERROR_CHECKPOINT_INCOMPATIBLE_CODE_);
+	}
 
-			// increment clock
-			++t;
+	seed = checkpoint->seed;
 
-			// write allele frequencies
-			outputVals[t][i] = simul.getAlleleFqsForOutput();
+	for (int batch = 0; batch < nBatches; ++batch) {
+		int first = batch * batchSize;
+		int nSimulations = std::min(batchSize, nReplicates - first);
+		std::istringstream in(checkpoint->states[batch], std::istringstream::binary);
+
+		if (isLockstep) {
+			batches[batch] = createBatch(nSimulations, first);
+			batches[batch]->loadState(in);
+		} else {
+			for (int i = first; i < first + nSimulations; ++i) {
+				simulations[i] = createSimulation(std::vector<unsigned int>(data.getAllelesCount().begin(), data.getAllelesCount().end()));
+				simulations[i].loadState(in);
+			}
 		}
 
-		// write final line: allele identifiers
-		outputVals[t + 1][i] = simul.getAlleleStrings();
+		if (!in) {
+			std::cerr << _ERROR_CHECKPOINT_INCOMPATIBLE_MSG_ << std::endl;
+			exit(_ERROR_CHECKPOINT_INCOMPATIBLE_CODE_);
+		}
+	}
 
-		// properly format output (add blanks if there were new mutations
-		if (data.getExecutionMode() == _EXECUTION_MODE_MUTATIONS_) {
-			size_t lineLength = simul.getAlleleStrings().size();
-			size_t precision = simul.getPrecision();
+	// the writer thread only needs the state of the output
+	checkpoint->states.clear();
+	resumed = std::move(checkpoint);
 
-			if (outputVals.front()[i].size() != outputVals.back()[i].size()) { // check for any mutations
-				for (size_t j = 0; j < outputVals.size(); ++j) {
-					auto& state = outputVals[j][i];
-					
-					if (state.size() < lineLength) {
-						std::stringstream ss;
-						ss << state;
+	std::cout << "Resuming from the checkpoint of generation " << resumed->generation << std::endl;
+	return true;
+}
 
-						// add additional zeroes to end of line
-						while (ss.tellp() < (int) lineLength) {
-							ss << _OUTPUT_SEPARATOR_ << std::setprecision((int) precision) << std::fixed << 0.0;
-						}
 
-						state = ss.str();
-					}
+void SimulationsExecutor::runSimulation(OutputBlock& block, int nSimulations, int firstSimulationIdx,
+										ReplicateStatistics* statistics, std::string* state) {
+	std::vector<unsigned int> counts;
+	std::vector<unsigned long long> sizes;
+
+	for (int i = firstSimulationIdx; i < nSimulations + firstSimulationIdx; ++i) {
+		Simulation& simul = simulations[i];
+
+		int t = block.firstStep;
+		for (size_t j = 0; j < block.steps.size(); ++j) {
+			// once absorbed, the replicate no longer evolves: its frequencies are
+			// not formatted again, the writer repeats its last line instead
+			bool isRepeated = t != 0 && simul.isAbsorbed();
+
+			// the steps that are not recorded are only simulated
+			for (; t <= block.generations[j]; ++t) {
+				if (t == 0) {
+					// create new simulation, drawing from the replicate's own stream
+					simul = createSimulation(std::vector<unsigned int>(data.getAllelesCount().begin(), data.getAllelesCount().end()));
+					simul.setRandomStream(seed, (unsigned long long) (firstReplicate + i));
+				} else {
+					// update simulation
+					simul.update(t - 1);
 				}
 			}
+
+			// write allele frequencies (in mutation mode, once the columns are known)
+			if (!block.steps[j].empty() && !isRepeated) {
+				block.steps[j][i] = simul.getAlleleFqsForOutput();
+			}
+
+			if (!block.counts.empty()) {
+				simul.getAlleleCountsForOutput(block.counts[j][i]);
+			}
+
+			// the alleles found so far get their place in the dictionary
+			if (alleleDictionary) {
+				alignAlleles(i);
+			}
+
+			if (statistics) {
+				// the columns of the demes are frequencies within their deme
+				simul.getAlleleCountsForOutput(counts);
+				simul.getColumnSizesForOutput(sizes);
+				statistics->add(j, counts, sizes);
+			}
+
+			// the population size does not depend on the replicate
+			if (i == 0) {
+				block.populationSizes[j] = (unsigned long long) simul.getPopulationSize();
+			}
 		}
 	}
+
+	// serialized by the worker, written to the disk by the writer thread
+	if (state) {
+		std::ostringstream out(std::ostringstream::binary);
+		for (int i = firstSimulationIdx; i < nSimulations + firstSimulationIdx; ++i) {
+			simulations[i].saveState(out);
+		}
+
+		*state = out.str();
+	}
+}
+
+
+void SimulationsExecutor::runBatch(OutputBlock& block, int batchIdx, int nSimulations, int firstSimulationIdx,
+								   ReplicateStatistics* statistics, std::string* state) {
+	std::unique_ptr<ReplicateBatch>& batchPtr = batches[batchIdx];
+	std::vector<unsigned long long> counts;
+
+	int t = block.firstStep;
+	for (size_t j = 0; j < block.steps.size(); ++j) {
+		// first step after the previous line
+		int first = t;
+
+		// the steps that are not recorded are only simulated
+		for (; t <= block.generations[j]; ++t) {
+			if (t == 0) {
+				batchPtr = createBatch(nSimulations, firstSimulationIdx);
+			} else {
+				batchPtr->update(t - 1);
+			}
+		}
+
+		ReplicateBatch& batch = *batchPtr;
+
+		for (int r = 0; r < nSimulations; ++r) {
+			int i = firstSimulationIdx + r;
+
+			// replicates absorbed by the previous line are repeated by the writer
+			int fixationTime = batch.getFixationTime((std::size_t) r);
+			bool isRepeated = fixationTime >= 0 && fixationTime < first;
+
+			if (!block.steps[j].empty() && !isRepeated) {
+				block.steps[j][i] = batch.getAlleleFqsForOutput((std::size_t) r);
+			}
+
+			if (!block.counts.empty() || statistics) {
+				batch.getAlleleCountsForOutput((std::size_t) r, counts);
+			}
+
+			// the binary output is only written for counts that fit its 32-bit columns
+			if (!block.counts.empty()) {
+				block.counts[j][i].assign(counts.begin(), counts.end());
+			}
+
+			if (statistics) {
+				statistics->add(j, counts, batch.getPopulationSize());
+			}
+		}
+
+		// the population size does not depend on the replicate
+		if (firstSimulationIdx == 0) {
+			block.populationSizes[j] = batch.getPopulationSize();
+		}
+	}
+
+	// serialized by the worker, written to the disk by the writer thread
+	if (state) {
+		std::ostringstream out(std::ostringstream::binary);
+		batchPtr->saveState(out);
+
+		*state = out.str();
+	}
+}
+
+
+void SimulationsExecutor::alignAlleles(int simulationIdx) {
+	const std::vector<std::string>& alleles = simulations[simulationIdx].getAlleles();
+	std::vector<std::size_t>& columns = alleleColumns[simulationIdx];
+
+	// an allele keeps its index in the replicate: only the new ones are added
+	for (std::size_t a = columns.size(); a < alleles.size(); ++a) {
+		columns.push_back(alleleDictionary->add(alleles[a], (std::size_t) simulationIdx, a));
+	}
+}
+
+
+void SimulationsExecutor::formatAlignedFqs(OutputBlock& block, int nSimulations, int firstSimulationIdx,
+										   ReplicateStatistics* statistics) {
+	std::size_t nColumns = alleleDictionary->getAlleles().size();
+	std::vector<unsigned int> row;
+
+	for (int i = firstSimulationIdx; i < nSimulations + firstSimulationIdx; ++i) {
+		const Simulation& simul = simulations[i];
+		const std::vector<std::size_t>& columns = alleleColumns[i];
+
+		for (std::size_t j = 0; j < block.generations.size(); ++j) {
+			const std::vector<unsigned int>& counts = block.counts[j][i];
+
+			// the alleles not found yet (or by another replicate) have a count of 0
+			row.assign(nColumns, 0);
+			for (std::size_t a = 0; a < counts.size(); ++a) {
+				row[columns[a]] = counts[a];
+			}
+
+			if (statistics) {
+				statistics->add(j, row, block.populationSizes[j]);
+				continue;
+			}
+
+			// the size of the population changes with the demography
+			FrequencyFormatter formatter(simul.getPrecision(), block.populationSizes[j]);
+			std::string& out = block.steps[j][i];
+			out.reserve(nColumns * (simul.getPrecision() + 3));
+
+			for (std::size_t c = 0; c < nColumns; ++c) {
+				if (c != 0) out += _OUTPUT_SEPARATOR_;
+				formatter.append(out, row[c]);
+			}
+		}
+	}
+}
+
+
+void SimulationsExecutor::writeAlignedData() {
+	// every allele is in the dictionary: the provisional indices become columns
+	alleleDictionary->finalize();
+	for (auto& columns : alleleColumns) {
+		for (auto& column : columns) {
+			column = alleleDictionary->getColumn(column);
+		}
+	}
+
+	if (withStatistics) {
+		statisticsResults.open(getOutputFileName(_OUTPUT_STATISTICS_FILE_));
+		statisticsResults << _INPUT_COMMENT_ << " step\tmean|variance|fixed|lost|q05|q50|q95 of the frequency of each allele" << '\n';
+	} else {
+		results.open(getOutputFileName(_OUTPUT_FILE_));
+		lastAlleleFqs.assign((std::size_t) nReplicates, std::string());
+	}
+
+	// the counts are read back a block at a time, and formatted by the same batches
+	std::string countsFileName = getOutputFileName(_OUTPUT_COUNTS_FILE_);
+	std::ifstream counts(countsFileName, std::ifstream::binary);
+
+	while (counts.peek() != std::ifstream::traits_type::eof()) {
+		OutputBlock aligned(0, std::vector<int>(), nReplicates);
+		OutputBlock* alignedPtr = &aligned;
+
+		while ((int) aligned.generations.size() < blockSize && counts.peek() != std::ifstream::traits_type::eof()) {
+			aligned.generations.push_back(0);
+			aligned.populationSizes.push_back(0);
+			aligned.counts.push_back(std::vector< std::vector<unsigned int> >((std::size_t) nReplicates));
+			aligned.steps.push_back(std::vector<std::string>(withStatistics ? 0 : (std::size_t) nReplicates));
+
+			Checkpoint::get(counts, aligned.generations.back());
+			Checkpoint::get(counts, aligned.populationSizes.back());
+			for (auto& replicate : aligned.counts.back()) {
+				Checkpoint::get(counts, replicate);
+			}
+		}
+
+		if (!counts) {
+			std::cerr << _ERROR_COUNTS_UNREADABLE_MSG_ << std::endl;
+			exit(_ERROR_COUNTS_UNREADABLE_CODE_);
+		}
+
+		std::size_t nSteps = aligned.generations.size();
+		batchStatistics.clear();
+		if (withStatistics) {
+			batchStatistics.assign((std::size_t) nBatches, ReplicateStatistics(nSteps, (std::size_t) data.getStatisticsBins()));
+		}
+
+		for (int batch = 0; batch < nBatches; ++batch) {
+			int first = batch * batchSize;
+			int nSimulations = std::min(batchSize, nReplicates - first);
+			ReplicateStatistics* statistics = batchStatistics.empty() ? nullptr : &batchStatistics[batch];
+
+			pool->submit([=] {
+				formatAlignedFqs(*alignedPtr, nSimulations, first, statistics);
+			});
+		}
+
+		pool->wait();
+
+		// merged in the order of the batches, as those of the other modes
+		if (withStatistics) {
+			aligned.statistics = ReplicateStatistics(nSteps, (std::size_t) data.getStatisticsBins());
+			for (auto& statistics : batchStatistics) {
+				aligned.statistics.merge(statistics);
+			}
+		}
+
+		for (std::size_t j = 0; j < nSteps; ++j) {
+			if (withStatistics) {
+				writeStatistics(aligned.generations[j], aligned.statistics.getStatisticsForOutput(j));
+			} else {
+				writeAlleleFqs(aligned.generations[j], aligned.steps[j]);
+			}
+		}
+	}
+
+	// final line: the same identifiers for every replicate
+	int T = data.getNbGenerations();
+	std::string identifiers = simulations.front().getAlleleStrings(alleleDictionary->getAlleles());
+
+	if (withStatistics) {
+		writeStatistics(T + 1, identifiers);
+	} else {
+		writeAlleleFqs(T + 1, std::vector<std::string>((std::size_t) nReplicates, identifiers));
+	}
+
+	counts.close();
+	results.close();
+	statisticsResults.close();
+
+	// kept with the checkpoint, for a run extended from it
+	if (checkpointPeriod == 0) {
+		std::remove(countsFileName.c_str());
+	}
 }
 
 
 void SimulationsExecutor::writeData() {
-	// open result file
-    results.open("results.txt");
+	// open result file (after the output of the checkpoint, when resumed)
+	std::ofstream::openmode mode = resumed ? std::ofstream::in | std::ofstream::out : std::ofstream::out;
+
+	if (alleleDictionary) {
+		// the counts of the mutation mode wait for the columns of the end of the run
+		alignedCounts.open(getTextFileName(), mode | std::ofstream::binary);
+		alignedCounts.seekp(0, std::ofstream::end);
+	} else if (data.getIsStatisticsOutput()) {
+		statisticsResults.open(getOutputFileName(_OUTPUT_STATISTICS_FILE_), mode);
+		statisticsResults.seekp(0, std::ofstream::end);
+
+		if (!resumed) {
+			statisticsResults << _INPUT_COMMENT_ << " step\tmean|variance|fixed|lost|q05|q50|q95 of the frequency of each allele" << '\n';
+		}
+	} else {
+		results.open(getOutputFileName(_OUTPUT_FILE_), mode);
+		results.seekp(0, std::ofstream::end);
+
+		lastAlleleFqs = resumed ? resumed->lastAlleleFqs : std::vector<std::string>((std::size_t) nReplicates);
+	}
+
+	if (data.getIsBinaryOutput()) {
+		int nDemes = data.getExecutionMode() == _EXECUTION_MODE_MIGRATION_ && data.getIsDetailedOutput() 
+			? (int) subPopulations.size() 
+			: 1;
+
+		if (resumed) {
+			binaryResults = std::unique_ptr<TrajectoryWriter>(new TrajectoryWriter(getOutputFileName(_OUTPUT_BINARY_FILE_),
+				nReplicates, nDemes, data.getExecutionMode(), seed, data.getParameters(),
+				resumed->binarySteps, resumed->binarySize));
+		} else {
+			binaryResults = std::unique_ptr<TrajectoryWriter>(new TrajectoryWriter(getOutputFileName(_OUTPUT_BINARY_FILE_),
+				nReplicates, nDemes, data.getExecutionMode(), seed, data.getParameters()));
+		}
+	}
     
-	// write to result file
-	for (int i = 0; i < (int) outputVals.size(); ++i) {
-		writeAlleleFqs(i, outputVals[i]);	
+	// write the blocks to the result files as they come
+	std::unique_ptr<OutputBlock> block;
+	while (true) {
+		outputQueue.pop(block);
+		if (!block) break;
+
+		if (alleleDictionary) {
+			writeCounts(*block);
+		}
+
+		for (int i = 0; i < (int) block->steps.size() && !alleleDictionary; ++i) {
+			if (statisticsResults.is_open()) {
+				// statistics of the step, or allele identifiers on the last line
+				writeStatistics(block->generations[i], block->alleles.empty() 
+					? block->statistics.getStatisticsForOutput((std::size_t) i) 
+					: *std::max_element(block->steps[i].begin(), block->steps[i].end(),
+						[](const std::string& a, const std::string& b) { return a.size() < b.size(); }));
+			} else {
+				writeAlleleFqs(block->generations[i], block->steps[i]);
+			}
+		}
+
+		if (binaryResults) {
+			for (int i = 0; i < (int) block->counts.size(); ++i) {
+				binaryResults->writeStep(block->generations[i], block->populationSizes[i], block->counts[i]);
+			}
+
+			if (!block->alleles.empty()) {
+				binaryResults->close(block->alleles);
+				binaryResults.reset();
+			}
+		}
+
+		if (!block->states.empty()) {
+			writeCheckpoint(*block);
+		}
 	}
+
+	results.close();
+	statisticsResults.close();
+	alignedCounts.close();
 }
 
 
-void SimulationsExecutor::writeAlleleFqs(int step, const std::vector<std::string>& alleleFqs) {
-	results << step;
+void SimulationsExecutor::writeCounts(const OutputBlock& block) {
+	for (std::size_t j = 0; j < block.counts.size(); ++j) {
+		Checkpoint::put(alignedCounts, block.generations[j]);
+		Checkpoint::put(alignedCounts, block.populationSizes[j]);
+
+		for (auto& counts : block.counts[j]) {
+			Checkpoint::put(alignedCounts, counts);
+		}
+	}
+}
+
+
+void SimulationsExecutor::writeCheckpoint(OutputBlock& block) {
+	Checkpoint checkpoint;
+	checkpoint.generation = block.generations.back();
+	checkpoint.seed = seed;
+	checkpoint.parameters = data.getParameters();
+
+	// the output written so far has to reach the disk before the checkpoint refers to it
+	std::ofstream& text = alleleDictionary ? alignedCounts : statisticsResults.is_open() ? statisticsResults : results;
+	text.flush();
+	checkpoint.resultsSize = (std::uint64_t) text.tellp();
+	checkpoint.lastAlleleFqs = lastAlleleFqs;
+
+	std::vector<std::string> outputFiles(1, getTextFileName());
+
+	if (binaryResults) {
+		checkpoint.binarySize = binaryResults->flush();
+		checkpoint.binarySteps = binaryResults->getSteps();
+		outputFiles.push_back(getOutputFileName(_OUTPUT_BINARY_FILE_));
+	}
+
+	checkpoint.states = std::move(block.states);
+
+	if (!checkpoint.save(getOutputFileName(_OUTPUT_CHECKPOINT_FILE_), outputFiles)) {
+		std::cerr << "Error: checkpoint file impossible to write, keeping the previous one." << std::endl;
+	}
+}
+
+
+void SimulationsExecutor::writeStep(std::ostream& out, int step) {
+	out << step;
 	if (data.getNbGenerations() > 998 && step < 1000) {
 		if (step < 10)
-			results << " ";
+			out << " ";
 		if (step < 100)
-			results << " ";
+			out << " ";
 		
-		results << " ";
+		out << " ";
 	}
 		
-	results << '\t';
+	out << '\t';
+}
+
+
+void SimulationsExecutor::writeStatistics(int step, const std::string& statistics) {
+	writeStep(statisticsResults, step);
+
+	statisticsResults << statistics << '\n';
+}
+
+
+void SimulationsExecutor::writeAlleleFqs(int step, const std::vector<std::string>& alleleFqs) {
+	writeStep(results, step);
 	
-	for (auto const& data : alleleFqs) {
-		results << data << '\t';
+	for (std::size_t i = 0; i < alleleFqs.size(); ++i) {
+		if (alleleFqs[i].empty()) {
+			results << lastAlleleFqs[i] << '\t';
+		} else {
+			results << alleleFqs[i] << '\t';
+			lastAlleleFqs[i] = alleleFqs[i];
+		}
 	}
 
 	results << '\n';
 }
 
 
+void SimulationsExecutor::writeAbsorptionTimes() {
+	std::ofstream out(getOutputFileName(_OUTPUT_ABSORPTION_FILE_));
+	out << _INPUT_COMMENT_ << " replicate\tfixation step\tfixed allele\tstep at which each allele was lost" << '\n';
+
+	// in mutation mode, the loss times follow the columns of the results: '-' for the alleles a replicate never had
+	std::size_t nColumns = alleleDictionary ? alleleDictionary->getAlleles().size() : 0;
+	std::vector<int> columnLossTimes;
+
+	std::size_t replicate = 0;
+	auto writeReplicate = [&](int fixationTime, const std::vector<int>& lossTimes, const std::vector<std::string>& alleles) {
+		out << (std::size_t) firstReplicate + replicate++ << '\t' << fixationTime << '\t';
+
+		// once absorbed, the fixed allele is the only one never lost
+		if (fixationTime >= 0) {
+			std::size_t fixed = (std::size_t) std::distance(lossTimes.begin(), std::find(lossTimes.begin(), lossTimes.end(), -1));
+			out << alleles[fixed];
+		} else {
+			out << '-';
+		}
+
+		out << '\t';
+
+		if (alleleDictionary) {
+			const std::vector<std::size_t>& columns = alleleColumns[replicate - 1];
+			std::vector<bool> isFound(nColumns, false);
+
+			columnLossTimes.assign(nColumns, -1);
+			for (std::size_t a = 0; a < lossTimes.size(); ++a) {
+				columnLossTimes[columns[a]] = lossTimes[a];
+				isFound[columns[a]] = true;
+			}
+
+			for (std::size_t c = 0; c < nColumns; ++c) {
+				if (c != 0) out << _OUTPUT_SEPARATOR_;
+
+				if (isFound[c]) {
+					out << columnLossTimes[c];
+				} else {
+					out << '-';
+				}
+			}
+		} else {
+			for (std::size_t a = 0; a < lossTimes.size(); ++a) {
+				if (a != 0) out << _OUTPUT_SEPARATOR_;
+				out << lossTimes[a];
+			}
+		}
+
+		out << '\n';
+	};
+
+	for (auto& simul : simulations) {
+		writeReplicate(simul.getFixationTime(), simul.getLossTimes(), simul.getAlleles());
+	}
+
+	for (auto& batch : batches) {
+		for (std::size_t r = 0; r < batch->getNbReplicates(); ++r) {
+			writeReplicate(batch->getFixationTime(r), batch->getLossTimes(r), batch->getAlleles());
+		}
+	}
+}
+
+
 void SimulationsExecutor::generateMutationRates() {
 	switch (data.getMutationModel()) {
 		case _MUTATION_MODEL_CANTOR_:
@@ -285,6 +1005,35 @@ void SimulationsExecutor::generateMutationRates() {
 
 
 void SimulationsExecutor::generateSubPopulations() {
+	if (!data.getMigrationGraphFile().empty()) {
+		MigrationGraph graph;
+		if (!MigrationGraph::load(data.getMigrationGraphFile(), graph)) {
+			std::cerr << _ERROR_MIGRATION_GRAPH_UNREADABLE_MSG_ << std::endl;
+			exit(_ERROR_MIGRATION_GRAPH_UNREADABLE_CODE_);
+		}
+
+		// every allele is spread evenly over the demes of the graph
+		std::size_t nDemes = graph.getNbDemes();
+		subPopulations = std::vector< std::vector<unsigned int> >(nDemes, std::vector<unsigned int>(data.getNbAlleles(), 0));
+		std::vector<std::size_t> demeSizes(nDemes, 0);
+
+		for (std::size_t i = 0; i < data.getNbAlleles(); ++i) {
+			unsigned int count = (unsigned int) rint(data.getAllelesCount()[i]);
+
+			for (std::size_t deme = 0; deme < nDemes; ++deme) {
+				subPopulations[deme][i] = (unsigned int) (count / nDemes + (deme < count % nDemes));
+				demeSizes[deme] += subPopulations[deme][i];
+			}
+		}
+
+		if (graph.limitEmigrants(demeSizes)) {
+			std::cerr << "Error: some demes of the migration graph send more individuals than they have, lowering their migrations." << std::endl;
+		}
+
+		migrationGraph = std::make_shared<const MigrationGraph>(std::move(graph));
+		return;
+	}
+
 	// subpopulations generation
 	subPopulations = std::vector< std::vector<unsigned int> >(data.getNbAlleles(), 
 															  std::vector<unsigned int>(data.getNbAlleles(), 0));
@@ -309,10 +1058,10 @@ void SimulationsExecutor::generateSubPopulations() {
 
 
     // migration rate generation
-    migrationRates = std::vector<std::vector<unsigned int> >(data.getNbAlleles(),
+    std::vector< std::vector<unsigned int> > migrationRates(data.getNbAlleles(),
 					 std::vector<unsigned int>(data.getNbAlleles(), 0));
 
-    starCenter = std::rand() % data.getNbAlleles();
+    starCenter = (size_t) RandomDist::uniformIntSingle(0, (int) data.getNbAlleles() - 1);
 	assert(starCenter <= data.getNbAlleles());
 	assert(starCenter >= 0);
 
@@ -390,35 +1139,16 @@ void SimulationsExecutor::generateSubPopulations() {
 		}
 	}
 
-	// check the migration rate table
-	for (size_t i = 0; i < subPopulations.size(); ++i) {
-		int popSum = 0;
-		for (size_t j = 0; j < subPopulations[i].size(); ++j) {
-			popSum += subPopulations[i][j];
-		}
-
-		int migSum = 0;
-		for (size_t j = 0; j < migrationRates[i].size(); ++j) {
-			migSum += migrationRates[i][j];
-		}
-
-		if (migSum > popSum) {
-			// there are too many outgoing individuals!
-			// we need to reduce it to the maximal possible value
-
-			size_t j = 0;
-			while (migSum > popSum && migSum > 0) {
-				if (migrationRates[i][j] > 0) {
-					--migrationRates[i][j];
-					--migSum;
-				}
-
-				++j;
-				j %= migrationRates[i].size();
-			}
-		}
+	// the outgoing individuals of a sub-population can not outnumber it
+	std::vector<std::size_t> demeSizes;
+	for (auto& pop : subPopulations) {
+		demeSizes.push_back(std::accumulate(pop.begin(), pop.end(), (std::size_t) 0));
 	}
 
+	MigrationGraph graph(migrationRates);
+	graph.limitEmigrants(demeSizes);
+	migrationGraph = std::make_shared<const MigrationGraph>(std::move(graph));
+
 	// display the mutation rates
 	/*std::cout << "Migration rate table" << std::endl;
 	for (auto& mig : migrationRates) {
@@ -430,6 +1160,28 @@ void SimulationsExecutor::generateSubPopulations() {
 }
 
 
+std::string SimulationsExecutor::getTextFileName() const {
+	if (isAligned) {
+		return getOutputFileName(_OUTPUT_COUNTS_FILE_);
+	}
+
+	return getOutputFileName(data.getIsStatisticsOutput() ? _OUTPUT_STATISTICS_FILE_ : _OUTPUT_FILE_);
+}
+
+
+std::string SimulationsExecutor::getOutputFileName(const std::string& fileName) const {
+	std::string name = fileName;
+
+	// the point of a sweep is inserted before the extension: results.sweep-3.txt
+	if (!outputTag.empty()) {
+		std::size_t extension = std::min(name.rfind('.'), name.size());
+		name.insert(extension, "." + outputTag);
+	}
+
+	return nShards != 0 ? ShardMerger::getShardFileName(name, shard, nShards) : name;
+}
+
+
 size_t SimulationsExecutor::getStarCenter() const {
 	return starCenter;
 }
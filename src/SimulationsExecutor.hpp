@@ -5,18 +5,31 @@
 #include <fstream>
 #include <vector>
 #include <deque>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <ctime>
 #include "Simulation.hpp"
+#include "MigrationGraph.hpp"
+#include "AlleleDictionary.hpp"
+#include "Checkpoint.hpp"
 #include "Data.hpp"
 #include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "SpscQueue.hpp"
+#include "TrajectoryWriter.hpp"
+#include "ReplicateStatistics.hpp"
+#include "ReplicateBatch.hpp"
 
 
 /** \brief Class representing a SimulationsExecutor
  * 
  * This class is a wrapper for the execution of multiple single
  * simulations with the same initial parameters (e.g. to generate statistics).
- * The Simulations are run on different threads and their outputs stored
- * in a common file.  
+ * The Simulations are run in small batches on a pool of persistent threads,
+ * block of generations by block of generations. A dedicated writer thread
+ * stores the finished blocks in a common file while the next block is
+ * being simulated.
  * */
 class SimulationsExecutor {
 	
@@ -29,8 +42,24 @@ public:
 	 *
 	 * \param input 		the path of the input file to be read
 	 * \param fasta 		the path of the fasta file to be read
+	 * \param resume		whether to resume the run from its last checkpoint
+	 * \param shard			index of the slice of the replicates to run, from 0
+	 * \param nShards		number of slices the replicates are split into (0 to run them all)
 	 * */
-	SimulationsExecutor(std::string input, std::string fasta);
+	SimulationsExecutor(std::string input, std::string fasta, bool resume = false, int shard = 0, int nShards = 0);
+
+
+	/** \brief SimulationsExecutor constructor, from parameters already read
+	 *
+	 * \param data			the parameters of the run
+	 * \param resume		whether to resume the run from its last checkpoint
+	 * \param shard			index of the slice of the replicates to run, from 0
+	 * \param nShards		number of slices the replicates are split into (0 to run them all)
+	 * \param pool			threads to run the replicates on (the points of a sweep share them), new ones if null
+	 * \param outputTag		tag inserted in the names of the output files (the point of a sweep), if any
+	 * */
+	SimulationsExecutor(const Data& data, bool resume = false, int shard = 0, int nShards = 0,
+						std::shared_ptr<ThreadPool> pool = std::shared_ptr<ThreadPool>(), const std::string& outputTag = "");
 	
 
 	//!< Because of the threads, we do not allow any copies
@@ -43,42 +72,257 @@ public:
 
 	/** \brief Start the execution of the simulations
 	 * 
-	 * Invoking this method will create the threads and execute them.
+	 * Invoking this method will schedule the replicates on the thread pool
+	 * and wait for them to finish.
 	 * */
 	void execute();
 
+
+	/** \brief Prepare the replicates and start the writer thread
+	 *
+	 * execute() is start(), then submitBlock() and endBlock() until every
+	 * block is done, then finish(). A sweep interleaves these steps for its
+	 * points, so that their blocks share the pool.
+	 * */
+	void start();
+
+
+	/** \brief Submit the batches of the next block to the pool
+	 *
+	 * \return false if every block was already submitted
+	 * */
+	bool submitBlock();
+
+
+	/** \brief Hand the submitted block to the writer, once the pool has run it
+	 * */
+	void endBlock();
+
+
+	/** \brief Write the allele identifiers and the absorption times, and stop the writer thread
+	 * */
+	void finish();
+
+
+	/** \brief Set the number of replicates run at the same time on the pool
+	 *
+	 * The points of a sweep fill the pool together: a replicate only splits
+	 * its demes across the threads when all of them leave some idle.
+	 *
+	 * \param nReplicates	replicates of every executor sharing the pool (those of this one by default)
+	 * */
+	void setPoolReplicates(int nReplicates);
+
+
+	/** \brief Start the threads to run the replicates on
+	 *
+	 * \param nThreads		number of threads requested by the user (0 to let the system decide)
+	 * */
+	static std::shared_ptr<ThreadPool> createPool(int nThreads);
+
 protected:
 
+	/** \brief Output of a block of consecutive recorded steps for every replicate
+	 * */
+	struct OutputBlock {
+
+		OutputBlock(int first, const std::vector<int>& recorded, int nReplicates, bool withStrings = true, bool withCounts = false)
+		  : firstStep(first),
+			generations(recorded),
+			steps(recorded.size(), std::vector<std::string>(withStrings ? (std::size_t) nReplicates : 0)),
+			populationSizes(recorded.size(), 0)
+		{
+			if (withCounts) {
+				counts.assign(recorded.size(), std::vector< std::vector<unsigned int> >((std::size_t) nReplicates));
+			}
+		}
+
+
+		//!< First step simulated by the block (the one after the last step of the previous block)
+		int firstStep;
+
+
+		//!< Step of every line of the block, in increasing order: the steps in between are only simulated
+		std::vector<int> generations;
+
+
+		//!< Formatted allele frequencies, indexed by [line][replicate]
+		std::vector< std::vector<std::string> > steps;
+
+
+		//!< Raw allele counts for the binary output, indexed by [line][replicate]
+		std::vector< std::vector< std::vector<unsigned int> > > counts;
+
+
+		//!< Total population size at each line
+		std::vector<unsigned long long> populationSizes;
+
+
+		//!< Statistics across the replicates, if requested
+		ReplicateStatistics statistics;
+
+
+		//!< Allele identifiers of every replicate, only set on the last block
+		std::vector< std::vector<std::string> > alleles;
+
+
+		//!< State of the replicates of every batch at the end of the block, if a checkpoint is due
+		std::vector<std::string> states;
+	};
+
 	/** \brief Generate a new Simulation based on the given parameters
+	 *
+	 * \param allelesCount		initial allele counts
 	 *
 	 * \return A new Simulation based on the user's paramters
 	 * */
-	Simulation createSimulation() const;
+	Simulation createSimulation(const std::vector<unsigned int>& allelesCount) const;
+
+
+	/** \brief Generate a new batch of replicates advanced in lockstep
+	 *
+	 * \param nSimulations			number of simulations in the batch
+	 * \param firstSimulationIdx	index of the first simulation of the batch
+	 * */
+	std::unique_ptr<ReplicateBatch> createBatch(int nSimulations, int firstSimulationIdx) const;
+
+
+	/** \brief Restore the replicates and the output files from the last checkpoint
+	 *
+	 * \param batchSize			number of replicates per batch
+	 * \param isLockstep			whether the replicates are advanced in lockstep
+	 *
+	 * \return Whether the run is resumed (else it starts from the beginning)
+	 * */
+	bool loadCheckpoint(int batchSize, bool isLockstep);
+
+
+	/** \brief Write a checkpoint once the lines of a block are written
+	 *
+	 * This method is executed by the writer thread.
+	 *
+	 * \param block				the block, with the state of the replicates at its end
+	 * */
+	void writeCheckpoint(OutputBlock& block);
 	
 
-	/** \brief Run a simulation
+	/** \brief Run a batch of simulations over the steps of a block
 	 * 
-	 * This method is executed by a thread.
+	 * This method is executed by a thread of the pool. The simulations are
+	 * created on the first step of the run, and only the recorded steps
+	 * are stored in the block.
 	 * 
+	 * \param block				the block to fill with the simulations' output
 	 * \param nSimulations			number of simulations to be run
 	 * \param firstSimulationIdx	simulation index offset (relevant for output)
+	 * \param statistics			accumulator of the batch, if statistics are requested
+	 * \param state				state of the batch at the end of the block, if a checkpoint is due
 	 * */
-	void runSimulation(int nSimulations, int firstSimulationIdx);
+	void runSimulation(OutputBlock& block, int nSimulations, int firstSimulationIdx,
+					   ReplicateStatistics* statistics = nullptr, std::string* state = nullptr);
+
+
+	/** \brief Run a batch of simulations in lockstep over the steps of a block
+	 * 
+	 * Same as runSimulation(), the replicates of the batch being stored and
+	 * advanced together by a \ref ReplicateBatch.
+	 * 
+	 * \param block				the block to fill with the simulations' output
+	 * \param batchIdx				index of the batch
+	 * \param nSimulations			number of simulations in the batch
+	 * \param firstSimulationIdx	simulation index offset (relevant for output)
+	 * \param statistics			accumulator of the batch, if statistics are requested
+	 * \param state				state of the batch at the end of the block, if a checkpoint is due
+	 * */
+	void runBatch(OutputBlock& block, int batchIdx, int nSimulations, int firstSimulationIdx,
+				  ReplicateStatistics* statistics = nullptr, std::string* state = nullptr);
+	
+
+	/** \brief Add the alleles a simulation found since its last recorded step to the allele dictionary
+	 * 
+	 * This method is executed by a thread of the pool: the provisional
+	 * index of every allele of the replicate is kept in \ref alleleColumns.
+	 * 
+	 * \param simulationIdx		index of the simulation
+	 * */
+	void alignAlleles(int simulationIdx);
+
+
+	/** \brief Format the frequencies of a batch of simulations over the columns of the allele dictionary
+	 * 
+	 * This method is executed by a thread of the pool, once the dictionary
+	 * is finalized: every replicate gets a column for every allele found by
+	 * the run, 0 for the ones it never had.
+	 * 
+	 * \param block				a block read back from the counts, with the raw counts
+	 * \param nSimulations			number of simulations to be formatted
+	 * \param firstSimulationIdx	simulation index offset (relevant for output)
+	 * \param statistics			accumulator of the batch, filled instead of the frequencies if statistics are requested
+	 * */
+	void formatAlignedFqs(OutputBlock& block, int nSimulations, int firstSimulationIdx,
+						  ReplicateStatistics* statistics = nullptr);
+
+
+	/** \brief Write the text output of the mutation mode, once the run is over
+	 * 
+	 * The counts written by the writer thread are read back a block at a
+	 * time, and formatted over the columns of the finalized dictionary (or
+	 * summarised into statistics). The counts file is then removed, unless
+	 * it is kept with a checkpoint.
+	 * */
+	void writeAlignedData();
 	
 
 	/** \brief Write data to the result file
+	 * 
+	 * This method is executed by the writer thread: it writes the blocks
+	 * in the order they are queued, until it receives an empty block.
 	 * */
 	void writeData();
 	
 
+	/** \brief Append the raw counts of a block to the counts file (mutation mode)
+	 * 
+	 * This method is executed by the writer thread.
+	 * */
+	void writeCounts(const OutputBlock& block);
+
+
+	/** \brief Write the step number at the beginning of a line
+	 * 
+	 * \param out			the file to write to
+	 * \param step			the step number
+	 * */
+	void writeStep(std::ostream& out, int step);
+
+
+	/** \brief Write the statistics of one step to the statistics file
+	 * 
+	 * \param step			the step number
+	 * \param statistics	the formatted statistics of the step
+	 * */
+	void writeStatistics(int step, const std::string& statistics);
+
+
 	/** \brief Write one step of all simulations to the result file
 	 * 
 	 * Wrties the data passed as argument in the result file.
 	 * 
+	 * An empty string stands for the same frequencies as the replicate's
+	 * previous step (used once the replicate is absorbed).
+	 * 
 	 * \param step			the step number of the simulation to be written
 	 * \param alleleFqs		a vector of strings (each being a formatted list of allele frequencies)
 	 * */
 	void writeAlleleFqs(int step, const std::vector<std::string>& alleleFqs);
+
+
+	/** \brief Write the fixation and loss times of every replicate
+	 * 
+	 * One line per replicate: the step at which an allele fixed, that allele,
+	 * and the step at which every allele was lost (-1 if it did not happen).
+	 * */
+	void writeAbsorptionTimes();
 	
 
 	/** \brief Generate table for nucleotide mutation rates based on user input data
@@ -108,6 +352,18 @@ protected:
 	 * */
 	size_t getStarCenter() const;	
 
+
+	/** \brief Get the name of the file the writer thread appends the lines to, cut back on resume
+	 * */
+	std::string getTextFileName() const;
+
+
+	/** \brief Get the name of an output file, that of the shard if the run is split
+	 *
+	 * \param fileName		name of the output file of a run that is not split
+	 * */
+	std::string getOutputFileName(const std::string& fileName) const;
+
 private:
 
 	//!< Data object containing all user params
@@ -122,22 +378,147 @@ private:
     std::vector< std::vector<unsigned int> > subPopulations;
 
     
-    //!< Table containing migration rates for each sub group
-    std::vector< std::vector<unsigned int> > migrationRates;
+    //!< Migrations between the sub-populations, shared by the replicates
+    std::shared_ptr<const MigrationGraph> migrationGraph;
 
 
     //!< The index of the population at the center of a star-shaped migration pattern
     size_t starCenter;
 	
 
+	//!< Index of the slice of the replicates run by this process
+	int shard;
+
+
+	//!< Number of slices the replicates are split into (0 if the run is not split)
+	int nShards;
+
+
+	//!< Index of the first replicate of the shard in the whole run
+	int firstReplicate;
+
+
+	//!< Number of replicates run by this process
+	int nReplicates;
+
+
+	//!< Number of replicates run at the same time on the pool, by every executor sharing it
+	int poolReplicates;
+
+
+	//!< Tag of the output files (the point of a sweep), empty if none
+	std::string outputTag;
+
+
+	//!< Start of the run
+	time_t startTime;
+
+
+	//!< Number of replicates per batch
+	int batchSize;
+
+
+	//!< Number of batches
+	int nBatches;
+
+
+	//!< Whether the replicates are advanced in lockstep
+	bool isLockstep;
+
+
+	//!< Whether only the statistics across the replicates are written
+	bool withStatistics;
+
+
+	//!< Whether the text output is aligned on the columns of the allele dictionary, written at the end (mutation mode)
+	bool isAligned;
+
+
+	//!< Number of recorded steps per block
+	int blockSize;
+
+
+	//!< Number of generations between two checkpoints (0: none)
+	int checkpointPeriod;
+
+
+	//!< Generation from which the next checkpoint is due
+	int nextCheckpoint;
+
+
+	//!< First recorded line after the checkpoint the run resumed from (0 for a new run)
+	int firstResumedLine;
+
+
+	//!< First recorded line of the next block
+	int nextLine;
+
+
+	//!< Block being simulated
+	std::unique_ptr<OutputBlock> block;
+
+
+	//!< Statistics accumulators of the batches of the block being simulated
+	std::vector<ReplicateStatistics> batchStatistics;
+
+
+	//!< Writer thread
+	std::thread writer;
+
+
+	//!< Whether the run resumes from its last checkpoint
+	bool isResumed;
+
+
+	//!< Checkpoint the run resumed from, used by the writer thread to append to the output files
+	std::unique_ptr<Checkpoint> resumed;
+
+
+	//!< Global seed of the run (the one of the checkpoint when resumed)
+	unsigned long long seed;
+
+
 	//!< Result file
 	std::ofstream results;
+
+
+	//!< Statistics file, if requested
+	std::ofstream statisticsResults;
+
+
+	//!< Raw counts of the mutation mode, formatted once the columns are known
+	std::ofstream alignedCounts;
+
+
+	//!< Last frequencies written for each replicate, repeated once it is absorbed
+	std::vector<std::string> lastAlleleFqs;
+
+
+	//!< Alleles found by the replicates, to give them the same columns (mutation mode)
+	std::unique_ptr<AlleleDictionary> alleleDictionary;
+
+
+	//!< Index of every allele of every replicate in \ref alleleDictionary: provisional, then its column
+	std::vector< std::vector<std::size_t> > alleleColumns;
+
+
+	//!< Binary result file of the raw counts, if requested
+	std::unique_ptr<TrajectoryWriter> binaryResults;
 	
-	//!< Number of threads
-	unsigned int nThreads;
-	
-	//!< Output values
-	std::vector< std::vector<std::string> > outputVals;
+	//!< Simulations of the replicates, kept between the output blocks
+	std::vector<Simulation> simulations;
+
+
+	//!< Batches of replicates advanced in lockstep (instead of \ref simulations), kept between the output blocks
+	std::vector< std::unique_ptr<ReplicateBatch> > batches;
+
+
+	//!< Finished blocks waiting for the writer thread
+	SpscQueue< std::unique_ptr<OutputBlock> > outputQueue;
+
+
+	//!< Worker threads, declared last to be stopped first (unless shared with the other points of a sweep)
+	std::shared_ptr<ThreadPool> pool;
 };
 
 #endif
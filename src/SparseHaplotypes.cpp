@@ -0,0 +1,379 @@
+#include <cassert>
+#include <algorithm>
+#include <stdexcept>
+#include "SparseHaplotypes.hpp"
+#include "Checkpoint.hpp"
+
+namespace {
+	// smallest number of slots of the hash table
+	const std::size_t MIN_SLOTS = 16;
+
+
+	// marker of a free slot
+	const std::size_t EMPTY = (std::size_t) -1;
+
+
+	// parent of a root haplotype
+	const std::size_t NO_PARENT = (std::size_t) -1;
+
+
+	// parent of a released haplotype
+	const std::size_t FREED = (std::size_t) -2;
+
+
+	// a difference packs the site with its nucleotide (2 bits)
+	inline std::uint32_t difference(std::size_t site, unsigned nucleotide) {
+		return (std::uint32_t) (site << 2) | nucleotide;
+	}
+
+
+	inline std::size_t siteOf(std::uint32_t difference) {
+		return difference >> 2;
+	}
+
+
+	// second hash of a difference list, telling a released haplotype from the others of its hash
+	std::uint64_t fingerprint(const std::vector<std::uint32_t>& differences) {
+		std::uint64_t h = 0x243F6A8885A308D3ULL;
+
+		for (auto d : differences) {
+			h += d;
+			h ^= h >> 33;
+			h *= 0xFF51AFD7ED558CCDULL;
+			h ^= h >> 33;
+		}
+
+		return h;
+	}
+}
+
+
+SparseHaplotypes::SparseHaplotypes(const std::vector<std::string>& haplotypes)
+  : slots(MIN_SLOTS, EMPTY)
+{
+	std::vector<unsigned char> sequence;
+
+	if (!haplotypes.empty()) {
+		for (char c : haplotypes.front()) {
+			sequence.push_back((unsigned char) Nucl::fromChar.at(c));
+			assert(sequence.back() < Nucl::Nucleotide::N);
+		}
+	}
+
+	// the differences are packed on 32 bits, with the nucleotide
+	if (sequence.size() >= (std::size_t) _MAX_HAPLOTYPE_SITES_) {
+		throw std::length_error("Haplotypes of " + std::to_string(sequence.size()) + " sites, the limit is "
+								+ std::to_string(_MAX_HAPLOTYPE_SITES_ - 1) + ".");
+	}
+
+	reference = std::make_shared< const std::vector<unsigned char> >(std::move(sequence));
+
+	for (auto& haplotype : haplotypes) {
+		assert(haplotype.size() == reference->size());
+
+		scratch.clear();
+		for (std::size_t site = 0; site < haplotype.size(); ++site) {
+			unsigned nucleotide = (unsigned) Nucl::fromChar.at(haplotype[site]);
+			assert(nucleotide < Nucl::Nucleotide::N);
+
+			if (nucleotide != (*reference)[site]) scratch.push_back(difference(site, nucleotide));
+		}
+
+		// a repeated haplotype keeps its own index, the lookups find the first one
+		std::size_t nHaplotypes = size();
+		if (findOrAdd(NO_PARENT, 0) < nHaplotypes) {
+			add(nHaplotypes, NO_PARENT, 0, hash(scratch.data(), scratch.data() + scratch.size()));
+		}
+	}
+}
+
+
+std::size_t SparseHaplotypes::size() const {
+	return nodes.size();
+}
+
+
+std::size_t SparseHaplotypes::getNbSites() const {
+	return reference->size();
+}
+
+
+std::size_t SparseHaplotypes::getNbDifferences(std::size_t haplotype) const {
+	return nodes[haplotype].nbDifferences;
+}
+
+
+Nucl::Nucleotide SparseHaplotypes::getSite(std::size_t haplotype, std::size_t site) const {
+	assert(nodes[haplotype].parent != FREED);
+
+	// the latest mutation of the site along the lineage
+	for (; nodes[haplotype].parent != NO_PARENT; haplotype = nodes[haplotype].parent) {
+		if (siteOf(nodes[haplotype].change) == site) {
+			return (Nucl::Nucleotide) (nodes[haplotype].change & 3);
+		}
+	}
+
+	auto first = differences.begin() + nodes[haplotype].offset;
+	auto last = first + nodes[haplotype].nbDifferences;
+
+	auto it = std::lower_bound(first, last, difference(site, 0));
+	if (it != last && siteOf(*it) == site) {
+		return (Nucl::Nucleotide) (*it & 3);
+	}
+
+	return (Nucl::Nucleotide) (*reference)[site];
+}
+
+
+std::size_t SparseHaplotypes::mutate(std::size_t haplotype, std::size_t site, Nucl::Nucleotide target) {
+	assert(haplotype < size() && site < getNbSites() && target < Nucl::Nucleotide::N);
+	assert(nodes[haplotype].parent != FREED);
+
+	collectDifferences(haplotype, scratch);
+	auto it = std::lower_bound(scratch.begin(), scratch.end(), difference(site, 0));
+	bool isDifferent = it != scratch.end() && siteOf(*it) == site;
+
+	// the site differs after the mutation, or no longer does
+	if (target != (*reference)[site]) {
+		if (isDifferent) {
+			*it = difference(site, target);
+		} else {
+			scratch.insert(it, difference(site, target));
+		}
+	} else if (isDifferent) {
+		scratch.erase(it);
+	}
+
+	return findOrAdd(haplotype, difference(site, target));
+}
+
+
+void SparseHaplotypes::release(const std::vector<std::size_t>& alive) {
+	// the haplotypes alive are kept, with the lineages they read
+	for (auto haplotype : alive) {
+		for (; haplotype != NO_PARENT && !nodes[haplotype].isKept; haplotype = nodes[haplotype].parent) {
+			assert(nodes[haplotype].parent != FREED);
+			nodes[haplotype].isKept = 1;
+		}
+	}
+
+	// the others stay in the hash table, under the second hash of their differences
+	// (read before any of them is freed, as they may derive from one another)
+	std::vector<std::uint64_t> fingerprints;
+	for (auto haplotype : held) {
+		if (!nodes[haplotype].isKept) {
+			collectDifferences(haplotype, candidate);
+			fingerprints.push_back(fingerprint(candidate));
+		}
+	}
+
+	// the roots kept are packed in their order
+	std::size_t nHeld = 0;
+	std::size_t nDifferences = 0;
+	auto released = fingerprints.begin();
+
+	for (auto haplotype : held) {
+		Node& node = nodes[haplotype];
+
+		if (!node.isKept) {
+			node.parent = FREED;
+			node.offset = (std::size_t) *released++;
+			continue;
+		}
+
+		if (node.parent == NO_PARENT) {
+			std::copy(differences.begin() + node.offset, differences.begin() + node.offset + node.nbDifferences,
+					  differences.begin() + nDifferences);
+			node.offset = nDifferences;
+			nDifferences += node.nbDifferences;
+		}
+
+		node.isKept = 0;
+		held[nHeld++] = haplotype;
+	}
+
+	held.resize(nHeld);
+	differences.resize(nDifferences);
+}
+
+
+std::string SparseHaplotypes::toString(std::size_t haplotype) const {
+	std::string s(getNbSites(), ' ');
+
+	for (std::size_t site = 0; site < s.size(); ++site) {
+		s[site] = Nucl::toChar[(*reference)[site]];
+	}
+
+	collectDifferences(haplotype, candidate);
+	for (auto d : candidate) {
+		s[siteOf(d)] = Nucl::toChar[d & 3];
+	}
+
+	return s;
+}
+
+
+std::string SparseHaplotypes::describe(std::size_t haplotype) const {
+	if (getNbDifferences(haplotype) == 0) return "ref";
+
+	collectDifferences(haplotype, candidate);
+
+	std::string s;
+	for (std::size_t i = 0; i < candidate.size(); ++i) {
+		if (i != 0) s += ',';
+		s += std::to_string(siteOf(candidate[i]));
+		s += Nucl::toChar[candidate[i] & 3];
+	}
+
+	return s;
+}
+
+
+void SparseHaplotypes::saveState(std::ostream& out) const {
+	Checkpoint::put(out, nodes);
+	Checkpoint::put(out, held);
+	Checkpoint::put(out, differences);
+}
+
+
+void SparseHaplotypes::loadState(std::istream& in) {
+	Checkpoint::get(in, nodes);
+	Checkpoint::get(in, held);
+	Checkpoint::get(in, differences);
+
+	// the index is rebuilt at the size it had, at most half full
+	std::size_t nSlots = MIN_SLOTS;
+	while (2 * size() > nSlots) nSlots *= 2;
+
+	slots.assign(nSlots / 2, EMPTY);
+	grow();
+}
+
+
+void SparseHaplotypes::collectDifferences(std::size_t haplotype, std::vector<std::uint32_t>& out) const {
+	assert(nodes[haplotype].parent != FREED);
+
+	lineage.clear();
+	for (; nodes[haplotype].parent != NO_PARENT; haplotype = nodes[haplotype].parent) {
+		lineage.push_back(nodes[haplotype].change);
+	}
+
+	// the latest mutation of a site (the first one met) hides the earlier ones
+	auto bySite = [](std::uint32_t a, std::uint32_t b) { return siteOf(a) < siteOf(b); };
+	std::stable_sort(lineage.begin(), lineage.end(), bySite);
+	lineage.erase(std::unique(lineage.begin(), lineage.end(), [](std::uint32_t a, std::uint32_t b) {
+		return siteOf(a) == siteOf(b);
+	}), lineage.end());
+
+	// merged with the differences of the root, without the mutations back to the reference
+	auto first = differences.begin() + nodes[haplotype].offset;
+	auto last = first + nodes[haplotype].nbDifferences;
+	auto change = lineage.begin();
+
+	out.clear();
+	while (first != last || change != lineage.end()) {
+		if (change == lineage.end() || (first != last && siteOf(*first) < siteOf(*change))) {
+			out.push_back(*first++);
+			continue;
+		}
+
+		if (first != last && siteOf(*first) == siteOf(*change)) ++first;
+		if ((*change & 3) != (*reference)[siteOf(*change)]) out.push_back(*change);
+		++change;
+	}
+}
+
+
+std::size_t SparseHaplotypes::findOrAdd(std::size_t parent, std::uint32_t change) {
+	std::size_t mask = slots.size() - 1;
+	const std::uint32_t* key = scratch.data();
+	std::uint64_t h = hash(key, key + scratch.size());
+
+	// second hash, for the released haplotypes met
+	std::uint64_t check = 0;
+	bool isChecked = false;
+
+	for (std::size_t slot = (std::size_t) h & mask; ; slot = (slot + 1) & mask) {
+		std::size_t index = slots[slot];
+
+		if (index == EMPTY) {
+			index = size();
+			add(index, parent, change, h);
+			slots[slot] = index;
+
+			// at most half full, to keep the probes short
+			if (2 * size() > slots.size()) grow();
+
+			return index;
+		}
+
+		if (nodes[index].hash != h || nodes[index].nbDifferences != scratch.size()) continue;
+
+		if (nodes[index].parent != FREED) {
+			collectDifferences(index, candidate);
+			if (candidate == scratch) return index;
+			continue;
+		}
+
+		// a released haplotype brought back gets its index again
+		if (!isChecked) {
+			check = fingerprint(scratch);
+			isChecked = true;
+		}
+
+		if ((std::uint64_t) nodes[index].offset == check) {
+			add(index, parent, change, h);
+			return index;
+		}
+	}
+}
+
+
+void SparseHaplotypes::add(std::size_t haplotype, std::size_t parent, std::uint32_t change, std::uint64_t h) {
+	Node node = { parent, 0, h, change, (std::uint32_t) scratch.size(), 0, 0 };
+
+	// a lineage too deep to walk is cut: the haplotype becomes a root
+	if (parent != NO_PARENT) node.depth = nodes[parent].depth + 1;
+
+	if (parent == NO_PARENT || node.depth > _MAX_LINEAGE_DEPTH_) {
+		node.parent = NO_PARENT;
+		node.offset = differences.size();
+		node.depth = 0;
+		differences.insert(differences.end(), scratch.begin(), scratch.end());
+	}
+
+	held.push_back(haplotype);
+	if (haplotype == size()) {
+		nodes.push_back(node);
+	} else {
+		nodes[haplotype] = node;
+	}
+}
+
+
+std::uint64_t SparseHaplotypes::hash(const std::uint32_t* first, const std::uint32_t* last) const {
+	std::uint64_t h = 0;
+
+	for (; first != last; ++first) {
+		h = (h ^ *first) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 29;
+	}
+
+	return h ^ (h >> 32);
+}
+
+
+void SparseHaplotypes::grow() {
+	std::vector<std::size_t> larger(2 * slots.size(), EMPTY);
+	std::size_t mask = larger.size() - 1;
+
+	// in the order of the indices: a repeated initial haplotype comes after the first one
+	for (std::size_t index = 0; index < size(); ++index) {
+		std::size_t slot = (std::size_t) nodes[index].hash & mask;
+		while (larger[slot] != EMPTY) slot = (slot + 1) & mask;
+
+		larger[slot] = index;
+	}
+
+	slots.swap(larger);
+}
@@ -0,0 +1,182 @@
+#ifndef SPARSE_HAPLOTYPES_H
+#define SPARSE_HAPLOTYPES_H
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Globals.hpp"
+
+
+/** \brief Set of haplotypes, stored as their differences from a reference sequence
+ *
+ * The reference is the first of the initial haplotypes, stored once and
+ * shared by the copies of the set. A root haplotype (an initial one, among
+ * others) is the sorted list of the sites where it differs from the
+ * reference, with their nucleotide packed on the 2 low bits of the site.
+ * A haplotype born from a mutation only stores the haplotype it derives
+ * from and the site it changed: the lineages form a tree sharing their
+ * differences. Reading a haplotype walks its lineage up to its root, at
+ * most _MAX_LINEAGE_DEPTH_ mutations away: a deeper mutation starts a new
+ * root, with its own copy of the differences.
+ *
+ * The haplotypes of the extinct alleles are freed by \ref release, unless
+ * a haplotype kept derives from them: the memory follows the haplotypes
+ * present (their roots, and the lineages up to them), not the mutations
+ * of the whole run. A released haplotype only keeps its entry in the hash
+ * table, with a second hash of its differences: a mutation bringing it
+ * back gives it its index again.
+ *
+ * The haplotypes are interned: an open-addressing hash table (linear
+ * probing) maps the differences of every haplotype to its index, and a
+ * mutation bringing a haplotype back finds its index in constant expected
+ * time. The haplotypes keep the index of their insertion, the initial ones
+ * included even if repeated.
+ * Throws std::length_error for sequences of _MAX_HAPLOTYPE_SITES_ sites or more.
+ *
+ * */
+class SparseHaplotypes {
+
+public:
+
+	/** \brief SparseHaplotypes constructor
+	 *
+	 * \param haplotypes	the initial haplotypes, of the same length (nucleotides A, C, G or T)
+	 * */
+	SparseHaplotypes(const std::vector<std::string>& haplotypes = std::vector<std::string>());
+
+
+	/** \brief Get the number of haplotypes
+	 * */
+	std::size_t size() const;
+
+
+	/** \brief Get the number of sites of a haplotype
+	 * */
+	std::size_t getNbSites() const;
+
+
+	/** \brief Get the number of sites where a haplotype differs from the reference
+	 * */
+	std::size_t getNbDifferences(std::size_t haplotype) const;
+
+
+	/** \brief Get the nucleotide of a haplotype at a site
+	 * */
+	Nucl::Nucleotide getSite(std::size_t haplotype, std::size_t site) const;
+
+
+	/** \brief Find, or add, the haplotype differing from another by one nucleotide
+	 *
+	 * \param haplotype		index of the mutated haplotype
+	 * \param site			index of the mutated site
+	 * \param target		nucleotide after the mutation
+	 *
+	 * \return The index of the mutated haplotype (equal to the former \ref size if it is new)
+	 * */
+	std::size_t mutate(std::size_t haplotype, std::size_t site, Nucl::Nucleotide target);
+
+
+	/** \brief Free the haplotypes that are neither alive nor an ancestor of one
+	 *
+	 * The freed haplotypes can no longer be read, until \ref mutate brings them back.
+	 *
+	 * \param alive			indices of the haplotypes still present
+	 * */
+	void release(const std::vector<std::size_t>& alive);
+
+
+	/** \brief Build the sequence of a haplotype
+	 * */
+	std::string toString(std::size_t haplotype) const;
+
+
+	/** \brief Describe a haplotype by its differences from the reference
+	 *
+	 * \return "ref" for the reference, else the differences as site (from 0)
+	 * and nucleotide, separated by commas (e.g. "152C,3021T")
+	 * */
+	std::string describe(std::size_t haplotype) const;
+
+
+	/** \brief Write the haplotypes (not the reference, shared with the initial ones)
+	 * */
+	void saveState(std::ostream& out) const;
+
+
+	/** \brief Read the haplotypes written by \ref saveState, on the same reference
+	 * */
+	void loadState(std::istream& in);
+
+private:
+
+	//!< Haplotype of the set: a root, or the mutation of another one
+	struct Node {
+		std::size_t parent;				//!< Haplotype it derives from (NO_PARENT for a root, FREED once released)
+		std::size_t offset;				//!< Start of the differences of a root in \ref differences (second hash once released)
+		std::uint64_t hash;				//!< Hash of its differences from the reference
+		std::uint32_t change;			//!< Site and nucleotide set by its mutation, as (site << 2 | nucleotide)
+		std::uint32_t nbDifferences;	//!< Number of sites where it differs from the reference
+		std::uint32_t depth;			//!< Number of mutations from its root
+		std::uint32_t isKept;			//!< Mark of the haplotypes kept by \ref release
+	};
+
+
+	//!< Write the differences of a haplotype into \p out, sorted by site
+	void collectDifferences(std::size_t haplotype, std::vector<std::uint32_t>& out) const;
+
+
+	/** \brief Find the index of the differences in \ref scratch, adding them if new
+	 *
+	 * \param parent		haplotype the new one derives from, or NO_PARENT to add a root
+	 * \param change		site and nucleotide set by the mutation (derived haplotypes)
+	 * */
+	std::size_t findOrAdd(std::size_t parent, std::uint32_t change);
+
+
+	//!< Add (or bring back) a haplotype with the differences of \ref scratch, derived from \p parent (or a root)
+	void add(std::size_t haplotype, std::size_t parent, std::uint32_t change, std::uint64_t h);
+
+
+	//!< Hash of a difference list
+	std::uint64_t hash(const std::uint32_t* first, const std::uint32_t* last) const;
+
+
+	//!< Double the capacity of the hash table
+	void grow();
+
+
+	//!< Nucleotides of the reference sequence
+	std::shared_ptr< const std::vector<unsigned char> > reference;
+
+
+	//!< Every haplotype, the initial ones first
+	std::vector<Node> nodes;
+
+
+	//!< Indices of the haplotypes not freed, in the order of their addition
+	std::vector<std::size_t> held;
+
+
+	//!< Differences of the roots, as (site << 2 | nucleotide), sorted by site in every haplotype
+	std::vector<std::uint32_t> differences;
+
+
+	//!< Hash table of the haplotype indices (power-of-two size)
+	std::vector<std::size_t> slots;
+
+
+	//!< Difference list of the haplotype being looked up
+	std::vector<std::uint32_t> scratch;
+
+
+	//!< Difference list of a haplotype of the table, compared with \ref scratch
+	mutable std::vector<std::uint32_t> candidate;
+
+
+	//!< Changes met along a lineage, while its differences are collected
+	mutable std::vector<std::uint32_t> lineage;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+/** \brief Bounded lock-free queue for one producer and one consumer thread
+ *
+ * A ring buffer whose head is only written by the consumer and whose tail
+ * is only written by the producer. A full queue blocks the producer, which
+ * bounds the number of elements in flight. Blocked threads back off from
+ * spinning to short sleeps, so an idle consumer does not steal a core from
+ * the workers.
+ *
+ * */
+template<typename T>
+class SpscQueue {
+
+public:
+
+	/** \brief SpscQueue constructor
+	 *
+	 * \param capacity		maximal number of elements in the queue
+	 * */
+	explicit SpscQueue(std::size_t capacity)
+	  : slots(capacity + 1), head(0), tail(0)
+	{	}
+
+
+	/** \brief Append an element, waiting while the queue is full
+	 *
+	 * Must only be called by the producer thread.
+	 * */
+	void push(T&& value) {
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		std::size_t next = (t + 1) % slots.size();
+
+		for (unsigned int attempt = 0; next == head.load(std::memory_order_acquire); ++attempt) {
+			backOff(attempt);
+		}
+
+		slots[t] = std::move(value);
+		tail.store(next, std::memory_order_release);
+	}
+
+
+	/** \brief Remove the oldest element, waiting while the queue is empty
+	 *
+	 * Must only be called by the consumer thread.
+	 * */
+	void pop(T& value) {
+		std::size_t h = head.load(std::memory_order_relaxed);
+
+		for (unsigned int attempt = 0; h == tail.load(std::memory_order_acquire); ++attempt) {
+			backOff(attempt);
+		}
+
+		value = std::move(slots[h]);
+		head.store((h + 1) % slots.size(), std::memory_order_release);
+	}
+
+private:
+
+	//!< Spin, then yield, then sleep for increasingly long periods (up to 1 ms)
+	static void backOff(unsigned int attempt) {
+		if (attempt < 16) {
+			pause();
+		} else if (attempt < 64) {
+			std::this_thread::yield();
+		} else {
+			unsigned int shift = attempt - 64 < 10 ? attempt - 64 : 10;
+			std::this_thread::sleep_for(std::chrono::microseconds(1u << shift));
+		}
+	}
+
+
+	//!< Tell the processor the thread is spinning (frees the core for its sibling hyperthread)
+	static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+
+	//!< Ring buffer, with one unused slot to tell full from empty
+	std::vector<T> slots;
+
+
+	//!< Index of the next element to pop (written by the consumer)
+	std::atomic<std::size_t> head;
+
+
+	//!< Index of the next free slot (written by the producer)
+	std::atomic<std::size_t> tail;
+};
+
+#endif
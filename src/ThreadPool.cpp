@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include "ThreadPool.hpp"
+
+thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+thread_local unsigned int ThreadPool::currentWorker = 0;
+
+
+ThreadPool::ThreadPool(unsigned int nThreads)
+  : nQueued(0), nUnfinished(0), nextQueue(0), stopping(false)
+{
+	if (nThreads == 0) nThreads = 1;
+
+	for (unsigned int i = 0; i < nThreads; ++i) {
+		queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+	}
+
+	// the queues must all exist before any worker starts stealing
+	for (unsigned int i = 0; i < nThreads; ++i) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		stopping = true;
+	}
+	tasksAvailable.notify_all();
+
+	for (auto& worker : workers) worker.join();
+}
+
+
+void ThreadPool::submit(Task task) {
+	unsigned int idx = currentPool == this 
+		? currentWorker
+		: nextQueue++ % (unsigned int) queues.size();
+
+	// counted before it is pushed: a worker taking it at once must not wrap the counters
+	++nUnfinished;
+	++nQueued;
+	{
+		std::lock_guard<std::mutex> lock(queues[idx]->mutex);
+		queues[idx]->tasks.push_back(std::move(task));
+	}
+
+	// take the state lock so that a worker about to sleep cannot miss the task
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+	}
+	tasksAvailable.notify_one();
+}
+
+
+void ThreadPool::wait() {
+	assert(currentPool != this);
+
+	std::unique_lock<std::mutex> lock(stateMutex);
+	tasksDone.wait(lock, [this] { return nUnfinished == 0; });
+}
+
+
+void ThreadPool::parallelFor(std::size_t n, const std::function<void(std::size_t)>& body) {
+	if (n == 0) return;
+
+	std::atomic<std::size_t> nLeft(n);
+	for (std::size_t i = 1; i < n; ++i) {
+		submit([&body, &nLeft, i] {
+			body(i);
+			--nLeft;
+		});
+	}
+
+	body(0);
+	--nLeft;
+
+	// help with the iterations (or with other tasks) rather than sleep
+	unsigned int idx = currentPool == this ? currentWorker : 0;
+	while (nLeft > 0) {
+		if (!runPendingTask(idx)) std::this_thread::yield();
+	}
+}
+
+
+unsigned int ThreadPool::getNbThreads() const {
+	return (unsigned int) workers.size();
+}
+
+
+unsigned int ThreadPool::getAvailableConcurrency() {
+	unsigned int nCores = std::thread::hardware_concurrency();
+
+	// CPU quota of the cgroup, as a number of cores (0 for no quota)
+	double quota = 0.0;
+
+	// cgroup v2: "<quota> <period>" or "max <period>"
+	std::ifstream cpuMax("/sys/fs/cgroup/cpu.max");
+	if (cpuMax.is_open()) {
+		std::string quotaStr;
+		double period = 0.0;
+
+		if (cpuMax >> quotaStr >> period && quotaStr != "max" && period > 0.0) {
+			quota = std::stod(quotaStr) / period;
+		}
+	} else {
+		// cgroup v1: quota of -1 means no limit
+		std::ifstream cfsQuota("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+		std::ifstream cfsPeriod("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+		double quotaUs = -1.0, periodUs = 0.0;
+
+		if (cfsQuota >> quotaUs && cfsPeriod >> periodUs && quotaUs > 0.0 && periodUs > 0.0) {
+			quota = quotaUs / periodUs;
+		}
+	}
+
+	if (quota > 0.0) {
+		unsigned int quotaCores = (unsigned int) std::max(1.0, std::ceil(quota));
+
+		if (nCores == 0 || quotaCores < nCores) {
+			nCores = quotaCores;
+		}
+	}
+
+	return nCores;
+}
+
+
+void ThreadPool::workerLoop(unsigned int idx) {
+	currentPool = this;
+	currentWorker = idx;
+
+	while (true) {
+		if (runPendingTask(idx)) continue;
+
+		std::unique_lock<std::mutex> lock(stateMutex);
+		tasksAvailable.wait(lock, [this] { return stopping || nQueued > 0; });
+
+		if (stopping && nQueued == 0) return;
+	}
+}
+
+
+bool ThreadPool::runPendingTask(unsigned int idx) {
+	Task task;
+	unsigned int nQueues = (unsigned int) queues.size();
+
+	// own queue first (back), then steal from the others (front)
+	for (unsigned int i = 0; i < nQueues && !task; ++i) {
+		WorkerQueue& queue = *queues[(idx + i) % nQueues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.tasks.empty()) continue;
+
+		if (i == 0) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		} else {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+	}
+
+	if (!task) return false;
+
+	--nQueued;
+	task();
+
+	if (--nUnfinished == 0) {
+		std::lock_guard<std::mutex> lock(stateMutex);
+		tasksDone.notify_all();
+	}
+
+	return true;
+}
@@ -0,0 +1,166 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/** \brief Class representing a pool of persistent worker threads
+ *
+ * Every worker owns a double-ended queue of tasks. A worker takes its own
+ * tasks from the back (most recently submitted first) and, once its queue
+ * is empty, steals the oldest task from the front of another worker's queue.
+ * Uneven tasks therefore keep every core busy until the end of a run.
+ *
+ * */
+class ThreadPool {
+
+public:
+
+	typedef std::function<void()> Task;
+
+
+	/** \brief ThreadPool constructor
+	 *
+	 * Starts the worker threads, which live as long as the pool.
+	 *
+	 * \param nThreads		number of worker threads (at least 1)
+	 * */
+	explicit ThreadPool(unsigned int nThreads);
+
+
+	//!< Stops and joins the worker threads, after the queued tasks are done
+	~ThreadPool();
+
+
+	//!< The workers hold a pointer to the pool, we do not allow any copies
+	ThreadPool(const ThreadPool& other) = delete;
+
+
+	//!< The workers hold a pointer to the pool, we do not allow any copies
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+
+
+	/** \brief Queue a task
+	 *
+	 * From a worker thread, the task goes to the worker's own queue;
+	 * otherwise the tasks are dealt round-robin to the workers' queues.
+	 *
+	 * \param task			the task to execute
+	 * */
+	void submit(Task task);
+
+
+	/** \brief Wait until every submitted task is done
+	 *
+	 * Must not be called from a task running on the pool.
+	 * */
+	void wait();
+
+
+	/** \brief Run a loop on the pool and wait for it
+	 *
+	 * The iterations are queued as tasks, the calling thread runs the first
+	 * one, then runs pending tasks until every iteration is done. Unlike
+	 * \ref wait, it can thus be called from a task running on the pool, e.g.
+	 * to split a large replicate.
+	 *
+	 * \param n				number of iterations
+	 * \param body			the iteration, called with its index
+	 * */
+	void parallelFor(std::size_t n, const std::function<void(std::size_t)>& body);
+
+
+	/** \brief Get the number of worker threads
+	 * */
+	unsigned int getNbThreads() const;
+
+
+	/** \brief Get the number of threads the process may use
+	 *
+	 * Minimum of the hardware concurrency and of the CPU quota of the
+	 * process' cgroup (v1 or v2), if any.
+	 *
+	 * \return The number of usable cores, 0 if it could not be determined
+	 * */
+	static unsigned int getAvailableConcurrency();
+
+protected:
+
+	/** \brief Main loop of the worker threads
+	 *
+	 * \param idx			index of the worker (and of its queue)
+	 * */
+	void workerLoop(unsigned int idx);
+
+
+	/** \brief Execute one pending task, if any
+	 *
+	 * Pops from the back of queue \p idx, then steals from the front of the others.
+	 *
+	 * \param idx			index of the queue to look at first
+	 *
+	 * \return true if a task was executed
+	 * */
+	bool runPendingTask(unsigned int idx);
+
+private:
+
+	//!< Task queue of a worker, protected by its own mutex
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+
+	//!< One queue per worker
+	std::vector< std::unique_ptr<WorkerQueue> > queues;
+
+
+	//!< Worker threads
+	std::vector<std::thread> workers;
+
+
+	//!< Number of tasks in the queues (not started yet)
+	std::atomic<unsigned int> nQueued;
+
+
+	//!< Number of submitted tasks not finished yet
+	std::atomic<unsigned int> nUnfinished;
+
+
+	//!< Queue to submit the next external task to
+	std::atomic<unsigned int> nextQueue;
+
+
+	//!< Flag telling the workers to exit
+	bool stopping;
+
+
+	//!< Mutex protecting the sleeping and waiting states
+	std::mutex stateMutex;
+
+
+	//!< Signalled when tasks are submitted
+	std::condition_variable tasksAvailable;
+
+
+	//!< Signalled when the last unfinished task is done
+	std::condition_variable tasksDone;
+
+
+	//!< Pool the calling thread is a worker of, if any
+	static thread_local ThreadPool* currentPool;
+
+
+	//!< Index of the calling worker thread in its pool
+	static thread_local unsigned int currentWorker;
+};
+
+#endif
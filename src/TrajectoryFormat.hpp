@@ -0,0 +1,67 @@
+#ifndef TRAJECTORY_FORMAT_H
+#define TRAJECTORY_FORMAT_H
+
+#include <cstdint>
+
+/** \brief Layout of the binary trajectory file (results.bin)
+ *
+ * The file stores the raw allele counts of every replicate, in the host's
+ * byte order, as fixed-width integer columns:
+ *
+ * - a \ref TrajectoryHeader, at offset 0
+ * - for every recorded step, one column per output column (allele, or
+ *   deme x allele for detailed migration output), each column holding
+ *   the counts of the nReplicates replicates
+ * - the step table: one \ref TrajectoryStep per recorded step
+ * - the allele identifiers of every replicate: for each replicate, a
+ *   uint32 number of alleles followed by (uint32 length, characters) pairs
+ * - the run parameters, as the text of the input file
+ *
+ * Columns of a step that a replicate does not have (e.g. alleles that
+ * appear later in mutation mode) are stored as 0. Every section starts on
+ * an 8-byte boundary.
+ *
+ * */
+namespace Trajectory {
+
+	//!< Magic bytes at the start of every trajectory file
+	const char magic[8] = { 'P', 'O', 'P', 'G', 'E', 'N', 'T', 'R' };
+
+
+	//!< Current version of the format
+	const std::uint32_t version = 1;
+
+
+	//!< Fixed-size header of the file
+	struct Header {
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t countWidth;		//!< size in bytes of a count
+		std::uint32_t executionMode;
+		std::uint32_t nReplicates;
+		std::uint32_t nDemes;			//!< demes per line (1 unless detailed migration output)
+		std::uint32_t reserved;
+		std::uint64_t seed;
+		std::uint64_t nSteps;
+		std::uint64_t stepsOffset;		//!< offset of the step table
+		std::uint64_t allelesOffset;	//!< offset of the allele identifiers
+		std::uint64_t allelesSize;
+		std::uint64_t parametersOffset;	//!< offset of the run parameters
+		std::uint64_t parametersSize;
+	};
+
+
+	//!< Entry of the step table
+	struct Step {
+		std::int64_t step;				//!< generation of the step
+		std::uint64_t dataOffset;		//!< offset of the first column of the step
+		std::uint64_t populationSize;	//!< total population size at that step
+		std::uint32_t nColumns;			//!< number of columns of the step
+		std::uint32_t reserved;
+	};
+
+	static_assert(sizeof(Header) == 88, "unexpected padding in the trajectory header");
+	static_assert(sizeof(Step) == 32, "unexpected padding in the trajectory step table");
+}
+
+#endif
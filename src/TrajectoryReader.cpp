@@ -0,0 +1,156 @@
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "TrajectoryReader.hpp"
+
+
+TrajectoryReader::TrajectoryReader(const std::string& fileName)
+  : mapping(nullptr), mappingSize(0), header(nullptr), steps(nullptr)
+{
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Trajectory file impossible to open: " + fileName);
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (std::size_t) info.st_size < sizeof(Trajectory::Header)) {
+		close(fd);
+		throw std::runtime_error("Trajectory file too short: " + fileName);
+	}
+
+	mappingSize = (std::size_t) info.st_size;
+	void* addr = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (addr == MAP_FAILED) {
+		throw std::runtime_error("Trajectory file impossible to map: " + fileName);
+	}
+
+	mapping = static_cast<const char*>(addr);
+	header = reinterpret_cast<const Trajectory::Header*>(mapping);
+
+	try {
+		if (std::memcmp(header->magic, Trajectory::magic, sizeof(Trajectory::magic)) != 0
+			|| header->version != Trajectory::version
+			|| header->countWidth != sizeof(std::uint32_t)) {
+			throw std::runtime_error("Not a trajectory file (or unsupported version): " + fileName);
+		}
+
+		checkBounds(header->stepsOffset, header->nSteps * sizeof(Trajectory::Step));
+		checkBounds(header->allelesOffset, header->allelesSize);
+		checkBounds(header->parametersOffset, header->parametersSize);
+		steps = reinterpret_cast<const Trajectory::Step*>(mapping + header->stepsOffset);
+
+		for (std::uint64_t i = 0; i < header->nSteps; ++i) {
+			checkBounds(steps[i].dataOffset, (std::uint64_t) steps[i].nColumns * header->nReplicates * header->countWidth);
+		}
+
+		// decode the allele identifiers
+		const char* cursor = mapping + header->allelesOffset;
+		const char* end = cursor + header->allelesSize;
+		auto readUint32 = [&]() -> std::uint32_t {
+			if (end - cursor < (std::ptrdiff_t) sizeof(std::uint32_t))
+				throw std::runtime_error("Truncated allele table in " + fileName);
+
+			std::uint32_t value;
+			std::memcpy(&value, cursor, sizeof(value));
+			cursor += sizeof(value);
+			return value;
+		};
+
+		alleles.resize(header->nReplicates);
+		for (auto& replicate : alleles) {
+			std::uint32_t nAlleles = readUint32();
+
+			for (std::uint32_t a = 0; a < nAlleles; ++a) {
+				std::uint32_t length = readUint32();
+				if (end - cursor < (std::ptrdiff_t) length)
+					throw std::runtime_error("Truncated allele table in " + fileName);
+
+				replicate.push_back(std::string(cursor, length));
+				cursor += length;
+			}
+		}
+	} catch (...) {
+		munmap(const_cast<char*>(mapping), mappingSize);
+		throw;
+	}
+}
+
+
+TrajectoryReader::~TrajectoryReader() {
+	munmap(const_cast<char*>(mapping), mappingSize);
+}
+
+
+std::size_t TrajectoryReader::getNbReplicates() const {
+	return header->nReplicates;
+}
+
+
+std::size_t TrajectoryReader::getNbDemes() const {
+	return header->nDemes;
+}
+
+
+int TrajectoryReader::getExecutionMode() const {
+	return (int) header->executionMode;
+}
+
+
+unsigned long long TrajectoryReader::getSeed() const {
+	return header->seed;
+}
+
+
+std::string TrajectoryReader::getParameters() const {
+	return std::string(mapping + header->parametersOffset, header->parametersSize);
+}
+
+
+std::size_t TrajectoryReader::getNbSteps() const {
+	return header->nSteps;
+}
+
+
+long long TrajectoryReader::getGeneration(std::size_t step) const {
+	return steps[step].step;
+}
+
+
+unsigned long long TrajectoryReader::getPopulationSize(std::size_t step) const {
+	return steps[step].populationSize;
+}
+
+
+std::size_t TrajectoryReader::getNbColumns(std::size_t step) const {
+	return steps[step].nColumns;
+}
+
+
+const std::uint32_t* TrajectoryReader::getColumn(std::size_t step, std::size_t column) const {
+	const std::uint32_t* data = reinterpret_cast<const std::uint32_t*>(mapping + steps[step].dataOffset);
+	return data + column * header->nReplicates;
+}
+
+
+std::uint32_t TrajectoryReader::getCount(std::size_t step, std::size_t replicate, std::size_t column) const {
+	if (column >= steps[step].nColumns) return 0;
+
+	return getColumn(step, column)[replicate];
+}
+
+
+const std::vector<std::string>& TrajectoryReader::getAlleles(std::size_t replicate) const {
+	return alleles[replicate];
+}
+
+
+void TrajectoryReader::checkBounds(std::uint64_t offset, std::uint64_t size) const {
+	if (offset > mappingSize || size > mappingSize - offset) {
+		throw std::runtime_error("Corrupted trajectory file: section out of bounds");
+	}
+}
@@ -0,0 +1,146 @@
+#ifndef TRAJECTORY_READER_H
+#define TRAJECTORY_READER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TrajectoryFormat.hpp"
+
+
+/** \brief Class reading a binary trajectory file
+ *
+ * The file is memory-mapped: the count columns are accessed in place,
+ * without copying or parsing them. Only the allele identifiers are
+ * decoded when the file is opened.
+ * Throws std::runtime_error if the file can not be mapped or is not a
+ * valid trajectory file.
+ *
+ * */
+class TrajectoryReader {
+
+public:
+
+	/** \brief TrajectoryReader constructor
+	 *
+	 * \param fileName		path of the file to read
+	 * */
+	explicit TrajectoryReader(const std::string& fileName);
+
+
+	//!< Unmaps the file
+	~TrajectoryReader();
+
+
+	//!< The reader owns the mapping, we do not allow any copies
+	TrajectoryReader(const TrajectoryReader& other) = delete;
+
+
+	//!< The reader owns the mapping, we do not allow any copies
+	TrajectoryReader& operator=(const TrajectoryReader& other) = delete;
+
+
+	/** \brief Get the number of replicates
+	 * */
+	std::size_t getNbReplicates() const;
+
+
+	/** \brief Get the number of demes per line (1 unless detailed migration output)
+	 * */
+	std::size_t getNbDemes() const;
+
+
+	/** \brief Get the execution mode of the run
+	 * */
+	int getExecutionMode() const;
+
+
+	/** \brief Get the global seed of the run
+	 * */
+	unsigned long long getSeed() const;
+
+
+	/** \brief Get the run parameters (text of the input file)
+	 * */
+	std::string getParameters() const;
+
+
+	/** \brief Get the number of recorded steps
+	 * */
+	std::size_t getNbSteps() const;
+
+
+	/** \brief Get the generation of a recorded step
+	 *
+	 * \param step			index of the step in the file
+	 * */
+	long long getGeneration(std::size_t step) const;
+
+
+	/** \brief Get the total population size at a recorded step
+	 *
+	 * \param step			index of the step in the file
+	 * */
+	unsigned long long getPopulationSize(std::size_t step) const;
+
+
+	/** \brief Get the number of columns of a recorded step
+	 *
+	 * \param step			index of the step in the file
+	 * */
+	std::size_t getNbColumns(std::size_t step) const;
+
+
+	/** \brief Get a count column, in place
+	 *
+	 * \param step			index of the step in the file
+	 * \param column		index of the column (allele, or deme * nAlleles + allele)
+	 *
+	 * \return A pointer on the counts of the getNbReplicates() replicates
+	 * */
+	const std::uint32_t* getColumn(std::size_t step, std::size_t column) const;
+
+
+	/** \brief Get one count
+	 *
+	 * \param step			index of the step in the file
+	 * \param replicate		index of the replicate
+	 * \param column		index of the column
+	 *
+	 * \return The count, 0 for a column the step does not have
+	 * */
+	std::uint32_t getCount(std::size_t step, std::size_t replicate, std::size_t column) const;
+
+
+	/** \brief Get the allele identifiers of a replicate
+	 *
+	 * \param replicate		index of the replicate
+	 * */
+	const std::vector<std::string>& getAlleles(std::size_t replicate) const;
+
+private:
+
+	//!< Check that a section lies within the file
+	void checkBounds(std::uint64_t offset, std::uint64_t size) const;
+
+
+	//!< Start of the mapping
+	const char* mapping;
+
+
+	//!< Size of the mapping
+	std::size_t mappingSize;
+
+
+	//!< Header, in place
+	const Trajectory::Header* header;
+
+
+	//!< Step table, in place
+	const Trajectory::Step* steps;
+
+
+	//!< Decoded allele identifiers
+	std::vector< std::vector<std::string> > alleles;
+};
+
+#endif
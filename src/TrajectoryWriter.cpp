@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include "TrajectoryWriter.hpp"
+#include "Globals.hpp"
+
+
+TrajectoryWriter::TrajectoryWriter(const std::string& fileName, int nReplicates, int nDemes,
+								   int executionMode, unsigned long long seed, const std::string& params)
+  : file(fileName, std::ofstream::binary), parameters(params)
+{
+	if (!file.is_open()) {
+		std::cerr << _ERROR_BINARY_OUTPUT_UNWRITABLE_MSG_ << std::endl;
+		exit(_ERROR_BINARY_OUTPUT_UNWRITABLE_CODE_);
+	}
+
+	initHeader(nReplicates, nDemes, executionMode, seed);
+
+	// placeholder, rewritten on close
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+
+TrajectoryWriter::TrajectoryWriter(const std::string& fileName, int nReplicates, int nDemes,
+								   int executionMode, unsigned long long seed, const std::string& params,
+								   const std::vector<Trajectory::Step>& resumedSteps, std::uint64_t size)
+  : steps(resumedSteps), parameters(params)
+{
+	// the tables written on close follow the last step again
+	if (truncate(fileName.c_str(), (off_t) size) != 0) {
+		std::cerr << _ERROR_BINARY_OUTPUT_UNWRITABLE_MSG_ << std::endl;
+		exit(_ERROR_BINARY_OUTPUT_UNWRITABLE_CODE_);
+	}
+
+	file.open(fileName, std::ofstream::binary | std::ofstream::in | std::ofstream::out);
+	if (!file.is_open()) {
+		std::cerr << _ERROR_BINARY_OUTPUT_UNWRITABLE_MSG_ << std::endl;
+		exit(_ERROR_BINARY_OUTPUT_UNWRITABLE_CODE_);
+	}
+
+	initHeader(nReplicates, nDemes, executionMode, seed);
+	file.seekp((std::streamoff) size);
+}
+
+
+void TrajectoryWriter::writeStep(int step, unsigned long long populationSize,
+								 const std::vector< std::vector<unsigned int> >& counts) {
+	assert(counts.size() == header.nReplicates);
+
+	std::size_t nReplicates = counts.size();
+	std::size_t nColumns = 0;
+	for (auto& replicate : counts)
+		nColumns = std::max(nColumns, replicate.size());
+
+	// transpose to one column of replicates per allele
+	columns.assign(nColumns * nReplicates, 0);
+	for (std::size_t r = 0; r < nReplicates; ++r) {
+		for (std::size_t c = 0; c < counts[r].size(); ++c) {
+			columns[c * nReplicates + r] = counts[r][c];
+		}
+	}
+
+	align();
+
+	Trajectory::Step entry;
+	entry.step = step;
+	entry.dataOffset = (std::uint64_t) file.tellp();
+	entry.populationSize = populationSize;
+	entry.nColumns = (std::uint32_t) nColumns;
+	entry.reserved = 0;
+	steps.push_back(entry);
+
+	file.write(reinterpret_cast<const char*>(columns.data()), (std::streamsize) (columns.size() * sizeof(std::uint32_t)));
+}
+
+
+std::uint64_t TrajectoryWriter::flush() {
+	file.flush();
+	return (std::uint64_t) file.tellp();
+}
+
+
+const std::vector<Trajectory::Step>& TrajectoryWriter::getSteps() const {
+	return steps;
+}
+
+
+void TrajectoryWriter::close(const std::vector< std::vector<std::string> >& alleles) {
+	assert(alleles.size() == header.nReplicates);
+
+	// step table
+	align();
+	header.nSteps = steps.size();
+	header.stepsOffset = (std::uint64_t) file.tellp();
+	file.write(reinterpret_cast<const char*>(steps.data()), (std::streamsize) (steps.size() * sizeof(Trajectory::Step)));
+
+	// allele identifiers
+	align();
+	header.allelesOffset = (std::uint64_t) file.tellp();
+	for (auto& replicate : alleles) {
+		std::uint32_t nAlleles = (std::uint32_t) replicate.size();
+		file.write(reinterpret_cast<const char*>(&nAlleles), sizeof(nAlleles));
+
+		for (auto& allele : replicate) {
+			std::uint32_t length = (std::uint32_t) allele.size();
+			file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+			file.write(allele.data(), (std::streamsize) length);
+		}
+	}
+	header.allelesSize = (std::uint64_t) file.tellp() - header.allelesOffset;
+
+	// run parameters
+	align();
+	header.parametersOffset = (std::uint64_t) file.tellp();
+	header.parametersSize = parameters.size();
+	file.write(parameters.data(), (std::streamsize) parameters.size());
+
+	// complete the header
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.close();
+}
+
+
+void TrajectoryWriter::initHeader(int nReplicates, int nDemes, int executionMode, unsigned long long seed) {
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, Trajectory::magic, sizeof(header.magic));
+	header.version = Trajectory::version;
+	header.countWidth = sizeof(std::uint32_t);
+	header.executionMode = (std::uint32_t) executionMode;
+	header.nReplicates = (std::uint32_t) nReplicates;
+	header.nDemes = (std::uint32_t) nDemes;
+	header.seed = seed;
+}
+
+
+void TrajectoryWriter::align() {
+	static const char zeroes[8] = { 0 };
+
+	std::streamoff misalignment = file.tellp() % 8;
+	if (misalignment != 0) {
+		file.write(zeroes, 8 - misalignment);
+	}
+}
@@ -0,0 +1,106 @@
+#ifndef TRAJECTORY_WRITER_H
+#define TRAJECTORY_WRITER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "TrajectoryFormat.hpp"
+
+
+/** \brief Class writing the binary trajectory file
+ *
+ * The steps are appended as they come; the tables describing them are
+ * written, and the header completed, when the file is closed.
+ * See TrajectoryFormat.hpp for the layout.
+ *
+ * */
+class TrajectoryWriter {
+
+public:
+
+	/** \brief TrajectoryWriter constructor
+	 *
+	 * Opens the file and reserves space for the header.
+	 *
+	 * \param fileName			path of the file to write
+	 * \param nReplicates		number of replicates of the run
+	 * \param nDemes			number of demes per line (1 unless detailed migration output)
+	 * \param executionMode		execution mode of the run
+	 * \param seed				global seed of the run
+	 * \param parameters		the run parameters (text of the input file)
+	 * */
+	TrajectoryWriter(const std::string& fileName, int nReplicates, int nDemes,
+					 int executionMode, unsigned long long seed, const std::string& parameters);
+
+
+	/** \brief TrajectoryWriter constructor, resuming an interrupted file
+	 *
+	 * The file is cut after the steps already written, which are kept.
+	 *
+	 * \param steps				the steps already written (see \ref getSteps)
+	 * \param size				the size of the file after them (see \ref flush)
+	 * */
+	TrajectoryWriter(const std::string& fileName, int nReplicates, int nDemes,
+					 int executionMode, unsigned long long seed, const std::string& parameters,
+					 const std::vector<Trajectory::Step>& steps, std::uint64_t size);
+
+
+	/** \brief Append a step to the file
+	 *
+	 * \param step				generation of the step
+	 * \param populationSize	total population size at that step
+	 * \param counts			allele counts, indexed by [replicate][column]
+	 * */
+	void writeStep(int step, unsigned long long populationSize,
+				   const std::vector< std::vector<unsigned int> >& counts);
+
+
+	/** \brief Write the steps appended so far to the disk
+	 *
+	 * \return The size of the file
+	 * */
+	std::uint64_t flush();
+
+
+	/** \brief Get the steps appended so far
+	 * */
+	const std::vector<Trajectory::Step>& getSteps() const;
+
+
+	/** \brief Write the tables and the header, and close the file
+	 *
+	 * \param alleles			allele identifiers, indexed by [replicate][allele]
+	 * */
+	void close(const std::vector< std::vector<std::string> >& alleles);
+
+private:
+
+	//!< Set up the header of the run
+	void initHeader(int nReplicates, int nDemes, int executionMode, unsigned long long seed);
+
+
+	//!< Pad the file with zeroes up to the next 8-byte boundary
+	void align();
+
+
+	//!< Output file
+	std::ofstream file;
+
+
+	//!< Header, completed on close
+	Trajectory::Header header;
+
+
+	//!< Step table, written on close
+	std::vector<Trajectory::Step> steps;
+
+
+	//!< Run parameters, written on close
+	std::string parameters;
+
+
+	//!< Buffer for the columns of one step
+	std::vector<std::uint32_t> columns;
+};
+
+#endif
@@ -1,13 +1,42 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
 #include "SimulationsExecutor.hpp"
+#include "ParameterSweep.hpp"
 #include "Data.hpp"
 
 
 int main(int argc, char** argv) {
-	std::string inputFileName = argc > 1 ? argv[1] : "../data/input.txt";	
-	std::string fastaFileName = argc > 2 ? argv[2] : "";
-	
-	SimulationsExecutor simulationsExecutor(inputFileName, fastaFileName);
-	simulationsExecutor.execute();
+	// --resume and --shard i/n may come anywhere, the other arguments are the input and fasta files
+	bool resume = false;
+	int shard = 0, nShards = 0;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--resume") == 0) {
+			resume = true;
+		} else if (std::strcmp(argv[i], "--shard") == 0) {
+			// an unreadable shard is rejected by the executor
+			if (i + 1 >= argc || std::sscanf(argv[++i], "%d/%d", &shard, &nShards) != 2) {
+				shard = nShards = -1;
+			}
+		} else {
+			files.push_back(argv[i]);
+		}
+	}
+
+	std::string inputFileName = files.size() > 0 ? files[0] : "../data/input.txt";	
+	std::string fastaFileName = files.size() > 1 ? files[1] : "";
+
+	Data data(inputFileName, fastaFileName);
+
+	// parameter ranges in the input file make the run a sweep (which is not sharded)
+	if (!data.getSweptLines().empty() && nShards == 0) {
+		ParameterSweep sweep(data, resume);
+		sweep.execute();
+	} else {
+		SimulationsExecutor simulationsExecutor(data, resume, shard, nShards);
+		simulationsExecutor.execute();
+	}
 	
 	return 0;
 }
@@ -0,0 +1,23 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include "ShardMerger.hpp"
+
+
+// merges the output of the n shards of a run: ./GeneticsMerge n [directory of the shard files]
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " nShards [directory]" << std::endl;
+		return 1;
+	}
+
+	try {
+		ShardMerger merger(std::atoi(argv[1]), argc > 2 ? argv[2] : ".");
+		merger.merge();
+	} catch (const std::runtime_error& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -1,7 +1,28 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+#include <iomanip>
+#include <map>
+#include <numeric>
+#include <sstream>
 #include "../src/Random.hpp"
+#include "../src/Binomial.hpp"
+#include "../src/AliasTable.hpp"
+#include "../src/SparseHaplotypes.hpp"
+#include "../src/FrequencyFormatter.hpp"
+#include "../src/AlleleDictionary.hpp"
+#include "../src/ThreadPool.hpp"
+#include "../src/TrajectoryReader.hpp"
+#include "../src/ReplicateStatistics.hpp"
 #include "../src/Data.hpp"
 #include "../src/SimulationsExecutor.hpp"
+#include "../src/ShardMerger.hpp"
+#include "../src/ParameterSweep.hpp"
+#include "../src/MigrationGraph.hpp"
+#include "../src/Demography.hpp"
 
 using namespace std;
 
@@ -56,6 +77,13 @@ TEST(DataReading, NumberReplicates) {
 }
 
 
+TEST(DataReading, Seed) {
+	Data data("../data/test_input.txt","../data/test.fa");
+
+	EXPECT_EQ(data.getSeed(), 42ULL);
+}
+
+
 TEST(DataReading, NucleotidesMutations) {
 	Data data("../data/test_input.txt","../data/test.fa");
 
@@ -119,6 +147,357 @@ TEST(RandomTest, NormalDistribution) {
 	EXPECT_NEAR(input_mean, mean_normal, 4 * input_sd / sqrt(1e4));
 }
 
+TEST(RandomTest, PhiloxKnownAnswer) {
+	// reference vector of the Random123 library (zero counter, zero key)
+	std::array<uint32_t, 4> expected = { { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } };
+
+	EXPECT_EQ(RandomEngine::philox({ { 0, 0, 0, 0 } }, { { 0, 0 } }), expected);
+
+	RandomEngine engine(0, 0);
+	for (auto& word : expected) {
+		EXPECT_EQ(engine(), word);
+	}
+}
+
+
+TEST(RandomTest, IndependentStreams) {
+	RandomEngine a(42, 7), b(42, 7), c(42, 8), d(43, 7);
+
+	int differentStream = 0, differentSeed = 0;
+	for (int i = 0; i < 1000; ++i) {
+		uint32_t x = a();
+
+		EXPECT_EQ(x, b());
+		if (x != c()) ++differentStream;
+		if (x != d()) ++differentSeed;
+	}
+
+	EXPECT_GT(differentStream, 990);
+	EXPECT_GT(differentSeed, 990);
+}
+
+
+TEST(RandomTest, Discard) {
+	RandomEngine a(42, 3), b(42, 3);
+
+	for (int i = 0; i < 7; ++i) a();
+	b.discard(7);
+	EXPECT_EQ(a(), b());
+
+	for (int i = 0; i < 1000; ++i) a();
+	b.discard(1000);
+	EXPECT_EQ(a(), b());
+}
+
+
+TEST(RandomTest, BinomialSampler) {
+	RandomEngine engine(42, 0);
+
+	// exact cases draw nothing
+	EXPECT_EQ(Binomial(0, 0.3)(engine), 0);
+	EXPECT_EQ(Binomial(10, 0.0)(engine), 0);
+	EXPECT_EQ(Binomial(10, 1.0)(engine), 10);
+	EXPECT_EQ(engine(), RandomEngine(42, 0)());
+
+	// inversion, BTRD, and both of them for p > 0.5
+	std::vector< std::pair<int, double> > params = { { 20, 0.1 }, { 5000, 0.8 }, { 1000000, 0.01 }, { 30, 0.9 } };
+	int nDraws = 100000;
+
+	for (auto& np : params) {
+		Binomial binomial(np.first, np.second);
+		double mean = 0.0, m2 = 0.0;
+
+		for (int i = 0; i < nDraws; ++i) {
+			int x = binomial(engine);
+			ASSERT_GE(x, 0);
+			ASSERT_LE(x, np.first);
+
+			mean += x;
+			m2 += (double) x * x;
+		}
+
+		mean /= nDraws;
+		double variance = m2 / nDraws - mean * mean;
+		double expectedVariance = np.first * np.second * (1 - np.second);
+
+		EXPECT_NEAR(mean, np.first * np.second, 5 * sqrt(expectedVariance / nDraws));
+		EXPECT_NEAR(variance, expectedVariance, 0.05 * expectedVariance);
+	}
+
+	// a reused sampler draws the same as a new one
+	RandomEngine a(7, 1), b(7, 1);
+	Binomial reused;
+	for (int i = 0; i < 100; ++i) {
+		reused.param(5000, 0.3);
+		EXPECT_EQ(reused(a), Binomial(5000, 0.3)(b));
+	}
+}
+
+
+TEST(RandomTest, DiffusionApproximation) {
+	RandomEngine engine(42, 0);
+
+	// census-sized population: Gaussian draws of the same mean and variance
+	int n = 1000000000;
+	double p = 0.3;
+	Binomial diffusion(n, p, 1000.0);
+	double mean = 0.0, m2 = 0.0;
+	int nDraws = 100000;
+
+	for (int i = 0; i < nDraws; ++i) {
+		int x = diffusion(engine);
+		ASSERT_GE(x, 0);
+		ASSERT_LE(x, n);
+
+		mean += x;
+		m2 += (double) x * x;
+	}
+
+	mean /= nDraws;
+	double variance = m2 / nDraws - mean * mean;
+	double expectedVariance = n * p * (1 - p);
+
+	EXPECT_NEAR(mean, n * p, 5 * sqrt(expectedVariance / nDraws));
+	EXPECT_NEAR(variance, expectedVariance, 0.05 * expectedVariance);
+
+	// the rare alleles keep their exact draws
+	RandomEngine a(7, 1), b(7, 1);
+	for (int i = 0; i < 100; ++i) {
+		EXPECT_EQ(Binomial(n, 1E-7, 1000.0)(a), Binomial(n, 1E-7)(b));
+	}
+
+	// the boundaries are never crossed
+	Binomial edge(2000, 0.5, 1.0);
+	for (int i = 0; i < 1000; ++i) {
+		int x = edge(engine);
+		EXPECT_GE(x, 0);
+		EXPECT_LE(x, 2000);
+	}
+}
+
+
+TEST(RandomTest, SparseMultinomial) {
+	RandomEngine engine(42, 0);
+	std::vector<unsigned int> pop = { 0, 10, 0, 0, 90, 0 };
+	std::vector<std::size_t> active = { 0, 1, 2, 3, 4, 5 };
+
+	// the extinct alleles are not drawn, the last allele present takes the rest
+	EXPECT_EQ(RandomDist::multinomial(pop, 100, active, engine), 5);
+	EXPECT_EQ(pop[0] + pop[2] + pop[3] + pop[5], 0u);
+	EXPECT_EQ(pop[1] + pop[4], 100u);
+
+	// the list loses the extinct alleles and is sorted by descending parent count
+	EXPECT_EQ(active, std::vector<std::size_t>({ 4, 1 }));
+
+	// same offspring as the full multinomial
+	std::vector<unsigned int> full = { 0, 10, 0, 0, 90, 0 };
+	std::vector<unsigned int> sparse = full;
+	std::vector<std::size_t> all = { 0, 1, 2, 3, 4, 5 };
+	RandomEngine a(7, 3), b(7, 3);
+	RandomDist::multinomial(full, 100, a);
+	RandomDist::multinomial(sparse, 100, all, b);
+	EXPECT_EQ(full, sparse);
+}
+
+
+TEST(RandomTest, ReproducibleSimulation) {
+	Simulation simul1({ "1", "2", "3" }, { 30, 30, 40 });
+	Simulation simul2({ "1", "2", "3" }, { 30, 30, 40 });
+
+	simul1.setRandomStream(42, 5);
+	simul2.setRandomStream(42, 5);
+
+	for (int t = 0; t < 100; ++t) {
+		simul1.update(t);
+		simul2.update(t);
+
+		EXPECT_EQ(simul1.getAllelesCount(), simul2.getAllelesCount());
+	}
+}
+
+
+TEST(ThreadPoolTest, RunsEveryTask) {
+	ThreadPool pool(3);
+	std::vector<int> slots(1000, 0);
+
+	// two rounds on the same workers
+	for (int round = 1; round <= 2; ++round) {
+		for (int i = 0; i < (int) slots.size(); ++i) {
+			pool.submit([&slots, i, round] {
+				// uneven tasks
+				volatile int spin = 0;
+				for (int j = 0; j < (i % 7) * 1000; ++j) spin = spin + 1;
+
+				slots[i] += round;
+			});
+		}
+
+		pool.wait();
+	}
+
+	for (auto& slot : slots) {
+		EXPECT_EQ(slot, 3);
+	}
+}
+
+
+TEST(ThreadPoolTest, NestedSubmit) {
+	ThreadPool pool(2);
+	std::atomic<int> count(0);
+
+	for (int i = 0; i < 10; ++i) {
+		pool.submit([&pool, &count] {
+			for (int j = 0; j < 10; ++j) {
+				pool.submit([&count] { ++count; });
+			}
+		});
+	}
+
+	pool.wait();
+	EXPECT_EQ(count, 100);
+}
+
+
+TEST(ThreadPoolTest, ParallelFor) {
+	ThreadPool pool(3);
+	std::vector<int> slots(100, 0);
+
+	// from tasks running on the pool, as a replicate splitting its demes
+	for (int task = 0; task < 4; ++task) {
+		pool.submit([&pool, &slots, task] {
+			pool.parallelFor(25, [&slots, task](std::size_t i) {
+				slots[task * 25 + i] += task + 1;
+			});
+		});
+	}
+
+	pool.wait();
+	for (int i = 0; i < (int) slots.size(); ++i) {
+		EXPECT_EQ(slots[i], i / 25 + 1);
+	}
+}
+
+
+TEST(OutputTest, FrequencyFormatter) {
+	auto expected = [](std::size_t precision, unsigned long long count, unsigned long long n) {
+		std::stringstream ss;
+		ss << std::setprecision((int) precision) << std::fixed << count * 1.0 / n;
+		return ss.str();
+	};
+
+	// every frequency of the small populations, ties included (e.g. 1/8, 1/200)
+	for (std::size_t precision : { 0, 2, 3, 6 }) {
+		for (unsigned long long n = 1; n <= 400; ++n) {
+			FrequencyFormatter formatter(precision, n);
+
+			for (unsigned long long count = 0; count <= n; ++count) {
+				std::string out;
+				formatter.append(out, count);
+				ASSERT_EQ(out, expected(precision, count, n)) << count << " / " << n;
+			}
+		}
+	}
+
+	// large populations and precisions, formatted by snprintf past the exact range
+	RandomEngine engine(3, 0);
+	for (unsigned long long n : { 1000000ULL, 1000000000ULL, 10000000000ULL }) {
+		for (std::size_t precision : { 2, 8, 15, 40 }) {
+			FrequencyFormatter formatter(precision, n);
+
+			for (int i = 0; i < 1000; ++i) {
+				unsigned long long count = (((unsigned long long) engine() << 32) | engine()) % (n + 1);
+				std::string out;
+				formatter.append(out, count);
+				ASSERT_EQ(out, expected(precision, count, n)) << count << " / " << n;
+			}
+		}
+	}
+}
+
+
+// runs a small simulation and returns the content of the result file
+static std::string runExecutor(const std::string& extraParams, bool resume = false) {
+	std::ofstream input("executor_test_input.txt");
+	input << "GEN = 50\nREP = 10\nPOPSIZE = 100\nFREQ = 0.3|0.3|0.4\nMODE = 0\nSEED = 7\nBATCH = 2\n" << extraParams;
+	input.close();
+
+	SimulationsExecutor executor("executor_test_input.txt", "", resume);
+	executor.execute();
+
+	std::ifstream results("results.txt");
+	std::stringstream ss;
+	ss << results.rdbuf();
+
+	return ss.str();
+}
+
+
+static std::string readFile(const std::string& fileName) {
+	std::ifstream in(fileName);
+	std::stringstream ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+
+TEST(ExecutorTest, DeterministicWhateverThreadCount) {
+	std::string oneThread = runExecutor("THREADS = 1\n");
+	std::string threeThreads = runExecutor("THREADS = 3\n");
+
+	EXPECT_FALSE(oneThread.empty());
+	EXPECT_EQ(oneThread, threeThreads);
+}
+
+
+TEST(ExecutorTest, OutputIndependentOfBlockSize) {
+	std::string smallBlocks = runExecutor("OUTPUT_BLOCK = 7\nTHREADS = 2\n");
+	std::string singleBlock = runExecutor("OUTPUT_BLOCK = 1000\nTHREADS = 2\n");
+
+	EXPECT_EQ(smallBlocks, singleBlock);
+
+	// initial line, 50 generations and the allele identifiers
+	EXPECT_EQ(std::count(smallBlocks.begin(), smallBlocks.end(), '\n'), 52);
+}
+
+
+TEST(ExecutorTest, BinaryOutput) {
+	runExecutor("OUTPUT_BINARY = 1\nOUTPUT_BLOCK = 7\n");
+
+	TrajectoryReader reader("results.bin");
+
+	EXPECT_EQ(reader.getNbReplicates(), 10u);
+	EXPECT_EQ(reader.getNbSteps(), 51u);
+	EXPECT_EQ(reader.getSeed(), 7u);
+	EXPECT_NE(reader.getParameters().find("SEED=7"), std::string::npos);
+
+	std::vector<std::string> alleles = { "0", "1", "2" };
+	std::vector<std::uint32_t> initialCounts = { 30, 30, 40 };
+
+	for (size_t step = 0; step < reader.getNbSteps(); ++step) {
+		EXPECT_EQ(reader.getGeneration(step), (long long) step);
+		EXPECT_EQ(reader.getPopulationSize(step), 100u);
+		ASSERT_EQ(reader.getNbColumns(step), 3u);
+
+		for (size_t r = 0; r < reader.getNbReplicates(); ++r) {
+			std::uint32_t total = 0;
+			for (size_t a = 0; a < 3; ++a) {
+				total += reader.getCount(step, r, a);
+
+				if (step == 0) {
+					EXPECT_EQ(reader.getColumn(step, a)[r], initialCounts[a]);
+				}
+			}
+
+			EXPECT_EQ(total, 100u);
+		}
+	}
+
+	for (size_t r = 0; r < reader.getNbReplicates(); ++r) {
+		EXPECT_EQ(reader.getAlleles(r), alleles);
+	}
+}
+
+
 TEST(MutationTest, NoMutation) {
 	std::vector<std::string> alleles = { "ATG", "CTA", "GCC", "CGA" };
 	std::vector<unsigned int> allelesCount = { 25, 25, 25, 25 };
@@ -170,6 +549,239 @@ TEST(MutationTest, Mutation) {
 	}
 }
 
+TEST(MutationTest, MarkerRates) {
+	std::vector<std::string> alleles = { "AAA" };
+	std::vector<unsigned int> allelesCount = { 100000 };
+	std::vector<double> mutationRates = { 0.05, 0.01, 0.0 };
+
+	double p = 1.0 / 3.0;
+	std::array< std::array<double, Nucl::Nucleotide::N>, Nucl::Nucleotide::N > nuclMutationProbs = { {
+					{ { 0.0, p, p, p } },
+					{ { p, 0.0, p, p } },
+					{ { p, p, 0.0, p } },
+					{ { p, p, p, 0.0 } }
+				} };
+
+	Simulation simul = Simulation(alleles, allelesCount, mutationRates, nuclMutationProbs);
+	simul.update(0);
+
+	// every marker mutates at its own rate, across the whole population
+	std::vector<double> mutated(mutationRates.size(), 0.0);
+	for (std::size_t i = 0; i < simul.getAlleles().size(); ++i) {
+		for (std::size_t m = 0; m < mutationRates.size(); ++m) {
+			if (simul.getAlleles()[i][m] != 'A') mutated[m] += simul.getAllelesCount()[i];
+		}
+	}
+
+	for (std::size_t m = 0; m < mutationRates.size(); ++m) {
+		EXPECT_NEAR(mutated[m] / allelesCount.front(), mutationRates[m], 0.003);
+	}
+	EXPECT_EQ(mutated.back(), 0.0);
+}
+
+TEST(MutationTest, Compaction) {
+	std::vector<std::string> alleles = { "ACGTACGT", "TTTTAAAA" };
+	std::vector<unsigned int> allelesCount = { 50, 50 };
+	std::vector<double> mutationRates(alleles.front().size(), 0.01);
+
+	double p = 1.0 / 3.0;
+	std::array< std::array<double, Nucl::Nucleotide::N>, Nucl::Nucleotide::N > nuclMutationProbs = { {
+					{ { 0.0, p, p, p } },
+					{ { p, 0.0, p, p } },
+					{ { p, p, 0.0, p } },
+					{ { p, p, p, 0.0 } }
+				} };
+
+	Simulation compacted(alleles, allelesCount, mutationRates, nuclMutationProbs);
+	compacted.setRandomStream(11, 0);
+	compacted.setCompactionPeriod(1);
+
+	Simulation simul(alleles, allelesCount, mutationRates, nuclMutationProbs);
+	simul.setRandomStream(11, 0);
+
+	// the alleles keep their index (brought back once freed, too), and the trajectories their draws
+	for (int t = 0; t < 200; ++t) {
+		compacted.update(t);
+		simul.update(t);
+
+		ASSERT_EQ(compacted.getAllelesCount(), simul.getAllelesCount());
+		ASSERT_EQ(compacted.getLossTimes(), simul.getLossTimes());
+		ASSERT_EQ(compacted.getAlleleFqsForOutput(), simul.getAlleleFqsForOutput());
+	}
+
+	EXPECT_EQ(compacted.getAlleleStrings(), simul.getAlleleStrings());
+	EXPECT_GT(compacted.getReclaimedSlots(), 0u);
+	EXPECT_EQ(simul.getReclaimedSlots(), 0u);
+}
+
+TEST(MutationTest, AliasTable) {
+	std::vector<double> weights = { 0.0, 0.2, 0.5, 0.3 };
+	AliasTable table(weights);
+
+	std::vector<int> draws(weights.size(), 0);
+	int n = 100000;
+	for (int i = 0; i < n; ++i) {
+		draws[table.draw(RandomDist::uniformDoubleSingle(0.0, 1.0))]++;
+	}
+
+	// an outcome of zero weight is never drawn
+	EXPECT_EQ(draws[0], 0);
+	for (std::size_t i = 1; i < weights.size(); ++i) {
+		EXPECT_NEAR(draws[i] * 1.0 / n, weights[i], 0.01);
+	}
+
+	EXPECT_TRUE(AliasTable(std::vector<double>(4, 0.0)).isEmpty());
+}
+
+TEST(MutationTest, SparseHaplotypes) {
+	std::vector<std::string> alleles = { "ACGT", "TGCA", "ACGT" };
+	SparseHaplotypes haplotypes(alleles);
+
+	// the repeated haplotype keeps its own index
+	EXPECT_EQ(haplotypes.size(), 3);
+	EXPECT_EQ(haplotypes.toString(1), "TGCA");
+	EXPECT_EQ(haplotypes.getSite(0, 2), Nucl::Nucleotide::G);
+	EXPECT_EQ(haplotypes.getNbDifferences(1), 4);
+
+	// a mutation back to an existing haplotype finds it, a new one is appended
+	EXPECT_EQ(haplotypes.mutate(0, 1, Nucl::Nucleotide::C), 0);
+	EXPECT_EQ(haplotypes.mutate(0, 0, Nucl::Nucleotide::T), 3);
+	EXPECT_EQ(haplotypes.toString(3), "TCGT");
+	EXPECT_EQ(haplotypes.describe(3), "0T");
+	EXPECT_EQ(haplotypes.mutate(1, 0, Nucl::Nucleotide::A), 4);
+	EXPECT_EQ(haplotypes.mutate(4, 0, Nucl::Nucleotide::T), 1);
+	EXPECT_EQ(haplotypes.describe(0), "ref");
+
+	// long sequences only store their differences, through the growth of the index
+	std::string sequence(20000, 'A');
+	SparseHaplotypes sparse({ sequence });
+	std::size_t haplotype = 0;
+	for (std::size_t site = 0; site < sequence.size(); site += 1000) {
+		haplotype = sparse.mutate(haplotype, site, Nucl::Nucleotide::G);
+		EXPECT_EQ(haplotype, site / 1000 + 1);
+		EXPECT_EQ(sparse.getNbDifferences(haplotype), site / 1000 + 1);
+	}
+
+	EXPECT_EQ(sparse.describe(4), "0G,1000G,2000G,3000G");
+	EXPECT_EQ(sparse.getSite(4, 3000), Nucl::Nucleotide::G);
+	EXPECT_EQ(sparse.getSite(4, 3001), Nucl::Nucleotide::A);
+	EXPECT_EQ(sparse.mutate(4, 3000, Nucl::Nucleotide::A), 3);
+	EXPECT_EQ(sparse.size(), 21);
+
+	// a lineage mutating a site again, and back to the reference, is interned as the sequences it gives
+	std::size_t g = sparse.mutate(2, 5, Nucl::Nucleotide::C);
+	std::size_t back = sparse.mutate(sparse.mutate(g, 5, Nucl::Nucleotide::T), 5, Nucl::Nucleotide::A);
+	EXPECT_EQ(back, 2);
+	EXPECT_EQ(sparse.mutate(sparse.mutate(2, 5, Nucl::Nucleotide::T), 5, Nucl::Nucleotide::C), g);
+	EXPECT_EQ(sparse.describe(g), "0G,5C,1000G");
+	EXPECT_EQ(sparse.getSite(g, 5), Nucl::Nucleotide::C);
+
+	// a derived haplotype survives a checkpoint
+	std::stringstream state;
+	sparse.saveState(state);
+	SparseHaplotypes restored({ sequence });
+	restored.loadState(state);
+	EXPECT_EQ(restored.size(), sparse.size());
+	EXPECT_EQ(restored.describe(g), "0G,5C,1000G");
+	EXPECT_EQ(restored.mutate(4, 3000, Nucl::Nucleotide::A), 3);
+
+	// a mutated haplotype only stores the site it changed, not the 20 differences of its lineage
+	std::string before = state.str();
+	sparse.mutate(20, 7, Nucl::Nucleotide::T);
+	std::stringstream longer;
+	sparse.saveState(longer);
+	EXPECT_LE(longer.str().size(), before.size() + 64);
+
+	// the haplotypes neither alive nor read by one are freed: brought back, they get their index again
+	std::size_t nHaplotypes = sparse.size();
+	sparse.release({ g });
+	EXPECT_EQ(sparse.describe(g), "0G,5C,1000G");
+	EXPECT_EQ(sparse.describe(2), "0G,1000G");
+	EXPECT_EQ(sparse.mutate(2, 2000, Nucl::Nucleotide::G), 3);
+	EXPECT_EQ(sparse.describe(3), "0G,1000G,2000G");
+	EXPECT_EQ(sparse.mutate(g, 5, Nucl::Nucleotide::A), 2);
+	EXPECT_EQ(sparse.mutate(2, 6, Nucl::Nucleotide::T), nHaplotypes);
+
+	std::stringstream released;
+	sparse.saveState(released);
+	SparseHaplotypes reloaded({ sequence });
+	reloaded.loadState(released);
+	EXPECT_EQ(reloaded.describe(nHaplotypes), "0G,6T,1000G");
+	EXPECT_EQ(reloaded.mutate(3, 3000, Nucl::Nucleotide::G), 4);
+	EXPECT_EQ(reloaded.size(), nHaplotypes + 1);
+
+	// a long lineage is cut into roots: the sites read stay right, and so does the interning
+	std::string shortSequence(300, 'A');
+	SparseHaplotypes chain({ shortSequence });
+	std::vector<std::size_t> lineage(1, 0);
+	for (std::size_t site = 0; site < 200; ++site) {
+		lineage.push_back(chain.mutate(lineage.back(), site, Nucl::Nucleotide::C));
+	}
+
+	EXPECT_EQ(chain.getNbDifferences(lineage.back()), 200);
+	EXPECT_EQ(chain.getSite(lineage.back(), 150), Nucl::Nucleotide::C);
+	EXPECT_EQ(chain.getSite(lineage.back(), 250), Nucl::Nucleotide::A);
+	EXPECT_EQ(chain.toString(lineage.back()), std::string(200, 'C') + std::string(100, 'A'));
+	EXPECT_EQ(chain.mutate(lineage[150], 150, Nucl::Nucleotide::C), lineage[151]);
+
+	// only the end of the lineage is kept, and its roots: the rest comes back under its former index
+	chain.release({ lineage.back() });
+	EXPECT_EQ(chain.mutate(lineage.back(), 199, Nucl::Nucleotide::A), lineage[199]);
+	EXPECT_EQ(chain.mutate(lineage[199], 199, Nucl::Nucleotide::C), lineage.back());
+	EXPECT_EQ(chain.mutate(lineage[198], 197, Nucl::Nucleotide::A), lineage[197]);
+	EXPECT_EQ(chain.toString(lineage[197]), std::string(197, 'C') + std::string(103, 'A'));
+	EXPECT_EQ(chain.mutate(lineage[198], 250, Nucl::Nucleotide::G), lineage.size());
+}
+
+TEST(MutationTest, AlleleDictionary) {
+	// every replicate shares the first alleles and finds some of its own, in common with the next one
+	std::vector< std::vector<std::string> > replicates(40);
+	for (std::size_t r = 0; r < replicates.size(); ++r) {
+		replicates[r] = { "ref", "0T" };
+		for (std::size_t a = 0; a < 30; ++a) {
+			replicates[r].push_back(std::to_string((r / 2) * 7 + a) + "G");
+		}
+	}
+
+	// few chains, so that the threads race on them
+	AlleleDictionary serial(4), concurrent(4);
+	std::vector< std::vector<std::size_t> > serialIdx(replicates.size()), concurrentIdx(replicates.size());
+
+	for (std::size_t r = replicates.size(); r-- > 0; ) {
+		for (std::size_t a = 0; a < replicates[r].size(); ++a) {
+			serialIdx[r].push_back(serial.add(replicates[r][a], r, a));
+		}
+	}
+
+	{
+		ThreadPool pool(3);
+		for (std::size_t r = 0; r < replicates.size(); ++r) {
+			pool.submit([&, r] {
+				for (std::size_t a = 0; a < replicates[r].size(); ++a) {
+					concurrentIdx[r].push_back(concurrent.add(replicates[r][a], r, a));
+				}
+			});
+		}
+		pool.wait();
+	}
+
+	serial.finalize();
+	concurrent.finalize();
+
+	// the columns follow the first replicate having each allele, whatever the order of the additions
+	EXPECT_EQ(serial.getAlleles(), concurrent.getAlleles());
+	EXPECT_EQ(serial.getAlleles().size(), 2 + 19 * 7 + 30);
+	EXPECT_EQ(serial.getAlleles()[1], "0T");
+	EXPECT_EQ(serial.getAlleles()[2 + 30], "30G");
+
+	for (std::size_t r = 0; r < replicates.size(); ++r) {
+		for (std::size_t a = 0; a < replicates[r].size(); ++a) {
+			EXPECT_EQ(serial.getAlleles()[serial.getColumn(serialIdx[r][a])], replicates[r][a]);
+			EXPECT_EQ(concurrent.getAlleles()[concurrent.getColumn(concurrentIdx[r][a])], replicates[r][a]);
+		}
+	}
+}
+
 
 TEST(MigrationTest, FixSubPopulation) {
 	std::vector<std::string> alleles = { "1", "2", "3" };
@@ -187,9 +799,10 @@ TEST(MigrationTest, FixSubPopulation) {
 		simul.update(t);
 
 		int totalSize = 0;
-		for (size_t i(0); i < simul.getSubPopulations().size(); ++i) {
+		std::vector< std::vector<unsigned int> > demes = simul.getSubPopulations();
+		for (size_t i(0); i < demes.size(); ++i) {
 			int subPopulationSize = 0;
-			for (auto& subPopAlleleCount : simul.getSubPopulations()[i])
+			for (auto& subPopAlleleCount : demes[i])
 				subPopulationSize += subPopAlleleCount;
 
 			// checking if at each step, the incomes are equal to outcomes for each subPop
@@ -327,6 +940,143 @@ TEST(MigrationTest, StarTest) {
 	}
 }
 
+TEST(MigrationTest, GraphFile) {
+	// a ring of 5 demes, one direction given twice, one edge without migrants
+	{
+		std::ofstream file("migration_graph_test.txt");
+		file << "# source target migrants\n";
+		for (int deme = 0; deme < 5; ++deme) {
+			file << deme << ' ' << (deme + 1) % 5 << " 2\n";
+			file << (deme + 1) % 5 << ' ' << deme << " 1\n";
+		}
+		file << "0 1 1\n" << "2 4 0\n";
+	}
+
+	MigrationGraph graph;
+	ASSERT_TRUE(MigrationGraph::load("migration_graph_test.txt", graph));
+	std::remove("migration_graph_test.txt");
+
+	ASSERT_EQ(graph.getNbDemes(), 5u);
+	EXPECT_EQ(graph.getFirstEdge(5), 10u);
+	for (std::size_t deme = 0; deme < 5; ++deme) {
+		EXPECT_EQ(graph.getFirstEdge(deme + 1) - graph.getFirstEdge(deme), 2u);
+		EXPECT_EQ(graph.getEmigrants(deme), deme == 0 ? 4u : 3u);
+	}
+
+	// every deme has both alleles
+	std::vector< std::vector<unsigned int> > subPopulations(5, std::vector<unsigned int>({ 4, 6 }));
+	Simulation simul({ "1", "2" }, subPopulations, std::make_shared<const MigrationGraph>(graph), true);
+
+	// deme 0 sends one individual more than it receives
+	for (int t = 0; t < 200; ++t) {
+		simul.update(t);
+
+		std::vector< std::vector<unsigned int> > demes = simul.getSubPopulations();
+		ASSERT_EQ(demes.size(), 5u);
+
+		unsigned int totalSize = 0;
+		for (std::size_t i = 0; i < demes.size(); ++i) {
+			EXPECT_EQ(demes[i][0] + demes[i][1], simul.getSubPopulationSizes()[i]);
+			totalSize += demes[i][0] + demes[i][1];
+		}
+		EXPECT_EQ(totalSize, 50u);
+	}
+
+	// a deme can not send more than its size
+	std::vector<std::size_t> sizes = { 3, 10, 10, 10, 10 };
+	EXPECT_TRUE(graph.limitEmigrants(sizes));
+	EXPECT_EQ(graph.getEmigrants(0), 3u);
+	EXPECT_FALSE(graph.limitEmigrants(sizes));
+
+	{
+		std::ofstream file("migration_graph_test.txt");
+		file << "1 1 3\n";
+	}
+	EXPECT_FALSE(MigrationGraph::load("migration_graph_test.txt", graph));
+	std::remove("migration_graph_test.txt");
+}
+
+TEST(MigrationTest, DemeParallel) {
+	// a ring of 100 demes, each starting with one of 4 alleles
+	std::size_t nDemes = 100;
+	std::vector< std::vector<unsigned int> > subPopulations(nDemes, std::vector<unsigned int>(4, 0));
+	std::vector< std::vector<unsigned int> > migrationRates(nDemes, std::vector<unsigned int>(nDemes, 0));
+	for (std::size_t i = 0; i < nDemes; ++i) {
+		subPopulations[i][i % 4] = 20;
+		migrationRates[i][(i + 1) % nDemes] = 3;
+		migrationRates[(i + 1) % nDemes][i] = 3;
+	}
+
+	Simulation serial({ "1", "2", "3", "4" }, subPopulations, migrationRates);
+	serial.setRandomStream(42, 3);
+	Simulation parallel = serial;
+
+	ThreadPool pool(4);
+	parallel.setThreadPool(&pool);
+
+	// every deme draws from its own stream: the split does not change the output
+	for (int t = 0; t < 100; ++t) {
+		serial.update(t);
+		parallel.update(t);
+
+		ASSERT_EQ(serial.getSubPopulations(), parallel.getSubPopulations());
+		ASSERT_EQ(serial.getSubPopulationSizes(), parallel.getSubPopulationSizes());
+	}
+
+	EXPECT_EQ(serial.getAlleleFqsForOutput(), parallel.getAlleleFqsForOutput());
+}
+
+TEST(MigrationTest, IslandModel) {
+	// 20 demes exchanging 2 individuals with each other, each starting with its own allele
+	std::size_t nDemes = 20;
+	std::vector<std::string> alleles;
+	std::vector< std::vector<unsigned int> > subPopulations(nDemes, std::vector<unsigned int>(nDemes, 0));
+	std::vector< std::vector<unsigned int> > migrationRates(nDemes, std::vector<unsigned int>(nDemes, 2));
+	for (std::size_t i = 0; i < nDemes; ++i) {
+		alleles.push_back(std::to_string(i + 1));
+		subPopulations[i][i] = 100;
+		migrationRates[i][i] = 0;
+	}
+
+	EXPECT_EQ(MigrationGraph(migrationRates).getUniformMigrants(), 2u);
+
+	Simulation serial(alleles, subPopulations, migrationRates);
+	serial.setRandomStream(7, 0);
+	Simulation parallel = serial;
+
+	ThreadPool pool(3);
+	parallel.setThreadPool(&pool);
+
+	// the immigrants only come from the other demes: a deme keeps its own allele in the ones that stay
+	// (and in its emigrants that no other deme took), and every emigrant arrives with its allele
+	serial.update(0);
+	parallel.update(0);
+	std::vector< std::vector<unsigned int> > demes = serial.getSubPopulations();
+	for (std::size_t i = 0; i < nDemes; ++i) {
+		EXPECT_GE(demes[i][i], 100u - 2 * (nDemes - 1));
+
+		unsigned int total = 0;
+		for (auto& deme : demes) {
+			total += deme[i];
+		}
+		EXPECT_EQ(total, 100u);
+	}
+
+	for (int t = 1; t < 200; ++t) {
+		serial.update(t);
+		parallel.update(t);
+
+		ASSERT_EQ(serial.getSubPopulations(), parallel.getSubPopulations());
+		for (auto& deme : serial.getSubPopulations()) {
+			EXPECT_EQ(std::accumulate(deme.begin(), deme.end(), 0u), 100u);
+		}
+	}
+
+	// a single rate for every edge, or no pool
+	migrationRates[0][1] = 3;
+	EXPECT_EQ(MigrationGraph(migrationRates).getUniformMigrants(), 0u);
+}
+
 TEST(SelectionTest, AlleleLethality) {
     vector<double> knownProbabilities = { 0.5, -1 };
 
@@ -365,7 +1115,458 @@ TEST (BottleneckTest, PopulationReduction) {
 }
 
 
+TEST(DemographyTest, Epochs) {
+	std::vector<Demography::Epoch> epochs;
+	ASSERT_TRUE(Demography::parse("10:exponential:0.1|20:logistic:0.5,1000|30:constant:50", epochs));
+	ASSERT_EQ(epochs.size(), 3u);
+	EXPECT_EQ(epochs[1].start, 20);
+	EXPECT_EQ(epochs[1].kind, _EPOCH_LOGISTIC_);
+	EXPECT_DOUBLE_EQ(epochs[1].rate, 0.5);
+	EXPECT_DOUBLE_EQ(epochs[1].size, 1000.0);
+
+	Demography demography(100, epochs, 40);
+
+	// the step from generation t follows the epoch started before t + 1
+	for (int t = 0; t <= 10; ++t) {
+		EXPECT_EQ(demography.getSize(t), 100);
+	}
+
+	for (int t = 11; t <= 20; ++t) {
+		EXPECT_EQ(demography.getSize(t), std::llround(100 * std::exp(0.1 * (t - 10))));
+	}
+
+	double size20 = (double) demography.getSize(20);
+	for (int t = 21; t <= 30; ++t) {
+		EXPECT_EQ(demography.getSize(t), std::llround(1000.0 / (1.0 + (1000.0 / size20 - 1.0) * std::exp(-0.5 * (t - 20)))));
+	}
+
+	EXPECT_EQ(demography.getSize(31), 50);
+	EXPECT_EQ(demography.getSize(40), 50);
+	EXPECT_EQ(demography.getSize(1000), 50);
+	EXPECT_EQ(demography.getMaxSize(), demography.getSize(30));
+
+	// a decline never empties the population
+	ASSERT_TRUE(Demography::parse("0:exponential:-1", epochs));
+	EXPECT_EQ(Demography(10, epochs, 100).getSize(100), 1);
+
+	for (auto& invalid : { "", "10:constant", "10:constant:0", "10:growth:2", "10:logistic:0.1", "-1:constant:5",
+						   "10:constant:5|10:constant:6", "20:constant:5|10:constant:6", "a:constant:5", "10:exponential:x" }) {
+		EXPECT_FALSE(Demography::parse(invalid, epochs)) << invalid;
+	}
+}
+
+
+TEST(DemographyTest, FastaPopulation) {
+	// the size of the population is only known once the fasta file is read
+	std::ofstream input("demography_test_input.txt");
+	input << "GEN = 40\nREP = 2\nSEED = 1\nMODE = 0\nLOCKSTEP = 1\nOUTPUT_BINARY = 1\nDEMOGRAPHY = 0:exponential:1\n";
+	input.close();
+
+	Data lockstep("demography_test_input.txt", "../data/test.fa");
+	ASSERT_TRUE(lockstep.getDemography() != nullptr);
+	EXPECT_GT(lockstep.getMaxPopulationSize(), (long long) UINT_MAX);
+	EXPECT_FALSE(lockstep.getIsBinaryOutput());
+
+	input.open("demography_test_input.txt");
+	input << "GEN = 40\nREP = 2\nSEED = 1\nMODE = 0\nLOCKSTEP = 0\nDEMOGRAPHY = 0:exponential:1\n";
+	input.close();
+
+	EXPECT_EXIT(Data("demography_test_input.txt", "../data/test.fa"),
+				::testing::ExitedWithCode(_ERROR_POPULATION_SIZE_TOO_LARGE_CODE_), "");
+}
+
+
+TEST(DemographyTest, Bottleneck) {
+	// the sizes are truncated, as when they were divided and multiplied in place
+	Demography demography = Demography::bottleneck(10, 5, 8, 3.0);
+
+	EXPECT_EQ(demography.getSize(5), 10);
+	EXPECT_EQ(demography.getSize(6), 3);
+	EXPECT_EQ(demography.getSize(8), 3);
+	EXPECT_EQ(demography.getSize(9), 9);
+	EXPECT_EQ(demography.getSize(100), 9);
+	EXPECT_EQ(demography.getMaxSize(), 10);
+}
+
+
+TEST(DemographyTest, Simulations) {
+	std::vector<Demography::Epoch> epochs;
+	ASSERT_TRUE(Demography::parse("3:exponential:0.3|10:constant:15", epochs));
+	std::shared_ptr<const Demography> demography = std::make_shared<const Demography>(30, epochs, 20);
+
+	std::vector<Simulation> simuls = {
+		Simulation({ "1", "2" }, { 10, 20 }),
+		Simulation({ "1", "2" }, { 10, 20 }, { 0.2, 0.0 })
+	};
+
+	for (auto& simul : simuls) {
+		simul.setDemography(demography);
+		simul.setRandomStream(3, 0);
+
+		for (int t = 0; t < 20; ++t) {
+			simul.update(t);
+
+			unsigned int size = simul.getAllelesCount()[0] + simul.getAllelesCount()[1];
+			EXPECT_EQ(simul.getPopulationSize(), demography->getSize(t + 1));
+			EXPECT_EQ(size, (unsigned int) demography->getSize(t + 1));
+		}
+	}
+
+	// every deme keeps its share of the population
+	auto graph = std::make_shared<const MigrationGraph>(std::vector< std::vector<unsigned int> >({ { 0, 1, 1 }, { 1, 0, 1 }, { 1, 1, 0 } }));
+	Simulation migration({ "1", "2" }, { { 5, 5 }, { 10, 0 }, { 0, 10 } }, graph, false);
+	migration.setDemography(demography);
+
+	for (int t = 0; t < 20; ++t) {
+		migration.update(t);
+
+		for (auto size : migration.getSubPopulationSizes()) {
+			EXPECT_EQ(size, (std::size_t) (10 * demography->getSize(t + 1) / 30));
+		}
+	}
+}
+
+
+TEST(AbsorptionTest, FixationAndLoss) {
+	Simulation simul = Simulation({ "1", "2", "3" }, { 2, 2, 1 });
+	simul.setRandomStream(5, 0);
+
+	int t = 0;
+	while (!simul.isAbsorbed() && t < 10000) {
+		simul.update(t);
+		++t;
+
+		// an allele lost at this step has its loss time set
+		for (size_t i = 0; i < 3; ++i) {
+			if (simul.getAllelesCount()[i] == 0) {
+				EXPECT_LE(simul.getLossTimes()[i], t);
+				EXPECT_GE(simul.getLossTimes()[i], 0);
+			} else {
+				EXPECT_EQ(simul.getLossTimes()[i], -1);
+			}
+		}
+	}
+
+	ASSERT_TRUE(simul.isAbsorbed());
+	EXPECT_EQ(simul.getFixationTime(), t);
+	EXPECT_EQ(std::count(simul.getLossTimes().begin(), simul.getLossTimes().end(), -1), 1);
+	EXPECT_EQ(*std::max_element(simul.getLossTimes().begin(), simul.getLossTimes().end()), t);
+
+	// nothing changes anymore
+	std::vector<unsigned int> counts = simul.getAllelesCount();
+	for (int i = 0; i < 10; ++i) {
+		simul.update(t + i);
+	}
+	EXPECT_EQ(simul.getAllelesCount(), counts);
+	EXPECT_EQ(simul.getFixationTime(), t);
+
+	// mutations can always bring alleles back
+	Simulation mutations({ "A" }, { 10 }, { 0.1 }, { { { { 0.0, 1.0, 0.0, 0.0 } } } });
+	EXPECT_FALSE(mutations.isAbsorbed());
+}
+
+
 int main(int argc, char**argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
 }
+
+
+TEST(ExecutorTest, AbsorbedReplicates) {
+	std::string results = runExecutor("POPSIZE = 10\nOUTPUT_BLOCK = 7\nTHREADS = 2\n");
+	std::ifstream absorption("absorption.txt");
+
+	std::string line;
+	std::getline(absorption, line);
+
+	int nFixed = 0, replicate = 0, fixationTime = 0;
+	while (absorption >> replicate >> fixationTime >> line >> line) {
+		if (fixationTime >= 0) ++nFixed;
+	}
+	EXPECT_EQ(replicate, 9);
+	EXPECT_GT(nFixed, 0);
+
+	// the absorbed replicates are repeated up to the last generation
+	size_t lastStep = results.rfind("\n50");
+	std::string last = results.substr(lastStep + 1, results.find('\n', lastStep + 1) - lastStep - 1);
+	size_t nOnes = 0;
+	for (size_t pos = last.find("1.00"); pos != std::string::npos; pos = last.find("1.00", pos + 1)) ++nOnes;
+	EXPECT_EQ(nOnes, (size_t) nFixed);
+}
+
+
+TEST(ExecutorTest, LockstepMatchesSimulations) {
+	std::vector<std::string> modes = {
+		"MODE = 0\n",
+		"MODE = 3\nSEL = 0.2|0|-0.5\n",
+		"MODE = 4\nPOP_REDUCTION = 2.0\nPOP_START = 10\nPOP_END = 30\n",
+		"MODE = 0\nDEMOGRAPHY = 5:exponential:0.2|20:logistic:0.3,50|35:constant:8\n"
+	};
+
+	for (auto& mode : modes) {
+		// small populations, to also have absorbed replicates
+		// and a large one with the diffusion approximation
+		for (auto& popSize : { "POPSIZE = 10\n", "POPSIZE = 100\n", "POPSIZE = 100000\nDIFFUSION = 100\n" }) {
+			std::string params = mode + popSize + "OUTPUT_BLOCK = 7\nBATCH = 3\n";
+
+			std::string lockstep = runExecutor(params + "LOCKSTEP = 1\n");
+			std::string absorption = readFile("absorption.txt");
+			std::string simulations = runExecutor(params + "LOCKSTEP = 0\n");
+
+			EXPECT_EQ(lockstep, simulations) << params;
+			EXPECT_EQ(absorption, readFile("absorption.txt")) << params;
+		}
+	}
+}
+
+
+TEST(ExecutorTest, CountWidths) {
+	EXPECT_EQ(ReplicateBatch::getCountWidth(65535), 2u);
+	EXPECT_EQ(ReplicateBatch::getCountWidth(65536), 4u);
+	EXPECT_EQ(ReplicateBatch::getCountWidth(10000000000LL), 8u);
+
+	// the same replicates, whatever the width of their counts
+	Simulation prototype({ "0", "1", "2" }, { 1, 1, 1 }, { 0.1, 0.0, -0.1 });
+	std::vector<unsigned long long> initialCounts = { 300, 300, 400 };
+	std::vector< std::unique_ptr<ReplicateBatch> > batches;
+	for (long long maxPopulationSize : { 1000LL, 100000LL, 10000000000LL }) {
+		batches.push_back(ReplicateBatch::create(prototype, initialCounts, maxPopulationSize, 5, 42, 0));
+	}
+
+	std::vector<unsigned long long> narrow, wide;
+	for (int t = 0; t < 200; ++t) {
+		for (auto& batch : batches) {
+			batch->update(t);
+		}
+
+		for (size_t r = 0; r < 5; ++r) {
+			batches[0]->getAlleleCountsForOutput(r, narrow);
+			for (size_t b = 1; b < batches.size(); ++b) {
+				batches[b]->getAlleleCountsForOutput(r, wide);
+				EXPECT_EQ(narrow, wide);
+			}
+		}
+	}
+
+	// a census-sized population, beyond the ints of a Simulation
+	std::string results = runExecutor("POPSIZE = 10000000000\nDIFFUSION = 1000\n");
+	EXPECT_EQ(results.substr(results.find("\n0") + 1, 19), "0\t0.30|0.30|0.40\t0.");
+}
+
+
+TEST(ExecutorTest, Statistics) {
+	runExecutor("OUTPUT_STATS = 1\nTHREADS = 1\n");
+	std::string oneThread = readFile("statistics.txt");
+	runExecutor("OUTPUT_STATS = 1\nTHREADS = 3\nOUTPUT_BLOCK = 7\n");
+	std::string threeThreads = readFile("statistics.txt");
+
+	EXPECT_EQ(oneThread, threeThreads);
+
+	// every replicate starts with the same frequencies
+	std::string firstStep = oneThread.substr(oneThread.find('\n') + 1);
+	EXPECT_EQ(firstStep.substr(0, firstStep.find('\t', 2)), "0\t0.3|0|0|0|0.3005|0.305|0.3095");
+
+	// direct use of the accumulator: merging gives the same as adding everything
+	ReplicateStatistics all(1, 10), first(1, 10), second(1, 10);
+	std::vector< std::vector<unsigned int> > counts = { { 10, 0 }, { 4, 6 }, { 0, 10 }, { 7, 3 } };
+	for (size_t i = 0; i < counts.size(); ++i) {
+		all.add(0, counts[i], 10);
+		(i < 2 ? first : second).add(0, counts[i], 10);
+	}
+	first.merge(second);
+
+	EXPECT_NEAR(all.getMean(0, 0), 0.525, 1e-12);
+	EXPECT_NEAR(first.getMean(0, 0), all.getMean(0, 0), 1e-12);
+	EXPECT_NEAR(first.getVariance(0, 0), all.getVariance(0, 0), 1e-12);
+	EXPECT_DOUBLE_EQ(all.getFixedFraction(0, 0), 0.25);
+	EXPECT_DOUBLE_EQ(all.getLostFraction(0, 1), 0.25);
+	EXPECT_EQ(all.getStatisticsForOutput(0), first.getStatisticsForOutput(0));
+
+	// the columns of every deme are frequencies within the deme
+	ReplicateStatistics demes(1, 10);
+	demes.add(0, std::vector<unsigned int>({ 4, 0, 1, 3, 0, 0 }), std::vector<unsigned long long>({ 4, 4, 0 }));
+	EXPECT_DOUBLE_EQ(demes.getMean(0, 0), 1.0);
+	EXPECT_DOUBLE_EQ(demes.getFixedFraction(0, 0), 1.0);
+	EXPECT_DOUBLE_EQ(demes.getMean(0, 3), 0.75);
+	EXPECT_DOUBLE_EQ(demes.getFixedFraction(0, 4), 0.0);
+	EXPECT_DOUBLE_EQ(demes.getLostFraction(0, 5), 1.0);
+
+	runExecutor("OUTPUT_STATS = 1\nMODE = 2\nMIG_MODEL = 3\nMIG_RATES = 1|1|1\nMIG_DETAILED_OUTPUT = 1\n");
+	std::string demeStatistics = readFile("statistics.txt");
+	std::string initial = demeStatistics.substr(demeStatistics.find('\n') + 1);
+	initial = initial.substr(0, initial.find('\n'));
+
+	// every deme starts with a single allele
+	EXPECT_EQ(initial.substr(0, initial.find('\t', 2)), "0\t1|0|1|0|0.9905|0.995|0.9995");
+}
+
+
+TEST(ExecutorTest, RecordSchedule) {
+	// the lines of every step of the run, by step
+	auto linesByStep = [](const std::string& results) {
+		std::map<std::string, std::string> lines;
+		std::stringstream ss(results);
+		std::string line;
+		while (std::getline(ss, line)) {
+			lines[line.substr(0, line.find('\t'))] = line;
+		}
+		return lines;
+	};
+
+	for (auto& lockstep : { "LOCKSTEP = 0\n", "LOCKSTEP = 1\n" }) {
+		std::string params = std::string(lockstep) + "POPSIZE = 20\nOUTPUT_BLOCK = 4\n";
+		std::map<std::string, std::string> every = linesByStep(runExecutor(params));
+
+		// the recorded steps are the ones of the whole run, absorbed replicates included
+		std::map<std::string, std::vector<std::string> > schedules = {
+			{ "RECORD = every 7\n", { "0", "7", "14", "21", "28", "35", "42", "49", "50", "51" } },
+			{ "RECORD = log 4\n", { "0", "1", "4", "14", "50", "51" } },
+			{ "RECORD = 30|3|3|99\n", { "0", "3", "30", "50", "51" } }
+		};
+
+		for (auto& schedule : schedules) {
+			std::map<std::string, std::string> recorded = linesByStep(runExecutor(params + schedule.first));
+
+			ASSERT_EQ(recorded.size(), schedule.second.size()) << schedule.first;
+			for (auto& step : schedule.second) {
+				EXPECT_EQ(recorded[step], every[step]) << schedule.first << step;
+			}
+		}
+	}
+}
+
+
+TEST(ExecutorTest, CheckpointResume) {
+	for (auto& lockstep : { "LOCKSTEP = 0\n", "LOCKSTEP = 1\n" }) {
+		std::string params = std::string(lockstep) + "POPSIZE = 30\nOUTPUT_BLOCK = 4\nOUTPUT_BINARY = 1\nCHECKPOINT = 10\n";
+
+		std::string uninterrupted = runExecutor(params);
+		std::string binary = readFile("results.bin");
+		std::string absorption = readFile("absorption.txt");
+
+		// a shorter run, extended up to the same generation, after output written past its last checkpoint
+		std::remove("checkpoint.bin");
+		runExecutor(params + "GEN = 23\n");
+		std::ofstream("results.txt", std::ofstream::app) << "interrupted line";
+
+		EXPECT_EQ(runExecutor(params, true), uninterrupted) << lockstep;
+		EXPECT_EQ(readFile("results.bin"), binary) << lockstep;
+		EXPECT_EQ(readFile("absorption.txt"), absorption) << lockstep;
+	}
+}
+
+
+TEST(ExecutorTest, MutationColumns) {
+	// the columns are only known at the end: the blocks wait as raw counts, also across a checkpoint
+	auto run = [](const std::string& extraParams, bool resume) {
+		std::ofstream input("mutation_test_input.txt");
+		input << "GEN = 60\nREP = 6\nMODE = 1\nSEED = 5\nSITES = 0|1|2|3|4|5\nMUT = 0.02|0.02|0.02|0.02|0.02|0.02\nMUT_COMPACTION = 3\n" << extraParams;
+		input.close();
+
+		SimulationsExecutor executor("mutation_test_input.txt", "../data/test.fa", resume);
+		executor.execute();
+
+		return readFile("results.txt");
+	};
+
+	std::string singleBlock = run("OUTPUT_BLOCK = 1000\nTHREADS = 1\n", false);
+	std::string absorption = readFile("absorption.txt");
+
+	EXPECT_EQ(run("OUTPUT_BLOCK = 7\nTHREADS = 3\n", false), singleBlock);
+	EXPECT_EQ(readFile("absorption.txt"), absorption);
+	EXPECT_FALSE(std::ifstream("counts.bin").is_open());
+
+	// every replicate has a column for every allele of the run, named on the last line
+	std::string identifiers = singleBlock.substr(singleBlock.rfind('\t', singleBlock.size() - 3) + 1);
+	identifiers.resize(identifiers.find('\t'));
+	std::size_t nColumns = std::count(identifiers.begin(), identifiers.end(), '|') + 1;
+	std::string first = singleBlock.substr(0, singleBlock.find('\n'));
+	EXPECT_GT(nColumns, 10u);
+	EXPECT_EQ((std::size_t) std::count(first.begin(), first.end(), '|'), 6 * (nColumns - 1));
+
+	std::remove("checkpoint.bin");
+	run("OUTPUT_BLOCK = 4\nCHECKPOINT = 10\nGEN = 23\n", false);
+	EXPECT_EQ(run("OUTPUT_BLOCK = 4\nCHECKPOINT = 10\n", true), singleBlock);
+	EXPECT_EQ(readFile("absorption.txt"), absorption);
+
+	// the statistics follow the same columns
+	run("OUTPUT_STATS = 1\nTHREADS = 2\n", false);
+	std::string statistics = readFile("statistics.txt");
+	std::string step = statistics.substr(statistics.find('\n') + 1);
+	step = step.substr(0, step.find('\n'));
+	EXPECT_EQ((std::size_t) std::count(step.begin(), step.end(), '\t'), nColumns);
+	EXPECT_EQ(statistics.substr(statistics.rfind('\t', statistics.size() - 2) + 1), identifiers + "\n");
+}
+
+
+TEST(ExecutorTest, ShardsMerge) {
+	for (auto& lockstep : { "LOCKSTEP = 0\n", "LOCKSTEP = 1\n" }) {
+		std::string params = std::string(lockstep) + "POPSIZE = 30\nOUTPUT_BINARY = 1\nRECORD = every 3\n";
+
+		std::string whole = runExecutor(params);
+		std::string binary = readFile("results.bin");
+		std::string absorption = readFile("absorption.txt");
+
+		// the 10 replicates in 3 slices, each on the streams it has in the whole run
+		for (int shard = 0; shard < 3; ++shard) {
+			SimulationsExecutor executor("executor_test_input.txt", "", false, shard, 3);
+			executor.execute();
+		}
+
+		EXPECT_EQ(readFile("results.shard-1-of-3.txt").substr(0, 2), "0\t");
+
+		std::remove("results.txt");
+		std::remove("results.bin");
+		std::remove("absorption.txt");
+		ShardMerger(3).merge();
+
+		EXPECT_EQ(readFile("results.txt"), whole) << lockstep;
+		EXPECT_EQ(readFile("results.bin"), binary) << lockstep;
+		EXPECT_EQ(readFile("absorption.txt"), absorption) << lockstep;
+	}
+
+	EXPECT_EQ(ShardMerger::getShardFileName("results.txt", 2, 8), "results.shard-2-of-8.txt");
+}
+
+
+TEST(ExecutorTest, ParameterSweep) {
+	EXPECT_EQ(Data::expandRanges("SEL=0|0..0.1:3"), std::vector<std::string>({ "SEL=0|0", "SEL=0|0.05", "SEL=0|0.1" }));
+	EXPECT_EQ(Data::expandRanges("POPSIZE=100..400:2").back(), "POPSIZE=400");
+	EXPECT_EQ(Data::expandRanges("GEN=10..100:4"), std::vector<std::string>({ "GEN=10", "GEN=40", "GEN=70", "GEN=100" }));
+	EXPECT_EQ(Data::expandRanges("POPSIZE=1000000000000..2000000000000:2").front(), "POPSIZE=1000000000000");
+	EXPECT_EXIT(Data::expandRanges("GEN=10..101:3"), ::testing::ExitedWithCode(_ERROR_SWEEP_INVALID_CODE_), "");
+	EXPECT_EXIT(Data::expandRanges("REP=1..2:3"), ::testing::ExitedWithCode(_ERROR_SWEEP_INVALID_CODE_), "");
+
+	std::ofstream input("sweep_test_input.txt");
+	input << "GEN = 30\nREP = 6\nFREQ = 0.3|0.3|0.4\nMODE = 3\nSEED = 7\nBATCH = 2\n"
+		  << "POPSIZE = 50..100:2\nSEL = 0 | -0.2..0.2:3 | 0\n";
+	input.close();
+
+	Data data("sweep_test_input.txt", "");
+	ASSERT_EQ(data.getSweptLines().size(), 2u);
+
+	std::vector< std::vector<std::string> > points = data.getSweepPoints();
+	ASSERT_EQ(points.size(), 6u);
+	EXPECT_EQ(points[4], std::vector<std::string>({ "POPSIZE=100", "SEL=0|0|0" }));
+
+	ParameterSweep sweep(data);
+	sweep.execute();
+
+	// every point writes what a run with its values does
+	std::string index = readFile("sweep.txt");
+	EXPECT_EQ(std::count(index.begin(), index.end(), '\n'), 7);
+
+	std::string pointResults = readFile("results.sweep-4.txt");
+	std::string pointAbsorption = readFile("absorption.sweep-4.txt");
+
+	std::ofstream pointInput("sweep_test_input.txt");
+	pointInput << "GEN = 30\nREP = 6\nFREQ = 0.3|0.3|0.4\nMODE = 3\nSEED = 7\nBATCH = 2\nPOPSIZE = 100\nSEL = 0|0|0\n";
+	pointInput.close();
+
+	SimulationsExecutor executor("sweep_test_input.txt", "");
+	executor.execute();
+
+	EXPECT_FALSE(pointResults.empty());
+	EXPECT_EQ(pointResults, readFile("results.txt"));
+	EXPECT_EQ(pointAbsorption, readFile("absorption.txt"));
+}